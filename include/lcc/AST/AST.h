@@ -11,15 +11,16 @@
  ***********************************/
 #ifndef LCC_SYNTAX_H
 #define LCC_SYNTAX_H
-#include "lcc/Basic/Box.h"
+#include "lcc/AST/ASTContext.h"
+#include "lcc/AST/SyntaxBox.h"
 #include "lcc/Basic/Util.h"
 #include "lcc/Lexer/Token.h"
+#include "llvm/ADT/ArrayRef.h"
 #include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <variant>
-#include <vector>
 
 namespace lcc::Syntax {
 class PrimaryExprIdent;
@@ -39,16 +40,7 @@ class UnaryExprSizeOf;
 
 class TypeName;
 class CastExpr;
-class MultiExpr;
-class AdditiveExpr;
-class ShiftExpr;
-class RelationalExpr;
-class EqualExpr;
-class BitAndExpr;
-class BitXorExpr;
-class BitOrExpr;
-class LogAndExpr;
-class LogOrExpr;
+class BinaryExpr;
 class CondExpr;
 using ConstantExpr = CondExpr;
 class AssignExpr;
@@ -97,6 +89,7 @@ class ParameterDeclaration;
 class ParamList;
 class Initializer;
 class InitializerList;
+class ConstantArray;
 
 using ExprBox = box<Expr>;
 using AssignExprBox = box<AssignExpr>;
@@ -108,16 +101,17 @@ using AbstractDeclaratorBox = box<AbstractDeclarator>;
 
 class Node {
 private:
-  TokIter beginTokLoc_;
+  llvm::SMLoc beginLoc_;
 
 public:
-  Node(TokIter beginTokLoc) : beginTokLoc_(beginTokLoc) {}
-  virtual ~Node() = default;
+  Node(llvm::SMLoc beginLoc) : beginLoc_(beginLoc) {}
+  /// never destroyed through a Node, see ASTContext
+  ~Node() = default;
   Node(const Node &) = delete;
   Node &operator=(const Node &) = delete;
   Node(Node &&) = default;
   Node &operator=(Node &&) = default;
-  TokIter getBeginLoc() const { return beginTokLoc_; }
+  llvm::SMLoc getBeginLoc() const { return beginLoc_; }
 };
 
 /*
@@ -129,7 +123,7 @@ private:
   std::string_view ident_;
 
 public:
-  PrimaryExprIdent(TokIter begin, std::string_view identifier)
+  PrimaryExprIdent(llvm::SMLoc begin, std::string_view identifier)
       : Node(begin), ident_(identifier) {}
   [[nodiscard]] std::string_view getIdentifier() const { return ident_; }
 };
@@ -140,14 +134,15 @@ public:
  */
 class PrimaryExprConstant final : public Node {
 public:
+  /// a string is a copy in the ASTContext
   using Variant = std::variant<int32_t, uint32_t, int64_t, uint64_t, float,
-                               double, std::string>;
+                               double, std::string_view>;
 
 private:
   Variant value_;
 
 public:
-  PrimaryExprConstant(TokIter begin, Variant &&value)
+  PrimaryExprConstant(llvm::SMLoc begin, Variant &&value)
       : Node(begin), value_(value) {}
   [[nodiscard]] const Variant &getValue() const { return value_; }
 };
@@ -161,7 +156,7 @@ private:
   ExprBox expr_;
 
 public:
-  PrimaryExprParentheses(TokIter begin, ExprBox expr)
+  PrimaryExprParentheses(llvm::SMLoc begin, ExprBox expr)
       : Node(begin), expr_(MV_(expr)) {}
   [[nodiscard]] const Expr &getExpr() const { return *expr_; }
 };
@@ -204,7 +199,7 @@ private:
   ExprBox expr_;
 
 public:
-  PostFixExprSubscript(TokIter begin, PostFixExpr &&postFixExpr, ExprBox expr)
+  PostFixExprSubscript(llvm::SMLoc begin, PostFixExpr &&postFixExpr, ExprBox expr)
       : Node(begin), postFixExpr_(MV_(postFixExpr)), expr_(MV_(expr)) {}
   [[nodiscard]] const PostFixExpr &getPostFixExpr() const {
     return postFixExpr_;
@@ -223,17 +218,17 @@ public:
 class PostFixExprFuncCall final : public Node {
 private:
   PostFixExpr postFixExpr_;
-  std::vector<AssignExprBox> params_;
+  ArenaVector<AssignExprBox> params_;
 
 public:
-  PostFixExprFuncCall(TokIter begin, PostFixExpr &&postFixExpr,
-                      std::vector<AssignExprBox> &&params)
+  PostFixExprFuncCall(llvm::SMLoc begin, PostFixExpr &&postFixExpr,
+                      ArenaVector<AssignExprBox> &&params)
       : Node(begin), postFixExpr_(MV_(postFixExpr)), params_(MV_(params)) {}
 
   [[nodiscard]] const PostFixExpr &getPostFixExpr() const {
     return postFixExpr_;
   }
-  [[nodiscard]] const std::vector<AssignExprBox> &
+  [[nodiscard]] const ArenaVector<AssignExprBox> &
   getOptionalAssignExpressions() const {
     return params_;
   }
@@ -249,7 +244,7 @@ private:
   std::string_view identifier_;
 
 public:
-  PostFixExprDot(TokIter begin, PostFixExpr &&postFixExpr,
+  PostFixExprDot(llvm::SMLoc begin, PostFixExpr &&postFixExpr,
                  std::string_view identifier)
       : Node(begin), postFixExpr_(MV_(postFixExpr)), identifier_(identifier) {}
 
@@ -269,7 +264,7 @@ private:
   std::string_view identifier_;
 
 public:
-  PostFixExprArrow(TokIter begin, PostFixExpr &&postFixExpr,
+  PostFixExprArrow(llvm::SMLoc begin, PostFixExpr &&postFixExpr,
                    std::string_view identifier)
       : Node(begin), postFixExpr_(MV_(postFixExpr)), identifier_(identifier) {}
   [[nodiscard]] const PostFixExpr &getPostFixExpr() const {
@@ -287,7 +282,7 @@ private:
   PostFixExpr postFixExpr_;
 
 public:
-  PostFixExprIncrement(TokIter begin, PostFixExpr &&postFixExpr)
+  PostFixExprIncrement(llvm::SMLoc begin, PostFixExpr &&postFixExpr)
       : Node(begin), postFixExpr_(MV_(postFixExpr)) {}
   [[nodiscard]] const PostFixExpr &getPostFixExpr() const {
     return postFixExpr_;
@@ -303,7 +298,7 @@ private:
   PostFixExpr postFixExpr_;
 
 public:
-  PostFixExprDecrement(TokIter begin, PostFixExpr &&postFixExpr)
+  PostFixExprDecrement(llvm::SMLoc begin, PostFixExpr &&postFixExpr)
       : Node(begin), postFixExpr_(MV_(postFixExpr)) {}
   [[nodiscard]] const PostFixExpr &getPostFixExpr() const {
     return postFixExpr_;
@@ -321,7 +316,7 @@ private:
   InitializerListBox initializerList_;
 
 public:
-  PostFixExprTypeInitializer(TokIter begin, TypeNameBox typeName,
+  PostFixExprTypeInitializer(llvm::SMLoc begin, TypeNameBox typeName,
                              InitializerListBox initializerList)
       : Node(begin), typeName_(MV_(typeName)),
         initializerList_(MV_(initializerList)) {}
@@ -375,7 +370,7 @@ private:
   Variant value_;
 
 public:
-  UnaryExprUnaryOperator(TokIter begin, Op anOperator, Variant &&value)
+  UnaryExprUnaryOperator(llvm::SMLoc begin, Op anOperator, Variant &&value)
       : Node(begin), operator_(anOperator), value_(MV_(value)) {}
 
   [[nodiscard]] Op getOperator() const { return operator_; }
@@ -397,7 +392,7 @@ class UnaryExprSizeOf final : public Node {
   Variant value_;
 
 public:
-  UnaryExprSizeOf(TokIter begin, Variant &&variant)
+  UnaryExprSizeOf(llvm::SMLoc begin, Variant &&variant)
       : Node(begin), value_(MV_(variant)) {}
 
   [[nodiscard]] const Variant &getVariant() const { return value_; }
@@ -433,7 +428,7 @@ private:
   Variant variant_;
 
 public:
-  TypeSpec(TokIter begin, Variant &&variant)
+  TypeSpec(llvm::SMLoc begin, Variant &&variant)
       : Node(begin), variant_(MV_(variant)) {}
 
   [[nodiscard]] const Variant &getVariant() const { return variant_; }
@@ -453,7 +448,7 @@ private:
   Qualifier mQualifier;
 
 public:
-  TypeQualifier(TokIter begin, Qualifier qualifier)
+  TypeQualifier(llvm::SMLoc begin, Qualifier qualifier)
       : Node(begin), mQualifier(qualifier) {}
   [[nodiscard]] Qualifier getQualifier() const { return mQualifier; }
 };
@@ -464,7 +459,7 @@ public:
  */
 class FunctionSpecifier final : public Node {
 public:
-  FunctionSpecifier(TokIter begin) : Node(begin) {}
+  FunctionSpecifier(llvm::SMLoc begin) : Node(begin) {}
 };
 
 /**
@@ -483,7 +478,7 @@ private:
   Specifiers mSpecifier;
 
 public:
-  StorageClsSpec(TokIter begin, Specifiers specifier)
+  StorageClsSpec(llvm::SMLoc begin, Specifiers specifier)
       : Node(begin), mSpecifier(specifier) {}
   [[nodiscard]] Specifiers getSpecifier() const { return mSpecifier; }
 };
@@ -497,13 +492,13 @@ public:
  */
 class DeclSpec final : public Node {
 private:
-  std::vector<StorageClsSpec> storageClassSpecifiers_;
-  std::vector<TypeSpec> typeSpecifiers_;
-  std::vector<TypeQualifier> typeQualifiers_;
-  std::vector<FunctionSpecifier> functionSpecifiers_;
+  ArenaVector<StorageClsSpec> storageClassSpecifiers_;
+  ArenaVector<TypeSpec> typeSpecifiers_;
+  ArenaVector<TypeQualifier> typeQualifiers_;
+  ArenaVector<FunctionSpecifier> functionSpecifiers_;
 
 public:
-  DeclSpec(TokIter begin) : Node(begin) {}
+  DeclSpec(llvm::SMLoc begin) : Node(begin) {}
   void addStorageClassSpecifiers(StorageClsSpec &&specifier) {
     storageClassSpecifiers_.push_back(MV_(specifier));
   }
@@ -517,17 +512,17 @@ public:
     functionSpecifiers_.push_back(MV_(specifier));
   }
 
-  [[nodiscard]] const std::vector<StorageClsSpec> &
+  [[nodiscard]] const ArenaVector<StorageClsSpec> &
   getStorageClassSpecifiers() const {
     return storageClassSpecifiers_;
   }
-  [[nodiscard]] const std::vector<TypeSpec> &getTypeSpecs() const {
+  [[nodiscard]] const ArenaVector<TypeSpec> &getTypeSpecs() const {
     return typeSpecifiers_;
   }
-  [[nodiscard]] const std::vector<TypeQualifier> &getTypeQualifiers() const {
+  [[nodiscard]] const ArenaVector<TypeQualifier> &getTypeQualifiers() const {
     return typeQualifiers_;
   }
-  [[nodiscard]] const std::vector<FunctionSpecifier> &
+  [[nodiscard]] const ArenaVector<FunctionSpecifier> &
   getFunctionSpecifier() const {
     return functionSpecifiers_;
   }
@@ -554,7 +549,7 @@ private:
 
 public:
   TypeName(
-      TokIter begin, DeclSpec specifierQualifiers,
+      llvm::SMLoc begin, DeclSpec specifierQualifiers,
       std::optional<AbstractDeclaratorBox> abstractDeclarator = {std::nullopt})
       : Node(begin), mSpecifierQualifiers(MV_(specifierQualifiers)),
         mAbstractDeclarator(MV_(abstractDeclarator)) {}
@@ -577,238 +572,82 @@ public:
 class CastExpr final : public Node {
 public:
   using TypeNameCast = std::pair<TypeName, CastExprBox>;
-  using Variant = std::variant<UnaryExpr, TypeNameCast>;
+  /// the type name is boxed, the common unary operand stays small
+  using Variant = std::variant<UnaryExpr, box<TypeNameCast>>;
 
 public:
   Variant variant_;
 
 public:
-  CastExpr(TokIter begin, Variant &&unaryOrCast)
+  CastExpr(llvm::SMLoc begin, Variant &&unaryOrCast)
       : Node(begin), variant_(MV_(unaryOrCast)) {}
   [[nodiscard]] const Variant &getVariant() const { return variant_; }
 };
 
 /**
- * multiplicative-expression:
- *  cast-expression
- *  multiplicative-expression * cast-expression
- *  multiplicative-expression / cast-expression
- *  multiplicative-expression % cast-expression
- */
-class MultiExpr final : public Node {
-public:
-  enum Op { Multiply, Divide, Modulo };
-
-private:
-  CastExpr castExpr_;
-  std::vector<std::pair<Op, CastExpr>> optionalCastExps_;
-
-public:
-  explicit MultiExpr(TokIter begin, CastExpr &&castExpr,
-                     std::vector<std::pair<Op, CastExpr>> &&optionalCastExps)
-      : Node(begin), castExpr_(MV_(castExpr)),
-        optionalCastExps_(MV_(optionalCastExps)) {}
-  [[nodiscard]] const CastExpr &getCastExpr() const { return castExpr_; }
-  [[nodiscard]] const std::vector<std::pair<Op, CastExpr>> &
-  getOptionalCastExps() const {
-    return optionalCastExps_;
-  }
-};
-
-/**
- * additive-expression:
- * multiplicative-expression
- * additive-expression + multiplicative-expression
- * additive-expression - multiplicative-expression
- */
-class AdditiveExpr final : public Node {
-public:
-  enum Op { Plus, Minus };
-
-private:
-  MultiExpr multiExpr_;
-  std::vector<std::pair<Op, MultiExpr>> optionalMultiExps_;
-
-public:
-  AdditiveExpr(TokIter begin, MultiExpr &&multiExpr,
-               std::vector<std::pair<Op, MultiExpr>> &&optionalMultiExps)
-      : Node(begin), multiExpr_(MV_(multiExpr)),
-        optionalMultiExps_(MV_(optionalMultiExps)) {}
-  [[nodiscard]] const MultiExpr &getMultiExpr() const { return multiExpr_; }
-  [[nodiscard]] const std::vector<std::pair<Op, MultiExpr>> &
-  getOptionalMultiExps() const {
-    return optionalMultiExps_;
-  }
-};
-
-/**
- * shift-expression:
- *      additive-expression
- *      shift-expression << additive-expression
- *      shift-expression >> additive-expression
- */
-class ShiftExpr final : public Node {
-public:
-  enum Op { Right, Left };
-
-private:
-  AdditiveExpr additiveExpr_;
-  std::vector<std::pair<Op, AdditiveExpr>> optionalAdditiveExps_;
-
-public:
-  ShiftExpr(TokIter begin, AdditiveExpr &&additiveExpr,
-            std::vector<std::pair<Op, AdditiveExpr>> &&optionalAdditiveExps)
-      : Node(begin), additiveExpr_(MV_(additiveExpr)),
-        optionalAdditiveExps_(MV_(optionalAdditiveExps)) {}
-  [[nodiscard]] const AdditiveExpr &getAdditiveExpr() const {
-    return additiveExpr_;
-  }
-  [[nodiscard]] const std::vector<std::pair<Op, AdditiveExpr>> &
-  getOptAdditiveExps() const {
-    return optionalAdditiveExps_;
-  }
-};
-
-/**
- * relational-expression:
- *      shift-expression
- *      relational-expression < shift-expression
- *      relational-expression > shift-expression
- *      relational-expression <= shift-expression
- *      relational-expression >= shift-expression
- */
-class RelationalExpr final : public Node {
-public:
-  enum Op { LessThan, LessThanOrEqual, GreaterThan, GreaterThanOrEqual };
-
-private:
-  ShiftExpr shiftExpr_;
-  std::vector<std::pair<Op, ShiftExpr>> optionalShiftExps_;
-
-public:
-  RelationalExpr(TokIter begin, ShiftExpr &&shiftExpr,
-                 std::vector<std::pair<Op, ShiftExpr>> &&optionalShiftExps)
-      : Node(begin), shiftExpr_(MV_(shiftExpr)),
-        optionalShiftExps_(MV_(optionalShiftExps)) {}
-  [[nodiscard]] const ShiftExpr &getShiftExpr() const { return shiftExpr_; }
-  [[nodiscard]] const std::vector<std::pair<Op, ShiftExpr>> &
-  getOptionalShiftExpressions() const {
-    return optionalShiftExps_;
-  }
-};
-
-/**
- * equality-expression:
- *      relational-expression
- *      equality-expression == relational-expression
- *      equality-expression != relational-expression
- */
-class EqualExpr final : public Node {
-public:
-  enum Op { Equal, NotEqual };
-
-private:
-  RelationalExpr relationalExpr_;
-  std::vector<std::pair<Op, RelationalExpr>> optionalRelationalExps_;
-
-public:
-  EqualExpr(TokIter begin, RelationalExpr &&relationalExpr,
-            std::vector<std::pair<Op, RelationalExpr>> &&optionalRelationalExps)
-      : Node(begin), relationalExpr_(MV_(relationalExpr)),
-        optionalRelationalExps_(MV_(optionalRelationalExps)) {}
-  [[nodiscard]] const RelationalExpr &getRelationalExpr() const {
-    return relationalExpr_;
-  }
-
-  [[nodiscard]] const std::vector<std::pair<Op, RelationalExpr>> &
-  getOptionalRelationalExpr() const {
-    return optionalRelationalExps_;
-  }
-};
-
-/**
- * AND-expression:
- *      equality-expression
- *      AND-expression & equality-expression
- */
-class BitAndExpr final : public Node {
-private:
-  std::vector<EqualExpr> equalExps_;
-
-public:
-  BitAndExpr(TokIter begin, std::vector<EqualExpr> &&equalExps)
-      : Node(begin), equalExps_(MV_(equalExps)) {}
-  [[nodiscard]] const std::vector<EqualExpr> &getEqualExpr() const {
-    return equalExps_;
-  }
-};
-
-/**
- * exclusive-OR-expression:
- *      AND-expression
- *      exclusive-OR-expression ^ AND-expression
- */
-class BitXorExpr final : public Node {
-private:
-  std::vector<BitAndExpr> bitAndExps_;
-
-public:
-  BitXorExpr(TokIter begin, std::vector<BitAndExpr> &&bitAndExps)
-      : Node(begin), bitAndExps_(MV_(bitAndExps)) {}
-  [[nodiscard]] const std::vector<BitAndExpr> &getBitAndExprs() const {
-    return bitAndExps_;
-  }
-};
+ * multiplicative-expression down to logical-OR-expression: every binary
+ * operator is one BinaryExpr, an operand without an operator is the
+ * cast-expression itself. The grammar levels are the precedences the
+ * parser climbs, they leave no nodes behind.
+ *
+ * eg: a + b * c
+ *     BinaryExpr +
+ *       CastExpr a
+ *       BinaryExpr *
+ *         CastExpr b
+ *         CastExpr c
+ */
+using BinaryOperand = std::variant<CastExpr, box<BinaryExpr>>;
+
+class BinaryExpr final : public Node {
+public:
+  /// from the tightest binding to the loosest, see getPrecedence()
+  enum Op : uint8_t {
+    Multiply,
+    Divide,
+    Modulo,
+    Plus,
+    Minus,
+    LeftShift,
+    RightShift,
+    LessThan,
+    LessThanOrEqual,
+    GreaterThan,
+    GreaterThanOrEqual,
+    Equal,
+    NotEqual,
+    BitAnd,
+    BitXor,
+    BitOr,
+    LogicalAnd,
+    LogicalOr
+  };
 
-/**
- * inclusive-OR-expression:
- *      exclusive-OR-expression
- *      inclusive-OR-expression | exclusive-OR-expression
- */
-class BitOrExpr final : public Node {
 private:
-  std::vector<BitXorExpr> bitXorExps_;
+  Op op_;
+  BinaryOperand lhs_;
+  BinaryOperand rhs_;
 
 public:
-  BitOrExpr(TokIter begin, std::vector<BitXorExpr> &&bitXorExps)
-      : Node(begin), bitXorExps_(MV_(bitXorExps)) {}
+  BinaryExpr(llvm::SMLoc begin, Op op, BinaryOperand &&lhs,
+             BinaryOperand &&rhs)
+      : Node(begin), op_(op), lhs_(MV_(lhs)), rhs_(MV_(rhs)) {}
 
-  [[nodiscard]] const std::vector<BitXorExpr> &getBitXorExprs() const {
-    return bitXorExps_;
-  }
-};
-
-/**
- * logical-AND-expression:
- *      inclusive-OR-expression
- *      logical-AND-expression && inclusive-OR-expression
- */
-class LogAndExpr final : public Node {
-private:
-  std::vector<BitOrExpr> bitOrExps_;
+  [[nodiscard]] Op getOperator() const { return op_; }
+  [[nodiscard]] const BinaryOperand &getLhs() const { return lhs_; }
+  [[nodiscard]] const BinaryOperand &getRhs() const { return rhs_; }
 
-public:
-  LogAndExpr(TokIter begin, std::vector<BitOrExpr> &&bitOrExps)
-      : Node(begin), bitOrExps_(MV_(bitOrExps)) {}
-  [[nodiscard]] const std::vector<BitOrExpr> &getBitOrExprs() const {
-    return bitOrExps_;
+  /// 10 for * / % down to 1 for ||, all operators are left associative
+  static constexpr unsigned getPrecedence(Op op) {
+    constexpr unsigned char precedences[] = {10, 10, 10, 9, 9, 8, 8, 7, 7,
+                                             7,  7,  6,  6, 5, 4, 3, 2, 1};
+    return precedences[op];
   }
-};
-
-/**
- * logical-OR-expression:
- *      logical-AND-expression
- *      logical-OR-expression || logical-AND-expression
- */
-class LogOrExpr final : public Node {
-private:
-  std::vector<LogAndExpr> logAndExps_;
-
-public:
-  LogOrExpr(TokIter begin, std::vector<LogAndExpr> &&logAndExps)
-      : Node(begin), logAndExps_(MV_(logAndExps)) {}
-  [[nodiscard]] const std::vector<LogAndExpr> &getLogAndExprs() const {
-    return logAndExps_;
+  static const char *getSpelling(Op op) {
+    constexpr const char *spellings[] = {"*",  "/",  "%", "+",  "-",  "<<",
+                                         ">>", "<",  "<=", ">", ">=", "==",
+                                         "!=", "&",  "^", "|",  "&&", "||"};
+    return spellings[op];
   }
 };
 
@@ -819,19 +658,19 @@ public:
  */
 class CondExpr final : public Node {
 private:
-  LogOrExpr logOrExpr_;
+  BinaryOperand logOrExpr_;
   std::optional<box<Expr>> optionalExpr_;
   std::optional<box<CondExpr>> optionalCondExpr_;
 
 public:
   explicit CondExpr(
-      TokIter begin, LogOrExpr &&logOrExpr,
+      llvm::SMLoc begin, BinaryOperand &&logOrExpr,
       std::optional<box<Expr>> &&optionalExpr = {std::nullopt},
       std::optional<box<CondExpr>> &&optionalCondExpr = {std::nullopt})
       : Node(begin), logOrExpr_(MV_(logOrExpr)),
         optionalExpr_(MV_(optionalExpr)),
         optionalCondExpr_(MV_(optionalCondExpr)) {}
-  [[nodiscard]] const LogOrExpr &getLogicalOrExpression() const {
+  [[nodiscard]] const BinaryOperand &getLogicalOrExpression() const {
     return logOrExpr_;
   }
   [[nodiscard]] const Expr *getOptionalExpression() const {
@@ -881,16 +720,16 @@ public:
 
 private:
   CondExpr condExpr_;
-  std::vector<std::pair<AssignOp, CondExpr>> optionalConditionExpr_;
+  ArenaVector<std::pair<AssignOp, CondExpr>> optionalConditionExpr_;
 
 public:
-  AssignExpr(TokIter begin, CondExpr &&conditionalExpression,
-             std::vector<std::pair<AssignOp, CondExpr>> &&optionalConditionExpr)
+  AssignExpr(llvm::SMLoc begin, CondExpr &&conditionalExpression,
+             ArenaVector<std::pair<AssignOp, CondExpr>> &&optionalConditionExpr)
       : Node(begin), condExpr_(MV_(conditionalExpression)),
         optionalConditionExpr_(MV_(optionalConditionExpr)) {}
 
   [[nodiscard]] const CondExpr &getConditionalExpr() const { return condExpr_; }
-  [[nodiscard]] const std::vector<std::pair<AssignOp, CondExpr>> &
+  [[nodiscard]] const ArenaVector<std::pair<AssignOp, CondExpr>> &
   getOptionalConditionalExpr() const {
     return optionalConditionExpr_;
   }
@@ -903,13 +742,13 @@ public:
  */
 class Expr final : public Node {
 private:
-  std::vector<AssignExpr> assignExpressions_;
+  ArenaVector<AssignExpr> assignExpressions_;
 
 public:
-  Expr(TokIter begin, std::vector<AssignExpr> &&assignExpressions)
+  Expr(llvm::SMLoc begin, ArenaVector<AssignExpr> &&assignExpressions)
       : Node(begin), assignExpressions_(MV_(assignExpressions)) {}
 
-  const std::vector<AssignExpr> &getAssignExpressions() const {
+  const ArenaVector<AssignExpr> &getAssignExpressions() const {
     return assignExpressions_;
   }
 };
@@ -929,7 +768,7 @@ private:
   std::optional<ExprBox> optionalExpr_;
 
 public:
-  ExprStmt(TokIter begin,
+  ExprStmt(llvm::SMLoc begin,
            std::optional<ExprBox> &&optionalExpr = {std::nullopt})
       : Node(begin), optionalExpr_(MV_(optionalExpr)) {}
   [[nodiscard]] const Expr *getOptionalExpression() const {
@@ -957,7 +796,7 @@ private:
   std::optional<Stmt> optionalElseStmt_;
 
 public:
-  IfStmt(TokIter begin, Expr &&expr, Stmt &&thenStmt,
+  IfStmt(llvm::SMLoc begin, Expr &&expr, Stmt &&thenStmt,
          std::optional<Stmt> &&optionalElseStmt = {std::nullopt})
       : Node(begin), expr_(MV_(expr)), thenStmt_(MV_(thenStmt)),
         optionalElseStmt_(MV_(optionalElseStmt)) {}
@@ -984,7 +823,7 @@ private:
   Stmt stmt_;
 
 public:
-  SwitchStmt(TokIter begin, Expr &&expression, Stmt &&statement)
+  SwitchStmt(llvm::SMLoc begin, Expr &&expression, Stmt &&statement)
       : Node(begin), expr_(MV_(expression)), stmt_(MV_(statement)) {}
 
   [[nodiscard]] const Expr &getExpression() const { return expr_; }
@@ -1001,7 +840,7 @@ private:
   Stmt stmt_;
 
 public:
-  DefaultStmt(TokIter begin, Stmt &&statement)
+  DefaultStmt(llvm::SMLoc begin, Stmt &&statement)
       : Node(begin), stmt_(MV_(statement)) {}
   [[nodiscard]] const Stmt &getStatement() const { return stmt_; }
 };
@@ -1016,7 +855,7 @@ private:
   Stmt stmt_;
 
 public:
-  CaseStmt(TokIter begin, ConstantExpr &&constantExpr, Stmt &&stmt)
+  CaseStmt(llvm::SMLoc begin, ConstantExpr &&constantExpr, Stmt &&stmt)
       : Node(begin), constantExpr_(MV_(constantExpr)), stmt_(MV_(stmt)) {}
 
   [[nodiscard]] const ConstantExpr &getConstantExpr() const {
@@ -1034,7 +873,7 @@ private:
   std::string_view mIdentifier;
 
 public:
-  LabelStmt(TokIter begin, std::string_view identifier)
+  LabelStmt(llvm::SMLoc begin, std::string_view identifier)
       : Node(begin), mIdentifier(identifier) {}
   [[nodiscard]] std::string_view getIdentifier() const { return mIdentifier; }
 };
@@ -1048,7 +887,7 @@ private:
   std::string_view mIdentifier;
 
 public:
-  GotoStmt(TokIter begin, std::string_view identifier)
+  GotoStmt(llvm::SMLoc begin, std::string_view identifier)
       : Node(begin), mIdentifier(identifier) {}
   [[nodiscard]] std::string_view getIdentifier() const { return mIdentifier; }
 };
@@ -1063,7 +902,7 @@ private:
   Expr expr_;
 
 public:
-  DoWhileStmt(TokIter begin, Stmt &&stmt, Expr &&expr)
+  DoWhileStmt(llvm::SMLoc begin, Stmt &&stmt, Expr &&expr)
       : Node(begin), stmt_(MV_(stmt)), expr_(MV_(expr)) {}
   [[nodiscard]] const Stmt &getStatement() const { return stmt_; }
   [[nodiscard]] const Expr &getExpression() const { return expr_; }
@@ -1079,7 +918,7 @@ private:
   Stmt stmt_;
 
 public:
-  WhileStmt(TokIter begin, Expr &&expr, Stmt &&stmt)
+  WhileStmt(llvm::SMLoc begin, Expr &&expr, Stmt &&stmt)
       : Node(begin), expr_(MV_(expr)), stmt_(MV_(stmt)) {}
   [[nodiscard]] const Expr &getExpression() const { return expr_; }
   [[nodiscard]] const Stmt &getStatement() const { return stmt_; }
@@ -1098,7 +937,7 @@ private:
   Stmt stmt_;
 
 public:
-  ForStmt(TokIter begin, Stmt stmt,
+  ForStmt(llvm::SMLoc begin, Stmt stmt,
           std::variant<box<Declaration>, std::optional<Expr>> &&initial,
           std::optional<Expr> &&controlExpr = {std::nullopt},
           std::optional<Expr> &&postExpr = {std::nullopt})
@@ -1130,7 +969,7 @@ public:
  */
 class BreakStmt final : public Node {
 public:
-  BreakStmt(TokIter begin) : Node(begin) {}
+  BreakStmt(llvm::SMLoc begin) : Node(begin) {}
 };
 
 /**
@@ -1139,7 +978,7 @@ public:
  */
 class ContinueStmt final : public Node {
 public:
-  ContinueStmt(TokIter begin) : Node(begin) {}
+  ContinueStmt(llvm::SMLoc begin) : Node(begin) {}
 };
 
 /**
@@ -1151,7 +990,7 @@ private:
   std::optional<Expr> optionalExpr_;
 
 public:
-  ReturnStmt(TokIter begin, std::optional<Expr> &&optionalExpr = {std::nullopt})
+  ReturnStmt(llvm::SMLoc begin, std::optional<Expr> &&optionalExpr = {std::nullopt})
       : Node(begin), optionalExpr_(MV_(optionalExpr)) {}
   [[nodiscard]] const Expr *getExpression() const {
     if (optionalExpr_) {
@@ -1161,18 +1000,61 @@ public:
   }
 };
 
+/**
+ * A run of initializer-list elements that are each a plain constant: a
+ * numeric or char constant, optionally negated, followed by ',' or '}'.
+ *  eg:
+ *      static const int table[] = { 1, -2, 'c', 0x7f, ... };
+ *  The values are packed into one typed array instead of an assignment
+ *  expression chain per element. All values have the type the constant
+ *  would have as a primary expression (a negated one keeps the type), a
+ *  change of type starts a new run.
+ *
+ *  The bytes of an #embed resource are a ConstantArray as well, one element
+ *  per byte. They are kept as a view of the mapped file and never copied.
+ *  eg:
+ *      static const unsigned char firmware[] = {
+ *      #embed "firmware.bin"
+ *      };
+ */
+class ConstantArray final : public Node {
+public:
+  using Variant =
+      std::variant<ArenaVector<int32_t>, ArenaVector<uint32_t>,
+                   ArenaVector<int64_t>, ArenaVector<uint64_t>,
+                   ArenaVector<float>, ArenaVector<double>,
+                   llvm::ArrayRef<uint8_t>>;
+
+private:
+  Variant elements_;
+
+public:
+  ConstantArray(llvm::SMLoc begin, Variant &&elements)
+      : Node(begin), elements_(MV_(elements)) {}
+
+  [[nodiscard]] const Variant &getElements() const { return elements_; }
+
+  [[nodiscard]] size_t size() const {
+    return std::visit([](const auto &values) { return values.size(); },
+                      elements_);
+  }
+};
+
 /**
  * initializer:
  *  assignment-expression
  *  { initializer-list }
  *  { initializer-list , }
+ *
+ *  A ConstantArray only appears as an element of an initializer-list, where
+ *  it stands for size() consecutive undesignated initializers.
  */
 class Initializer final : public Node {
-  using Variant = std::variant<AssignExpr, box<InitializerList>>;
+  using Variant = std::variant<AssignExpr, box<InitializerList>, ConstantArray>;
   Variant variant_;
 
 public:
-  Initializer(TokIter begin, Variant &&variant)
+  Initializer(llvm::SMLoc begin, Variant &&variant)
       : Node(begin), variant_(MV_(variant)) {}
 
   [[nodiscard]] const Variant &getVariant() const { return variant_; }
@@ -1202,19 +1084,19 @@ class InitializerList final : public Node {
 public:
   using Identifier = std::string_view;
   using Designator = std::variant<ConstantExpr, Identifier>;
-  using DesignatorList = std::vector<Designator>;
+  using DesignatorList = ArenaVector<Designator>;
   using Designation = DesignatorList;
   using InitializerPair = std::pair<std::optional<Designation>, Initializer>;
 
 private:
-  std::vector<InitializerPair> initializerPairs_;
+  ArenaVector<InitializerPair> initializerPairs_;
 
 public:
-  InitializerList(TokIter begin,
-                  std::vector<InitializerPair> &&initializerPairs)
+  InitializerList(llvm::SMLoc begin,
+                  ArenaVector<InitializerPair> &&initializerPairs)
       : Node(begin), initializerPairs_(MV_(initializerPairs)) {}
 
-  const std::vector<InitializerPair> &getInitializerList() const {
+  const ArenaVector<InitializerPair> &getInitializerList() const {
     return initializerPairs_;
   }
 };
@@ -1234,24 +1116,24 @@ public:
 class Declaration final : public Node {
 public:
   struct InitDeclarator {
-    TokIter beginLoc_;
+    llvm::SMLoc beginLoc_;
     box<Declarator> declarator_;
     std::optional<Initializer> optionalInitializer_;
   };
 
 private:
   DeclSpec declarationSpecifiers_;
-  std::vector<InitDeclarator> initDeclarators_;
+  ArenaVector<InitDeclarator> initDeclarators_;
 
 public:
-  Declaration(TokIter begin, DeclSpec &&declarationSpecifiers,
-              std::vector<InitDeclarator> &&initDeclarators)
+  Declaration(llvm::SMLoc begin, DeclSpec &&declarationSpecifiers,
+              ArenaVector<InitDeclarator> &&initDeclarators)
       : Node(begin), declarationSpecifiers_(MV_(declarationSpecifiers)),
         initDeclarators_(MV_(initDeclarators)) {}
   [[nodiscard]] const DeclSpec &getDeclarationSpecifiers() const {
     return declarationSpecifiers_;
   }
-  [[nodiscard]] const std::vector<InitDeclarator> &getInitDeclarators() const {
+  [[nodiscard]] const ArenaVector<InitDeclarator> &getInitDeclarators() const {
     return initDeclarators_;
   }
 };
@@ -1270,12 +1152,12 @@ using BlockItem = std::variant<Stmt, Declaration>;
  */
 class BlockStmt final : public Node {
 private:
-  std::vector<BlockItem> blockItems_;
+  ArenaVector<BlockItem> blockItems_;
 
 public:
-  BlockStmt(TokIter begin, std::vector<BlockItem> &&blockItems)
+  BlockStmt(llvm::SMLoc begin, ArenaVector<BlockItem> &&blockItems)
       : Node(begin), blockItems_(MV_(blockItems)) {}
-  [[nodiscard]] const std::vector<BlockItem> &getBlockItems() const {
+  [[nodiscard]] const ArenaVector<BlockItem> &getBlockItems() const {
     return blockItems_;
   }
 };
@@ -1318,13 +1200,13 @@ using DirectDeclarator =
  *  type-qualifier-list{opt} pointer
  */
 class Pointer final : public Node {
-  std::vector<TypeQualifier> typeQualifiers_;
+  ArenaVector<TypeQualifier> typeQualifiers_;
 
 public:
-  Pointer(TokIter begin, std::vector<TypeQualifier> &&typeQualifiers)
+  Pointer(llvm::SMLoc begin, ArenaVector<TypeQualifier> &&typeQualifiers)
       : Node(begin), typeQualifiers_(MV_(typeQualifiers)) {}
 
-  [[nodiscard]] const std::vector<TypeQualifier> &getTypeQualifiers() const {
+  [[nodiscard]] const ArenaVector<TypeQualifier> &getTypeQualifiers() const {
     return typeQualifiers_;
   }
 };
@@ -1335,17 +1217,17 @@ public:
  *  pointer{opt} direct-abstract-declarator
  */
 class AbstractDeclarator final : public Node {
-  std::vector<Pointer> pointers_;
+  ArenaVector<Pointer> pointers_;
   std::optional<DirectAbstractDeclarator> directAbstractDeclarator_;
 
 public:
-  AbstractDeclarator(TokIter begin, std::vector<Pointer> &&pointers,
+  AbstractDeclarator(llvm::SMLoc begin, ArenaVector<Pointer> &&pointers,
                      std::optional<DirectAbstractDeclarator>
                          &&directAbstractDeclarator = {std::nullopt})
       : Node(begin), pointers_(MV_(pointers)),
         directAbstractDeclarator_(MV_(directAbstractDeclarator)) {}
 
-  [[nodiscard]] const std::vector<Pointer> &getPointers() const {
+  [[nodiscard]] const ArenaVector<Pointer> &getPointers() const {
     return pointers_;
   }
 
@@ -1363,16 +1245,16 @@ public:
  *  pointer{opt} direct-declarator
  */
 class Declarator final : public Node {
-  std::vector<Pointer> pointers_;
+  ArenaVector<Pointer> pointers_;
   DirectDeclarator directDeclarator_;
 
 public:
-  Declarator(TokIter begin, std::vector<Pointer> &&pointers,
+  Declarator(llvm::SMLoc begin, ArenaVector<Pointer> &&pointers,
              DirectDeclarator &&directDeclarator)
       : Node(begin), pointers_(MV_(pointers)),
         directDeclarator_(MV_(directDeclarator)) {}
 
-  [[nodiscard]] const std::vector<Pointer> &getPointers() const {
+  [[nodiscard]] const ArenaVector<Pointer> &getPointers() const {
     return pointers_;
   }
 
@@ -1393,7 +1275,7 @@ public:
   Variant declaratorKind_;
 
 public:
-  ParameterDeclaration(TokIter begin, DeclSpec &&declSpec,
+  ParameterDeclaration(llvm::SMLoc begin, DeclSpec &&declSpec,
                        Variant &&variant = {std::nullopt})
       : Node(begin), declSpec_(MV_(declSpec)), declaratorKind_(MV_(variant)) {}
   [[nodiscard]] const DeclSpec &getDeclSpec() const { return declSpec_; }
@@ -1406,13 +1288,13 @@ public:
  */
 class ParamList final : public Node {
 private:
-  std::vector<ParameterDeclaration> parameterList_;
+  ArenaVector<ParameterDeclaration> parameterList_;
 
 public:
-  ParamList(TokIter begin, std::vector<ParameterDeclaration> &&parameterList)
+  ParamList(llvm::SMLoc begin, ArenaVector<ParameterDeclaration> &&parameterList)
       : Node(begin), parameterList_(MV_(parameterList)) {}
 
-  [[nodiscard]] const std::vector<ParameterDeclaration> &
+  [[nodiscard]] const ArenaVector<ParameterDeclaration> &
   getParameterDeclarations() const {
     return parameterList_;
   }
@@ -1428,7 +1310,7 @@ class ParamTypeList final : public Node {
   bool hasEllipse_;
 
 public:
-  ParamTypeList(TokIter begin, ParamList &&parameterList, bool hasEllipse)
+  ParamTypeList(llvm::SMLoc begin, ParamList &&parameterList, bool hasEllipse)
       : Node(begin), parameterList_(MV_(parameterList)),
         hasEllipse_(hasEllipse) {}
 
@@ -1447,7 +1329,7 @@ class DirectAbstractDeclaratorParentheses final : public Node {
   AbstractDeclarator abstractDeclarator_;
 
 public:
-  DirectAbstractDeclaratorParentheses(TokIter begin,
+  DirectAbstractDeclaratorParentheses(llvm::SMLoc begin,
                                       AbstractDeclarator &&abstractDeclarator)
       : Node(begin), abstractDeclarator_(MV_(abstractDeclarator)) {}
 
@@ -1467,15 +1349,15 @@ public:
  */
 class DirectAbstractDeclaratorAssignExpr final : public Node {
   std::optional<DirectAbstractDeclarator> optionalDirectAbstractDeclarator_;
-  std::vector<TypeQualifier> typeQualifiers_;
+  ArenaVector<TypeQualifier> typeQualifiers_;
   std::optional<AssignExpr> optionalAssignExpr_;
   bool hasStatic_{false};
 
 public:
   DirectAbstractDeclaratorAssignExpr(
-      TokIter begin,
+      llvm::SMLoc begin,
       std::optional<DirectAbstractDeclarator> &&directAbstractDeclarator,
-      std::vector<TypeQualifier> &&typeQualifiers,
+      ArenaVector<TypeQualifier> &&typeQualifiers,
       std::optional<AssignExpr> &&assignExpr, bool hasStatic)
       : Node(begin),
         optionalDirectAbstractDeclarator_(MV_(directAbstractDeclarator)),
@@ -1490,7 +1372,7 @@ public:
     return nullptr;
   }
 
-  [[nodiscard]] const std::vector<TypeQualifier> &getTypeQualifiers() const {
+  [[nodiscard]] const ArenaVector<TypeQualifier> &getTypeQualifiers() const {
     return typeQualifiers_;
   }
 
@@ -1510,7 +1392,7 @@ class DirectAbstractDeclaratorAsterisk final : public Node {
 
 public:
   DirectAbstractDeclaratorAsterisk(
-      TokIter begin,
+      llvm::SMLoc begin,
       std::optional<DirectAbstractDeclarator> &&directAbstractDeclarator)
       : Node(begin),
         optionalDirectAbstractDeclarator_(MV_(directAbstractDeclarator)) {}
@@ -1534,7 +1416,7 @@ class DirectAbstractDeclaratorParamTypeList final : public Node {
 
 public:
   DirectAbstractDeclaratorParamTypeList(
-      TokIter begin,
+      llvm::SMLoc begin,
       std::optional<DirectAbstractDeclarator> &&directAbstractDeclarator,
       std::optional<ParamTypeList> &&paramTypeList)
       : Node(begin),
@@ -1563,12 +1445,16 @@ public:
  */
 class DirectDeclaratorIdent final : public Node {
   std::string_view mIdent;
+  uint32_t mIdentifierId;
 
 public:
-  DirectDeclaratorIdent(TokIter begin, std::string_view ident)
-      : Node(begin), mIdent(ident) {}
+  DirectDeclaratorIdent(llvm::SMLoc begin, std::string_view ident,
+                        uint32_t identifierId)
+      : Node(begin), mIdent(ident), mIdentifierId(identifierId) {}
 
   [[nodiscard]] const std::string_view &getIdent() const { return mIdent; }
+  /// id of the name in the IdentifierTable
+  [[nodiscard]] uint32_t getIdentifierId() const { return mIdentifierId; }
 };
 
 /**
@@ -1579,7 +1465,7 @@ class DirectDeclaratorParentheses final : public Node {
   Declarator declarator_;
 
 public:
-  DirectDeclaratorParentheses(TokIter begin, Declarator &&declarator)
+  DirectDeclaratorParentheses(llvm::SMLoc begin, Declarator &&declarator)
       : Node(begin), declarator_(MV_(declarator)) {}
 
   [[nodiscard]] const Declarator &getDeclarator() const { return declarator_; }
@@ -1594,7 +1480,7 @@ class DirectDeclaratorParamTypeList final : public Node {
   ParamTypeList paramTypeList_;
 
 public:
-  DirectDeclaratorParamTypeList(TokIter begin,
+  DirectDeclaratorParamTypeList(llvm::SMLoc begin,
                                 DirectDeclarator &&directDeclarator,
                                 ParamTypeList &&paramTypeList)
       : Node(begin), directDeclarator_(MV_(directDeclarator)),
@@ -1618,13 +1504,13 @@ public:
 class DirectDeclaratorAssignExpr final : public Node {
   DirectDeclarator directDeclarator_;
   std::optional<AssignExpr> optionalAssignExpr_;
-  std::vector<TypeQualifier> typeQualifierList_;
+  ArenaVector<TypeQualifier> typeQualifierList_;
   bool hasStatic_{false};
 
 public:
   DirectDeclaratorAssignExpr(
-      TokIter begin, DirectDeclarator &&directDeclarator,
-      std::vector<TypeQualifier> &&typeQualifierList,
+      llvm::SMLoc begin, DirectDeclarator &&directDeclarator,
+      ArenaVector<TypeQualifier> &&typeQualifierList,
       std::optional<AssignExpr> &&assignExpr = {std::nullopt},
       bool hasStatic = false)
       : Node(begin), directDeclarator_(MV_(directDeclarator)),
@@ -1635,7 +1521,7 @@ public:
     return directDeclarator_;
   }
 
-  [[nodiscard]] const std::vector<TypeQualifier> &getTypeQualifierList() const {
+  [[nodiscard]] const ArenaVector<TypeQualifier> &getTypeQualifierList() const {
     return typeQualifierList_;
   }
 
@@ -1655,11 +1541,11 @@ public:
  */
 class DirectDeclaratorAsterisk final : public Node {
   DirectDeclarator directDeclarator_;
-  std::vector<TypeQualifier> typeQualifierList_;
+  ArenaVector<TypeQualifier> typeQualifierList_;
 
 public:
-  DirectDeclaratorAsterisk(TokIter begin, DirectDeclarator &&directDeclarator,
-                           std::vector<TypeQualifier> &&typeQualifierList)
+  DirectDeclaratorAsterisk(llvm::SMLoc begin, DirectDeclarator &&directDeclarator,
+                           ArenaVector<TypeQualifier> &&typeQualifierList)
       : Node(begin), directDeclarator_(MV_(directDeclarator)),
         typeQualifierList_(MV_(typeQualifierList)) {}
 
@@ -1667,7 +1553,7 @@ public:
     return directDeclarator_;
   }
 
-  [[nodiscard]] const std::vector<TypeQualifier> &getTypeQualifierList() const {
+  [[nodiscard]] const ArenaVector<TypeQualifier> &getTypeQualifierList() const {
     return typeQualifierList_;
   }
 };
@@ -1695,24 +1581,24 @@ public:
 class StructOrUnionSpec final : public Node {
 public:
   struct StructDeclarator {
-    TokIter beginLoc_;
+    llvm::SMLoc beginLoc_;
     std::optional<Declarator> optionalDeclarator_;
     std::optional<ConstantExpr> optionalBitfield_;
   };
   struct StructDeclaration {
-    TokIter beginLoc_;
+    llvm::SMLoc beginLoc_;
     DeclSpec specifierQualifiers_;
-    std::vector<StructDeclarator> structDeclarators_;
+    ArenaVector<StructDeclarator> structDeclarators_;
   };
 
 private:
   std::string_view name_;
   bool isUnion_;
-  std::vector<StructDeclaration> structDeclarations_;
+  ArenaVector<StructDeclaration> structDeclarations_;
 
 public:
-  StructOrUnionSpec(TokIter begin, bool isUnion, std::string_view identifier,
-                    std::vector<StructDeclaration> &&structDeclarations)
+  StructOrUnionSpec(llvm::SMLoc begin, bool isUnion, std::string_view identifier,
+                    ArenaVector<StructDeclaration> &&structDeclarations)
       : Node(begin), name_(identifier), isUnion_(isUnion),
         structDeclarations_(MV_(structDeclarations)) {}
 
@@ -1720,7 +1606,7 @@ public:
 
   [[nodiscard]] std::string_view getTag() const { return name_; }
 
-  [[nodiscard]] const std::vector<StructDeclaration> &
+  [[nodiscard]] const ArenaVector<StructDeclaration> &
   getStructDeclarations() const {
     return structDeclarations_;
   }
@@ -1746,22 +1632,22 @@ public:
 class EnumSpecifier final : public Node {
 public:
   struct Enumerator {
-    TokIter beginLoc_;
+    llvm::SMLoc beginLoc_;
     std::string_view name_;
     std::optional<ConstantExpr> optionalConstantExpr_{std::nullopt};
   };
 
 private:
   std::string_view tagName_;
-  std::vector<Enumerator> enumerators_;
+  ArenaVector<Enumerator> enumerators_;
 
 public:
-  EnumSpecifier(TokIter begin, std::string_view tagName,
-                std::vector<Enumerator> &&enumerators)
+  EnumSpecifier(llvm::SMLoc begin, std::string_view tagName,
+                ArenaVector<Enumerator> &&enumerators)
       : Node(begin), tagName_(tagName), enumerators_(MV_(enumerators)) {}
 
   [[nodiscard]] std::string_view getName() const { return tagName_; }
-  [[nodiscard]] const std::vector<Enumerator> &getEnumerators() const {
+  [[nodiscard]] const ArenaVector<Enumerator> &getEnumerators() const {
     return enumerators_;
   }
 };
@@ -1770,13 +1656,25 @@ public:
  * function-definition:
  *  declaration-specifiers declarator declaration-list{opt} compound-statement
  */
+/// A function body the parser has only found the extent of, parsed when it
+/// is first needed. Lives in the ASTContext like the nodes.
+class LazyFunctionBody {
+public:
+  virtual BlockStmt parse() = 0;
+
+protected:
+  ~LazyFunctionBody() = default;
+};
+
 class FunctionDefinition final : public Node {
   DeclSpec declarationSpecifiers_;
   Declarator declarator_;
-  BlockStmt compoundStmt_;
+  mutable BlockStmt compoundStmt_;
+  /// set until the body is first asked for
+  mutable LazyFunctionBody *lazyBody_{nullptr};
 
 public:
-  FunctionDefinition(TokIter begin, DeclSpec &&declarationSpecifiers,
+  FunctionDefinition(llvm::SMLoc begin, DeclSpec &&declarationSpecifiers,
                      Declarator &&declarator, BlockStmt &&compoundStmt)
       : Node(begin), declarationSpecifiers_(MV_(declarationSpecifiers)),
         declarator_(MV_(declarator)), compoundStmt_(MV_(compoundStmt)) {}
@@ -1787,9 +1685,23 @@ public:
 
   [[nodiscard]] const Declarator &getDeclarator() const { return declarator_; }
 
+  /// parses a lazy body on the first call, which is not thread safe
   [[nodiscard]] const BlockStmt &getCompoundStatement() const {
+    if (lazyBody_) {
+      compoundStmt_ = lazyBody_->parse();
+      lazyBody_ = nullptr;
+    }
     return compoundStmt_;
   }
+
+  [[nodiscard]] bool isBodyParsed() const { return !lazyBody_; }
+
+  /// for a parser that fills in the body after the declaration
+  void setCompoundStatement(BlockStmt &&compoundStmt) {
+    compoundStmt_ = MV_(compoundStmt);
+    lazyBody_ = nullptr;
+  }
+  void setLazyBody(LazyFunctionBody *body) { lazyBody_ = body; }
 };
 
 /**
@@ -1805,16 +1717,23 @@ using ExternalDeclaration = std::variant<Declaration, FunctionDefinition>;
  *  translation-unit external-declaration
  */
 class TranslationUnit final {
-  std::vector<ExternalDeclaration> mGlobals;
+  /// the tree is torn down with the arena, no node destructor runs
+  std::unique_ptr<ASTContext> mContext;
+  ArenaVector<ExternalDeclaration> *mGlobals;
 
 public:
-  explicit TranslationUnit(TokIter begin,
-                           std::vector<ExternalDeclaration> &&globals) noexcept
-      : mGlobals(MV_(globals)) {}
+  explicit TranslationUnit(llvm::SMLoc begin,
+                           std::unique_ptr<ASTContext> context,
+                           ArenaVector<ExternalDeclaration> &&globals) noexcept
+      : mContext(MV_(context)),
+        mGlobals(mContext->create<ArenaVector<ExternalDeclaration>>(
+            MV_(globals))) {}
 
-  [[nodiscard]] const std::vector<ExternalDeclaration> &getGlobals() const {
-    return mGlobals;
+  [[nodiscard]] const ArenaVector<ExternalDeclaration> &getGlobals() const {
+    return *mGlobals;
   }
+
+  [[nodiscard]] const ASTContext &getContext() const { return *mContext; }
 };
 } // namespace lcc::Syntax
 
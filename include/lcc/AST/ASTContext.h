@@ -0,0 +1,149 @@
+/***********************************
+ * File:     ASTContext.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/14
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_ASTCONTEXT_H
+#define LCC_ASTCONTEXT_H
+#include "llvm/Support/Allocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lcc {
+/// The arena a translation unit's syntax tree lives in. Boxed nodes, the
+/// element arrays of node lists and string constants are bump allocated
+/// here and never destroyed one by one: the slabs are released in bulk
+/// with the context, so nothing in the tree may own memory outside it.
+///
+/// The context nodes are created in is the one installed on the building
+/// thread by an ASTContext::Scope, which lets a node still be boxed by
+/// converting it to a box.
+class ASTContext {
+private:
+  llvm::BumpPtrAllocator mAllocator;
+  size_t mNumAllocations{0};
+  /// contexts of trees built on other threads and linked into this one
+  std::vector<std::unique_ptr<ASTContext>> mAdopted;
+  /// the objects of createOwned(), destroyed last to first
+  std::vector<std::pair<void *, void (*)(void *)>> mOwned;
+  static inline thread_local ASTContext *Current{nullptr};
+
+public:
+  ASTContext() = default;
+  ~ASTContext() {
+    for (auto iter = mOwned.rbegin(); iter != mOwned.rend(); ++iter) {
+      iter->second(iter->first);
+    }
+  }
+  ASTContext(const ASTContext &) = delete;
+  ASTContext &operator=(const ASTContext &) = delete;
+
+  /// installs a context on this thread for as long as it lives
+  class Scope {
+    ASTContext *mPrevious;
+
+  public:
+    explicit Scope(ASTContext &context) : mPrevious(Current) {
+      Current = &context;
+    }
+    ~Scope() { Current = mPrevious; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  static ASTContext &current() {
+    assert(Current && "no ASTContext installed on this thread");
+    return *Current;
+  }
+
+  void *allocate(size_t size, size_t alignment) {
+    ++mNumAllocations;
+    return mAllocator.Allocate(size, alignment);
+  }
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  /// create() for the rare object that holds memory outside the arena, it
+  /// is destroyed with the context
+  template <typename T, typename... Args> T *createOwned(Args &&...args) {
+    T *object = create<T>(std::forward<Args>(args)...);
+    mOwned.emplace_back(object,
+                        [](void *owned) { static_cast<T *>(owned)->~T(); });
+    return object;
+  }
+
+  std::string_view copyString(std::string_view str) {
+    char *data = static_cast<char *>(allocate(str.size(), 1));
+    std::copy(str.begin(), str.end(), data);
+    return {data, str.size()};
+  }
+
+  /// keeps \p context alive as long as this one, nodes in here may point
+  /// into it
+  void adopt(std::unique_ptr<ASTContext> context) {
+    mAdopted.push_back(std::move(context));
+  }
+
+  [[nodiscard]] size_t getNumAllocations() const {
+    size_t count = mNumAllocations;
+    for (const auto &context : mAdopted) {
+      count += context->getNumAllocations();
+    }
+    return count;
+  }
+  [[nodiscard]] size_t getBytesAllocated() const {
+    size_t bytes = mAllocator.getBytesAllocated();
+    for (const auto &context : mAdopted) {
+      bytes += context->getBytesAllocated();
+    }
+    return bytes;
+  }
+};
+
+/// std allocator handing out memory of the current ASTContext; freeing is
+/// a no-op, a grown list leaves its old array to the arena
+template <typename T> class ArenaAllocator {
+  template <typename U> friend class ArenaAllocator;
+  ASTContext *mContext;
+
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+
+  ArenaAllocator() : mContext(&ASTContext::current()) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : mContext(other.mContext) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(mContext->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *, size_t) {}
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+    return mContext == other.mContext;
+  }
+  template <typename U> bool operator!=(const ArenaAllocator<U> &other) const {
+    return mContext != other.mContext;
+  }
+};
+
+/// a list of syntax nodes, its array in the current ASTContext
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+} // namespace lcc
+
+#endif // LCC_ASTCONTEXT_H
@@ -0,0 +1,54 @@
+/***********************************
+ * File:     SyntaxBox.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/14
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_SYNTAXBOX_H
+#define LCC_SYNTAXBOX_H
+
+#include "lcc/AST/ASTContext.h"
+#include <type_traits>
+namespace lcc::Syntax {
+
+/// Owner of a syntax node in the current ASTContext. The node is never
+/// destroyed through the box, it goes with the arena, so a box is a plain
+/// pointer that moves. lcc::box is the owning one for trees outside an
+/// arena.
+template <typename T> class box {
+  T *impl_;
+
+public:
+  // Automatic construction from a `T`, not a `T*`
+  box(T &&obj) : impl_(ASTContext::current().create<T>(std::move(obj))) {}
+
+  box(box &&other) : impl_(other.impl_) { other.impl_ = nullptr; }
+
+  box &operator=(box &&other) {
+    if (this != &other) {
+      impl_ = other.impl_;
+      other.impl_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~box() = default;
+
+  // Access propagates const ness.
+  T &operator*() { return *impl_; }
+  const T &operator*() const { return *impl_; }
+
+  T *operator->() { return impl_; }
+  const T *operator->() const { return impl_; }
+
+  T *get() { return impl_; }
+  const T *get() const { return impl_; }
+};
+} // namespace lcc::Syntax
+
+#endif // LCC_SYNTAXBOX_H
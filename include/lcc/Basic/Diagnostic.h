@@ -10,6 +10,7 @@
 
 #ifndef LCC_DIAGNOSTIC_H
 #define LCC_DIAGNOSTIC_H
+#include "lcc/Basic/SourceManager.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/SMLoc.h"
 #include "llvm/Support/FormatVariadic.h"
@@ -26,38 +27,100 @@ enum {
 #define DiagReport(obj, loc, id, ...) obj.report(__FILE__, __LINE__), obj.report(loc, id, ##__VA_ARGS__)
 
 class DiagnosticEngine {
+public:
+  /// What an engine reported while the buffer was installed: the printed
+  /// text and what it counts for, to be replayed by emitBuffered().
+  struct Buffer {
+    std::string text;
+    unsigned numErrors{0};
+    bool suppressAll{false};
+  };
+
+private:
   static const char *getDiagnosticText(unsigned DiagID);
 
   static llvm::SourceMgr::DiagKind getDiagnosticKind(unsigned DiagID);
 
-  llvm::SourceMgr &mSrcMgr;
+  SourceManager &mSrcMgr;
   llvm::raw_ostream &mOstream;
   unsigned NumErrors;
+  bool SuppressAll{false};
+  Buffer *mBuffer{nullptr};
+
+  /// prints "file:line:col: kind: msg" with the source line and a caret, the
+  /// position comes from the line table of mSrcMgr
+  void emit(SourceLocation Loc, llvm::SourceMgr::DiagKind Kind,
+            llvm::StringRef Msg, llvm::raw_ostream &os);
+
+  [[nodiscard]] bool isSuppressed() const {
+    return SuppressAll || (mBuffer && mBuffer->suppressAll);
+  }
 public:
-  DiagnosticEngine(llvm::SourceMgr &SrcMgr, llvm::raw_ostream &ostream)
+  DiagnosticEngine(SourceManager &SrcMgr, llvm::raw_ostream &ostream)
     :mSrcMgr(SrcMgr), mOstream(ostream), NumErrors(0) {}
 
   unsigned numErrors() { return NumErrors; }
 
+  SourceManager &getSourceManager() { return mSrcMgr; }
+
+  /// drops every diagnostic from here on, after an error that leaves the
+  /// rest of the input unchecked
+  void suppressAllDiagnostics() {
+    (mBuffer ? mBuffer->suppressAll : SuppressAll) = true;
+  }
+
+  /// Reports into \p buffer from here on instead of the stream, until
+  /// another one or nullptr is installed.
+  void setBuffer(Buffer *buffer) { mBuffer = buffer; }
+
   template <typename... Args>
-  void report(llvm::SMLoc Loc, unsigned DiagID, Args &&... arguments) {
+  void report(SourceLocation Loc, unsigned DiagID, Args &&... arguments) {
+    if (isSuppressed())
+      return;
     std::string Msg = llvm::formatv(getDiagnosticText(DiagID), std::forward<Args>(arguments)...).str();
     llvm::SourceMgr::DiagKind Kind = getDiagnosticKind(DiagID);
-    mSrcMgr.PrintMessage(mOstream, mSrcMgr.GetMessage(Loc, Kind, Msg));
-    NumErrors += (Kind == llvm::SourceMgr::DK_Error);
+    unsigned isError = Kind == llvm::SourceMgr::DK_Error;
+    if (mBuffer) {
+      llvm::raw_string_ostream os(mBuffer->text);
+      emit(Loc, Kind, Msg, os);
+      mBuffer->numErrors += isError;
+      return;
+    }
+    emit(Loc, Kind, Msg, mOstream);
+    NumErrors += isError;
+  }
+
+  /// \p Loc points into a buffer of the SourceManager
+  template <typename... Args>
+  void report(llvm::SMLoc Loc, unsigned DiagID, Args &&... arguments) {
+    report(mSrcMgr.getLocation(Loc.getPointer()), DiagID,
+           std::forward<Args>(arguments)...);
   }
 
   void report(llvm::StringRef fileName, int line) {
+    if (isSuppressed())
+      return;
     auto pos = fileName.find_last_of("/");
     if (pos == std::string::npos) {
       pos = fileName.find_last_of("\\");
     }
     if (pos != std::string::npos) {
-      auto shortFilename = fileName.substr(pos + 1);
-      llvm::errs() << "[" << shortFilename << ":" << line << "]:";
-    } else {
-      llvm::errs() << "[" << fileName << ":" << line << "]:";
+      fileName = fileName.substr(pos + 1);
+    }
+    if (mBuffer) {
+      llvm::raw_string_ostream(mBuffer->text)
+          << "[" << fileName << ":" << line << "]:";
+      return;
     }
+    mOstream << "[" << fileName << ":" << line << "]:";
+  }
+
+  /// Replays \p buffer, filled by this or another engine, possibly on
+  /// another thread, as if what it holds were reported here.
+  void emitBuffered(const Buffer &buffer) {
+    mOstream << buffer.text;
+    NumErrors += buffer.numErrors;
+    SuppressAll |= buffer.suppressAll;
   }
 };
 }
@@ -0,0 +1,114 @@
+/***********************************
+ * File:     FileManager.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/13
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_FILEMANAGER_H
+#define LCC_FILEMANAGER_H
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem/UniqueID.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace lcc {
+/// a regular file as it was when first looked up under a path
+class FileEntry {
+private:
+  friend class FileManager;
+  llvm::StringRef mName;
+  llvm::sys::fs::UniqueID mUniqueID;
+  uint64_t mSize;
+  llvm::sys::TimePoint<> mModificationTime;
+
+public:
+  /// the path it was looked up under
+  [[nodiscard]] llvm::StringRef getName() const { return mName; }
+  [[nodiscard]] llvm::sys::fs::UniqueID getUniqueID() const {
+    return mUniqueID;
+  }
+  [[nodiscard]] uint64_t getSize() const { return mSize; }
+  [[nodiscard]] llvm::sys::TimePoint<> getModificationTime() const {
+    return mModificationTime;
+  }
+};
+
+/// What a process knows about the files it reads, shared by every compile
+/// and dependency scan running in it: the status of each path asked for,
+/// including the ones that do not exist, where an #include resolved to for
+/// a search path, and the contents of each file, read once and mapped
+/// where the OS allows it. Nothing is invalidated, files are assumed not to
+/// change while the process runs. Safe to use from several threads; the
+/// file system is accessed outside the lock, when two threads race for the
+/// same path the first answer is kept.
+class FileManager {
+public:
+  /// lookups answered from the caches and ones that went to the file
+  /// system, for -time
+  struct Statistics {
+    uint64_t statHits{0};
+    uint64_t statMisses{0};
+    uint64_t includeHits{0};
+    uint64_t includeMisses{0};
+    uint64_t contentHits{0};
+    uint64_t contentMisses{0};
+  };
+
+private:
+  /// path -> entry, null for a path that is missing or not a regular file
+  llvm::StringMap<std::unique_ptr<FileEntry>> mEntries;
+  /// search key -> resolved entry, null if the search found nothing
+  llvm::StringMap<const FileEntry *> mIncludes;
+  /// by file, a file reached through several paths is read once
+  llvm::DenseMap<llvm::sys::fs::UniqueID, std::unique_ptr<llvm::MemoryBuffer>>
+      mContents;
+  Statistics mStats;
+  std::mutex mMutex;
+
+public:
+  FileManager() = default;
+  FileManager(const FileManager &) = delete;
+  FileManager &operator=(const FileManager &) = delete;
+
+  /// The file at \p path, null if there is no regular file there.
+  const FileEntry *getFile(llvm::StringRef path);
+
+  /// Resolves #include \p name: next to the including file first when
+  /// \p includerDir is set (the "name" form), then in \p searchDirs in
+  /// order. Null if it is in none of them.
+  const FileEntry *lookupInclude(llvm::StringRef name,
+                                 std::optional<llvm::StringRef> includerDir,
+                                 llvm::ArrayRef<std::string> searchDirs);
+
+  /// Contents of \p file, null terminated like a MemoryBuffer::getFile
+  /// result.
+  llvm::ErrorOr<llvm::MemoryBufferRef> getContents(const FileEntry &file);
+  llvm::ErrorOr<llvm::MemoryBufferRef> getContents(llvm::StringRef path);
+
+  /// A buffer viewing the contents of \p file, for a SourceManager to own.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getBuffer(const FileEntry &file);
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getBuffer(llvm::StringRef path);
+
+  Statistics getStatistics();
+  void printStatistics(llvm::raw_ostream &os);
+};
+} // namespace lcc
+
+#endif // LCC_FILEMANAGER_H
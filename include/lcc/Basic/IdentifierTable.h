@@ -0,0 +1,47 @@
+/***********************************
+ * File:     IdentifierTable.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/4
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_IDENTIFIERTABLE_H
+#define LCC_IDENTIFIERTABLE_H
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <cstdint>
+#include <vector>
+
+namespace lcc {
+/// Interns every identifier spelling to a dense 32-bit id. One table serves
+/// one translation unit: its lexers, the preprocessor and the parser share
+/// it, so the parser can key its symbol tables on ids instead of on strings.
+/// The ids of two tables are unrelated.
+/// Keywords are classified by the lexer and never reach the table.
+class IdentifierTable {
+private:
+  llvm::StringMap<uint32_t, llvm::BumpPtrAllocator> mIds;
+  std::vector<llvm::StringRef> mNames;
+
+public:
+  IdentifierTable() = default;
+  IdentifierTable(const IdentifierTable &) = delete;
+  IdentifierTable &operator=(const IdentifierTable &) = delete;
+
+  /// Returns the id of \p name, adding it on first sight.
+  uint32_t get(llvm::StringRef name);
+
+  [[nodiscard]] llvm::StringRef getName(uint32_t id) const {
+    return mNames[id];
+  }
+
+  [[nodiscard]] size_t size() const { return mNames.size(); }
+};
+} // namespace lcc
+
+#endif // LCC_IDENTIFIERTABLE_H
@@ -0,0 +1,68 @@
+/***********************************
+ * File:     SourceLocation.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/6
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_SOURCELOCATION_H
+#define LCC_SOURCELOCATION_H
+#include <cstdint>
+
+namespace lcc {
+class SourceManager;
+
+/// A file loaded into the SourceManager, numbered in load order.
+class FileID {
+private:
+  uint32_t mID{0};
+
+public:
+  FileID() = default;
+  explicit FileID(uint32_t id) : mID(id) {}
+
+  [[nodiscard]] uint32_t getIndex() const { return mID; }
+
+  bool operator==(FileID other) const { return mID == other.mID; }
+  bool operator!=(FileID other) const { return mID != other.mID; }
+};
+
+/// A position in any loaded file, in 32 bits. The SourceManager lays the
+/// files out one after another in a single offset space, every file taking
+/// its size plus one (for the end of file position); a location is the
+/// file's start in that space plus the offset inside the file. 0 is never
+/// handed out and means "no location".
+class SourceLocation {
+private:
+  uint32_t mID{0};
+
+  friend class SourceManager;
+  explicit SourceLocation(uint32_t id) : mID(id) {}
+
+public:
+  SourceLocation() = default;
+
+  [[nodiscard]] bool isValid() const { return mID != 0; }
+  [[nodiscard]] bool isInvalid() const { return mID == 0; }
+
+  [[nodiscard]] SourceLocation getLocWithOffset(int32_t offset) const {
+    return SourceLocation(mID + offset);
+  }
+
+  [[nodiscard]] uint32_t getRawEncoding() const { return mID; }
+  static SourceLocation getFromRawEncoding(uint32_t encoding) {
+    return SourceLocation(encoding);
+  }
+
+  bool operator==(SourceLocation other) const { return mID == other.mID; }
+  bool operator!=(SourceLocation other) const { return mID != other.mID; }
+  bool operator<(SourceLocation other) const { return mID < other.mID; }
+};
+static_assert(sizeof(SourceLocation) == 4, "SourceLocation must stay 32-bit");
+} // namespace lcc
+
+#endif // LCC_SOURCELOCATION_H
@@ -0,0 +1,145 @@
+/***********************************
+ * File:     SourceManager.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/6
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_SOURCEMANAGER_H
+#define LCC_SOURCEMANAGER_H
+#include "lcc/Basic/SourceLocation.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lcc {
+/// Owns the buffers of every file of a compilation and maps between buffer
+/// pointers, SourceLocations and line/column pairs. The line table of a file
+/// is built in one pass when the file is loaded, so a line/column query is
+/// a binary search instead of a scan of the buffer.
+class SourceManager {
+public:
+  /// where a location says it is after #line: the file name and line a
+  /// #line gave, the column is the real one
+  struct PresumedLoc {
+    llvm::StringRef fileName;
+    unsigned line;
+    unsigned column;
+  };
+
+private:
+  /// a #line on line physicalLine of a file, the lines after it are
+  /// numbered from line on, in fileName
+  struct LineDirective {
+    unsigned physicalLine;
+    unsigned line;
+    llvm::StringRef fileName;
+  };
+  struct FileInfo {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    /// first location of the file in the shared offset space
+    uint32_t startOffset;
+    /// offsets in the file at which a line begins, lineStarts[0] == 0
+    std::vector<uint32_t> lineStarts;
+    /// by physicalLine
+    std::vector<LineDirective> lineDirectives;
+  };
+  std::vector<FileInfo> mFiles;
+  /// buffer start address and file index, sorted by address, to find the
+  /// file of a pointer
+  std::vector<std::pair<const char *, uint32_t>> mBufferRanges;
+  /// 0 is the invalid location
+  uint32_t mNextOffset{1};
+  /// #embed resources by path. They get no locations and no line table,
+  /// chunk lexers of a parallel lex load them concurrently.
+  llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> mBinaryFiles;
+  std::mutex mBinaryFilesMutex;
+  /// the file names of #line directives
+  llvm::StringSet<> mLineFileNames;
+
+public:
+  SourceManager() = default;
+  SourceManager(const SourceManager &) = delete;
+  SourceManager &operator=(const SourceManager &) = delete;
+
+  FileID createFileID(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  /// Contents of the binary file at \p path, mapped instead of read where
+  /// the OS allows it. A file is loaded once, the buffer lives as long as
+  /// the manager.
+  llvm::ErrorOr<const llvm::MemoryBuffer *>
+  getBinaryFile(llvm::StringRef path);
+
+  /// paths of the binary files loaded so far, sorted
+  std::vector<std::string> getBinaryFilePaths();
+
+  /// Marks \p offset of \p fid as the start of a line, for buffers that are
+  /// filled after they were loaded. Offsets have to be added in order.
+  void addLineStart(FileID fid, uint32_t offset) {
+    auto &lineStarts = mFiles[fid.getIndex()].lineStarts;
+    assert(offset > lineStarts.back());
+    lineStarts.push_back(offset);
+  }
+
+  [[nodiscard]] const llvm::MemoryBuffer &getBuffer(FileID fid) const {
+    return *mFiles[fid.getIndex()].buffer;
+  }
+
+  [[nodiscard]] llvm::StringRef getBufferName(FileID fid) const {
+    return getBuffer(fid).getBufferIdentifier();
+  }
+
+  [[nodiscard]] size_t getNumFiles() const { return mFiles.size(); }
+
+  [[nodiscard]] SourceLocation getLocForStartOfFile(FileID fid) const {
+    return SourceLocation(mFiles[fid.getIndex()].startOffset);
+  }
+
+  /// Location of \p ptr, which points into (or one past) a loaded buffer.
+  [[nodiscard]] SourceLocation getLocation(const char *ptr) const;
+
+  [[nodiscard]] FileID getFileID(SourceLocation loc) const;
+
+  [[nodiscard]] uint32_t getFileOffset(SourceLocation loc) const {
+    return loc.mID - mFiles[getFileID(loc).getIndex()].startOffset;
+  }
+
+  [[nodiscard]] const char *getCharacterData(SourceLocation loc) const;
+
+  /// 1-based line and column of \p loc, columns count bytes
+  [[nodiscard]] std::pair<unsigned, unsigned>
+  getLineAndColumn(SourceLocation loc) const;
+
+  /// Records a #line at \p loc: the next line is line \p line, and it and
+  /// the ones after it are in \p fileName, or in the file they were in
+  /// before when it is empty. Directives of a file have to come in order.
+  void addLineDirective(SourceLocation loc, unsigned line,
+                        llvm::StringRef fileName);
+
+  /// getLineAndColumn() and the file name with the #line directives applied,
+  /// what diagnostics, __LINE__ and __FILE__ show
+  [[nodiscard]] PresumedLoc getPresumedLoc(SourceLocation loc) const;
+
+  /// the line holding \p loc without its line terminator
+  [[nodiscard]] llvm::StringRef getLineText(SourceLocation loc) const;
+
+private:
+  [[nodiscard]] const FileInfo &getFileInfo(SourceLocation loc) const {
+    return mFiles[getFileID(loc).getIndex()];
+  }
+};
+} // namespace lcc
+
+#endif // LCC_SOURCEMANAGER_H
@@ -12,7 +12,11 @@
 #define LCC_LEXER_H
 
 #include "lcc/Basic/Diagnostic.h"
+#include "lcc/Basic/IdentifierTable.h"
+#include "lcc/Lexer/LiteralPool.h"
 #include "lcc/Lexer/Token.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -23,32 +27,106 @@ enum class State {
   Start,
   CharacterLiteral,
   StringLiteral,
-  Identifier,
   Number,
   Punctuator,
-  LineComment,
   BlockComment,
   AfterInclude
 };
 
+class Preprocessor;
+
 class Lexer {
+  /// pulls pp tokens batch-wise and reuses the literal parsing
+  friend class Preprocessor;
+
 private:
   State state = State::Start;
-  llvm::SourceMgr &Mgr;
+  SourceManager &Mgr;
+  FileID mFileID;
   DiagnosticEngine &Diag;
-  std::string mSourceCode;
+  IdentifierTable &mIdents;
+  LiteralPool mLiterals;
   const char *P{nullptr};
   const char *Ep{nullptr};
+  /// state of the scan loop between LexInto calls
+  const char *mSp{nullptr};
+  char mIncludeDelimiter{' '};
+  tok::TokenKind mLastKind{tok::unknown};
+  bool mAfterHashInclude{false};
+  bool mFinished{false};
+  /// chunk lexers of a parallel lex: a literal or comment was still open at
+  /// Ep, the scan was rewound to its start
+  bool mSpilled{false};
+  /// #embed is resolved while scanning, unless a Preprocessor drives the
+  /// lexer and decides which directives are live
+  bool mResolveEmbed{true};
+  /// LexInto returns behind the newline of a directive line, so that a
+  /// Preprocessor can skip an inactive group without lexing into it
+  bool mStopAfterDirective{false};
+  bool mInDirective{false};
+  /// lexed but not yet pulled by lexCToken
+  std::vector<Token> mPending;
+  size_t mPendingPos{0};
+  unsigned mNumErrors{0};
 
 public:
-  explicit Lexer(llvm::SourceMgr &mgr, DiagnosticEngine &diag,
-                 std::string &&sourceCode,
-                 std::string_view sourcePath = "<stdin>");
+  /// \p buffer is handed to \p mgr and lexed in place, tokens point into it
+  explicit Lexer(SourceManager &mgr, DiagnosticEngine &diag,
+                 IdentifierTable &idents,
+                 std::unique_ptr<llvm::MemoryBuffer> buffer);
   std::vector<Token> tokenize();
   std::vector<Token> toCTokens(std::vector<Token> &&ppTokens);
+  /// tokenize() and toCTokens() fused into one pass, for sources that need
+  /// no preprocessing: pp tokens are converted as they are produced and only
+  /// the C tokens are ever stored
+  std::vector<Token> lexCTokens();
+  /// tokenize() and lexCTokens() on up to \p threads threads. The buffer is
+  /// cut at newlines into chunks that are lexed concurrently and stitched in
+  /// order; tokens, identifier ids, literal slots and diagnostics come out
+  /// exactly as from the serial versions.
+  std::vector<Token> tokenize(unsigned threads);
+  std::vector<Token> lexCTokens(unsigned threads);
+  /// Pull interface of lexCTokens(): stores the next C token in \p token,
+  /// false once the input is exhausted.
+  bool lexCToken(Token &token);
+  /// errors reported while pulling through lexCToken
+  [[nodiscard]] unsigned numErrors() const { return mNumErrors; }
+  /// end of the source buffer, where an end of file token points
+  [[nodiscard]] const char *getBufferEnd() const { return Ep; }
+  /// the file the lexed buffer was loaded as
+  [[nodiscard]] FileID getFileID() const { return mFileID; }
+  /// values of the constants in the tokens returned by toCTokens
+  [[nodiscard]] const LiteralPool &getLiteralPool() const { return mLiterals; }
 
 private:
-  void RegularSourceCode();
+  /// lexer of [begin, end) of an already loaded file, one chunk of a
+  /// parallel lex
+  Lexer(SourceManager &mgr, DiagnosticEngine &diag, IdentifierTable &idents,
+        FileID fileID, const char *begin, const char *end);
+  std::vector<Token> Lex(bool cTokens);
+  std::vector<Token> LexParallel(bool cTokens, unsigned threads);
+  /// Runs the scan loop until \p results holds \p limit tokens or the input
+  /// ends; a later call picks up where the previous one stopped.
+  void LexInto(std::vector<Token> &results, bool cTokens, size_t limit);
+  /// Handles the #embed directive whose '#' is at \p hash, \p p points behind
+  /// the directive name. \p expansion receives the prefix tokens, a single
+  /// embed_data token viewing the file bytes and the suffix tokens, or the
+  /// if_empty tokens of an empty resource. Returns the end of the directive
+  /// line.
+  const char *LexEmbedDirective(const char *hash, const char *p,
+                                std::vector<Token> &expansion);
+  /// Raw scan over an inactive conditional group starting at the beginning
+  /// of a line: returns the '#' of the next #if, #ifdef, #ifndef, #elif,
+  /// #elifdef, #elifndef, #else or #endif, or the end of the buffer.
+  /// Comments and literals are skipped, no token is formed.
+  const char *SkipConditionalBlock(const char *p);
+  /// The same scan to the '#' of the next directive of any kind, for a
+  /// pass that only runs the directives. \p p may be inside a line.
+  const char *SkipToDirective(const char *p, bool atLineStart);
+  /// Continues lexing at the line start \p p.
+  void ResumeAt(const char *p);
+  /// Turns a pp token into a C token, false if it has to be dropped.
+  bool ConvertToCToken(Token &token);
   static bool IsLetter(char ch);
   static bool IsWhiteSpace(char ch);
   static bool IsDigit(char ch);
@@ -62,7 +140,8 @@ private:
   Token::ValueType ParseNumber(const Token &ppToken);
   std::vector<char> ParseCharacters(const Token &ppToken, bool handleCharMode);
   std::uint32_t ParseEscapeChar(const char *p, char escape);
-  static bool IsJudgeNumber(const std::string &preCharacters, char curChar);
+  static bool IsJudgeNumber(std::string_view preCharacters, char curChar);
+  static const char *ScanQuotedBody(const char *p, const char *ep, char quote);
 };
 } // namespace lcc
 
@@ -0,0 +1,61 @@
+/***********************************
+ * File:     LiteralPool.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/4
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_LITERALPOOL_H
+#define LCC_LITERALPOOL_H
+#include "lcc/Basic/Util.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace lcc {
+/// Values of numeric, char and string literals. Tokens only keep an index
+/// into the pool, so the common tokens (identifiers, keywords, punctuators)
+/// never carry a value at all. The value of an embed_data token is a view of
+/// the embedded file, owned by the SourceManager.
+class LiteralPool {
+public:
+  using ValueType =
+      std::variant<std::monostate, int32_t, uint32_t, int64_t, uint64_t, float,
+                   double, std::string, llvm::ArrayRef<uint8_t>>;
+
+private:
+  std::vector<ValueType> mValues;
+
+public:
+  uint32_t add(ValueType value) {
+    mValues.push_back(std::move(value));
+    return static_cast<uint32_t>(mValues.size() - 1);
+  }
+
+  [[nodiscard]] const ValueType &get(uint32_t index) const {
+    LCC_ASSERT(index < mValues.size());
+    return mValues[index];
+  }
+
+  [[nodiscard]] size_t size() const { return mValues.size(); }
+
+  /// Moves the values of \p other behind ours; an index i of \p other is
+  /// the returned base + i afterwards.
+  uint32_t append(LiteralPool &&other) {
+    auto base = static_cast<uint32_t>(mValues.size());
+    mValues.insert(mValues.end(), std::make_move_iterator(other.mValues.begin()),
+                   std::make_move_iterator(other.mValues.end()));
+    other.mValues.clear();
+    return base;
+  }
+};
+} // namespace lcc
+
+#endif // LCC_LITERALPOOL_H
@@ -0,0 +1,183 @@
+/***********************************
+ * File:     PrecompiledHeader.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/12
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_PRECOMPILEDHEADER_H
+#define LCC_PRECOMPILEDHEADER_H
+#include "lcc/Basic/Diagnostic.h"
+#include "lcc/Basic/IdentifierTable.h"
+#include "lcc/Basic/SourceManager.h"
+#include "lcc/Lexer/Token.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem/UniqueID.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace lcc {
+class Preprocessor;
+
+/// The state a header leaves behind, saved by `lcc -x c-header` and put in
+/// front of a translation unit by -include-pch: the macro table, the
+/// include guards of the headers it read and the typedef names the parser
+/// saw at file scope, with the identifiers they use.
+///
+/// The image is a fixed header of section offsets, arrays of plain records
+/// and two blobs, laid out for the file to be mapped and read in place.
+/// Loading checks the files the image was built from and registers the
+/// macro text blob with the SourceManager, nothing else is copied: a macro
+/// body becomes tokens when the macro is first expanded, an identifier is
+/// interned when something needs its id, typedef names point into the map.
+/// The text blob holds every macro as a `#define` line, the body tokens
+/// are slices of it, so diagnostics show the definition.
+class PrecompiledHeader {
+public:
+  struct Section {
+    uint32_t offset;
+    uint32_t count;
+  };
+
+  struct ImageHeader {
+    char magic[4];
+    uint32_t version;
+    /// the #define lines, registered as a source buffer
+    Section text;
+    /// identifier names and file paths
+    Section strings;
+    Section files;
+    Section identifiers;
+    Section macros;
+    Section tokens;
+    Section typedefs;
+    Section headers;
+  };
+
+  /// a file the image was built from, checked before it is used
+  struct FileRecord {
+    uint32_t path;
+    uint32_t pathLength;
+    uint64_t size;
+    /// nanoseconds since the epoch
+    int64_t modificationTime;
+    /// xxHash64 of the contents, only compared when the time differs
+    uint64_t hash;
+  };
+
+  struct StringRecord {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  struct MacroRecord {
+    /// identifier index of the name
+    uint32_t name;
+    uint32_t firstToken;
+    uint32_t numTokens;
+    uint32_t numParams;
+    uint32_t flags;
+  };
+
+  enum MacroFlags : uint32_t { FunctionLike = 1, Variadic = 2 };
+
+  /// a body token, spelled at \p offset of the text blob. The index of an
+  /// identifier is an identifier index of the image.
+  struct TokenRecord {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t kind;
+    uint32_t index;
+  };
+
+  /// what the multiple include optimization knew about a file
+  struct HeaderRecord {
+    uint32_t file;
+    /// identifier index of the guard macro
+    uint32_t guardMacro;
+    uint32_t flags;
+  };
+
+  enum HeaderFlags : uint32_t { HasGuard = 1, Once = 2 };
+
+  static constexpr uint32_t Version = 1;
+
+private:
+  IdentifierTable &mIdents;
+  llvm::StringRef mText;
+  llvm::StringRef mStrings;
+  llvm::ArrayRef<FileRecord> mFiles;
+  llvm::ArrayRef<StringRecord> mIdentifiers;
+  llvm::ArrayRef<MacroRecord> mMacros;
+  llvm::ArrayRef<TokenRecord> mTokens;
+  llvm::ArrayRef<uint32_t> mTypedefs;
+  llvm::ArrayRef<HeaderRecord> mHeaders;
+  /// UniqueID of every file record, from the validation
+  std::vector<llvm::sys::fs::UniqueID> mFileIDs;
+  /// identifier index -> id in mIdents, NoId until interned
+  std::vector<uint32_t> mIdentifierIds;
+
+  static constexpr uint32_t NoId = ~0u;
+
+  explicit PrecompiledHeader(IdentifierTable &idents) : mIdents(idents) {}
+
+public:
+  PrecompiledHeader(const PrecompiledHeader &) = delete;
+  PrecompiledHeader &operator=(const PrecompiledHeader &) = delete;
+
+  /// Saves the state \p pp is in after the header it was built on. The
+  /// header and every file it included are recorded for validation.
+  /// Reports and returns false if \p path cannot be written.
+  static bool write(llvm::StringRef path, Preprocessor &pp,
+                    llvm::ArrayRef<std::string_view> typedefs,
+                    DiagnosticEngine &diag);
+
+  /// Maps the image at \p path, a null pointer with a diagnostic if it is
+  /// not an image of this version or one of its files changed since.
+  static std::unique_ptr<PrecompiledHeader>
+  load(llvm::StringRef path, SourceManager &mgr, IdentifierTable &idents,
+       DiagnosticEngine &diag);
+
+  [[nodiscard]] llvm::ArrayRef<MacroRecord> getMacros() const {
+    return mMacros;
+  }
+
+  [[nodiscard]] llvm::ArrayRef<HeaderRecord> getHeaders() const {
+    return mHeaders;
+  }
+
+  [[nodiscard]] llvm::sys::fs::UniqueID getFileUniqueID(uint32_t file) const {
+    return mFileIDs[file];
+  }
+
+  [[nodiscard]] llvm::StringRef getFilePath(uint32_t file) const {
+    return mStrings.substr(mFiles[file].path, mFiles[file].pathLength);
+  }
+
+  [[nodiscard]] size_t getNumFiles() const { return mFiles.size(); }
+
+  [[nodiscard]] llvm::StringRef getIdentifier(uint32_t index) const {
+    return mStrings.substr(mIdentifiers[index].offset,
+                           mIdentifiers[index].length);
+  }
+
+  /// id of identifier \p index in the IdentifierTable, interned on first use
+  uint32_t getIdentifierId(uint32_t index);
+
+  /// the body of \p macro as tokens into the text blob, in \p out which
+  /// holds numTokens tokens
+  void readMacroBody(const MacroRecord &macro, Token *out);
+
+  /// typedef names, pointing into the image
+  [[nodiscard]] std::vector<std::string_view> getTypedefs() const;
+};
+} // namespace lcc
+
+#endif // LCC_PRECOMPILEDHEADER_H
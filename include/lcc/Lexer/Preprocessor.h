@@ -0,0 +1,389 @@
+/***********************************
+ * File:     Preprocessor.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/8
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_PREPROCESSOR_H
+#define LCC_PREPROCESSOR_H
+#include "lcc/Basic/Diagnostic.h"
+#include "lcc/Basic/FileManager.h"
+#include "lcc/Basic/IdentifierTable.h"
+#include "lcc/Basic/SourceManager.h"
+#include "lcc/Lexer/Token.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem/UniqueID.h"
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lcc {
+class Lexer;
+class PrecompiledHeader;
+
+/// Hide-sets of Prosser's expansion algorithm: the macros a token must not
+/// be expanded by again. A set is a bitset over dense macro ids, trimmed to
+/// the words that have a bit set. Sets are interned, so a token carries a
+/// 32-bit set id, and the results of add/unite/intersect are cached; after
+/// the first few expansions of a macro nothing is allocated anymore.
+class HideSetTable {
+private:
+  struct Set {
+    /// index of the first stored word, bit i of the set is bit i % 64 of
+    /// word i / 64
+    uint32_t firstWord;
+    llvm::ArrayRef<uint64_t> words;
+  };
+  llvm::BumpPtrAllocator mArena;
+  std::vector<Set> mSets{Set{0, {}}};
+  /// words of a set, prefixed by firstWord, as raw bytes -> set id
+  llvm::StringMap<uint32_t> mIds;
+  llvm::DenseMap<uint64_t, uint32_t> mAddCache;
+  llvm::DenseMap<uint64_t, uint32_t> mUniteCache;
+  llvm::DenseMap<uint64_t, uint32_t> mIntersectCache;
+  llvm::SmallVector<uint64_t, 16> mWords;
+
+public:
+  static constexpr uint32_t Empty = 0;
+
+  [[nodiscard]] bool contains(uint32_t set, uint32_t macro) const;
+  uint32_t add(uint32_t set, uint32_t macro);
+  uint32_t unite(uint32_t a, uint32_t b);
+  uint32_t intersect(uint32_t a, uint32_t b);
+
+private:
+  /// set of the bits in mWords, which start at word \p firstWord
+  uint32_t Intern(uint32_t firstWord);
+};
+
+/// Spellings the preprocessor makes up: stringified arguments, pasted
+/// tokens, __LINE__ and friends. They live in buffers loaded into the
+/// SourceManager, so tokens and diagnostics treat them like any source.
+class ScratchBuffer {
+private:
+  SourceManager &mMgr;
+  FileID mFileID;
+  const char *mStart{nullptr};
+  char *mCur{nullptr};
+  char *mEnd{nullptr};
+
+public:
+  explicit ScratchBuffer(SourceManager &mgr) : mMgr(mgr) {}
+
+  /// A copy of \p text followed by a newline, which ends the last token
+  /// when the copy is lexed.
+  llvm::StringRef copy(llvm::StringRef text);
+};
+
+/// Runs the preprocessing directives and macro expansion over the pp tokens
+/// of a Lexer, between its tokenize() and toCTokens() stages: object and
+/// function-like macros with # and ##, variadic macros, conditional
+/// inclusion and #include. Headers with an include guard or #pragma once
+/// are entered once; later includes of the same file, by whatever path, do
+/// not open it again while the guard macro is defined. Tokens are pulled from the lexer in batches, so the source is
+/// never fully tokenized up front.
+///
+/// Inactive conditional groups are passed over by a raw scan for the next
+/// conditional directive, their lines are never tokenized.
+///
+/// Macro bodies are token slices in an arena, parameters already resolved
+/// to their index. Expansion follows Prosser's algorithm with interned
+/// hide-sets; the work lists are reused vectors, one set per nesting level
+/// of argument pre-expansion.
+class Preprocessor {
+public:
+  struct IncludedFile {
+    std::string path;
+    /// reached through an #include <...>, directly or not, what -MM leaves
+    /// out
+    bool isSystem;
+  };
+
+private:
+  friend class PrecompiledHeader;
+
+  struct PPToken {
+    Token token;
+    uint32_t hideSet{HideSetTable::Empty};
+  };
+
+  enum class Builtin : uint8_t { None, File, Line, Counter, Date, Time };
+
+  struct Macro {
+    llvm::ArrayRef<Token> body;
+    /// dense id in hide-sets, the same for every definition of a name
+    uint32_t id;
+    uint32_t numParams{0};
+    bool isFunctionLike{false};
+    bool isVariadic{false};
+    Builtin builtin{Builtin::None};
+    /// 1 + the record of a body still in the precompiled header, it is
+    /// read on the first expansion
+    uint32_t pchMacro{0};
+  };
+
+  struct MacroSlot {
+    Macro *macro{nullptr};
+    uint32_t id{0};
+    bool hasId{false};
+  };
+
+  struct Conditional {
+    const char *loc;
+    /// tokens of the current branch are kept
+    bool active;
+    /// a branch was taken already, or the whole group is inside a skipped
+    /// region: no later branch can become active
+    bool taken;
+    bool sawElse{false};
+  };
+
+  struct FileState {
+    Lexer *lexer;
+    std::unique_ptr<Lexer> owned;
+    std::vector<Token> batch;
+    size_t pos{0};
+    bool atLineStart{true};
+    /// conditionals open when the file was entered
+    size_t conditionalDepth{0};
+    /// an #include'd file, identified by \p uniqueID
+    bool isHeader{false};
+    /// reached through an #include <...>, directly or not
+    bool isSystem{false};
+    llvm::sys::fs::UniqueID uniqueID;
+    /// include guard detection: the macro of the leading #ifndef, its
+    /// #endif was seen, something else is at the top level of the file
+    std::optional<uint32_t> guardMacro;
+    bool guardClosed{false};
+    bool outsideGuard{false};
+  };
+
+  /// what the multiple include optimization knows about a header
+  struct HeaderInfo {
+    /// identifier id of the include guard macro
+    uint32_t guardMacro{0};
+    bool hasGuard{false};
+    /// #pragma once
+    bool once{false};
+  };
+
+  static constexpr size_t MaxIncludeDepth = 200;
+
+  /// Work lists of one expansion level. Level 0 reads on into the file,
+  /// the deeper ones pre-expand macro arguments.
+  struct Level {
+    /// tokens to rescan, the next one last
+    std::vector<PPToken> pending;
+    std::vector<PPToken> args;
+    /// args[argBounds[i], argBounds[i + 1]) is argument i
+    std::vector<uint32_t> argBounds;
+    std::vector<PPToken> expanded;
+    /// expanded[begin, end) per argument once needed
+    std::vector<std::pair<uint32_t, uint32_t>> expandedBounds;
+    std::vector<PPToken> result;
+  };
+
+  Lexer &mMainLexer;
+  SourceManager &Mgr;
+  DiagnosticEngine &Diag;
+  IdentifierTable &mIdents;
+  llvm::BumpPtrAllocator mArena;
+  ScratchBuffer mScratch;
+  HideSetTable mHideSets;
+  /// indexed by identifier id
+  std::vector<MacroSlot> mMacros;
+  uint32_t mNumMacroIds{0};
+  /// keywords have no identifier id, they are only looked up by name once
+  /// a keyword was defined as a macro
+  unsigned mNumKeywordMacros{0};
+  std::vector<FileState> mFiles;
+  llvm::DenseMap<llvm::sys::fs::UniqueID, HeaderInfo> mHeaders;
+  std::vector<std::string> mIncludeDirs;
+  /// the #include'd files, each once, in the order entered
+  std::vector<IncludedFile> mIncludedFiles;
+  PrecompiledHeader *mPCH{nullptr};
+  /// where #include'd files are looked up and read, a private one unless
+  /// the driver shares its own
+  std::unique_ptr<FileManager> mOwnFileMgr;
+  FileManager *mFileMgr;
+  /// only the directive lines are lexed, see scanDirectives()
+  bool mDirectivesOnly{false};
+  unsigned mNumSkippedIncludes{0};
+  std::vector<Conditional> mConditionals;
+  std::vector<std::unique_ptr<Level>> mLevels;
+  std::optional<PPToken> mLookahead;
+  /// tokens a directive produced (#embed), read before the file goes on
+  std::vector<Token> mDirectiveOutput;
+  size_t mDirectiveOutputPos{0};
+  std::vector<Token> mLine;
+  /// tokens of a relexed spelling
+  std::vector<Token> mSpellingTokens;
+  /// last token read from a file, where __LINE__ is taken from
+  const char *mLastFilePos{nullptr};
+  /// file token the current top level expansion started at
+  const char *mExpansionPos{nullptr};
+  uint32_t mCounter{0};
+  std::string mDate;
+  std::string mTime;
+  /// shared spellings of the values `defined` is replaced by
+  Token mZero;
+  Token mOne;
+  uint32_t mDefinedId;
+  uint32_t mVaArgsId;
+  /// state of the #if expression evaluator
+  std::vector<PPToken> mExprTokens;
+  std::vector<PPToken> mExprExpanded;
+  llvm::ArrayRef<PPToken> mExpr;
+  size_t mExprPos{0};
+  bool mExprError{false};
+  unsigned mNumErrors{0};
+  size_t mSkippedBytes{0};
+  std::chrono::steady_clock::duration mSkipTime{};
+
+public:
+  /// \p lexThreads > 1 lexes the main file up front with tokenize(threads)
+  Preprocessor(Lexer &lexer, DiagnosticEngine &diag, IdentifierTable &idents,
+               unsigned lexThreads = 1);
+  ~Preprocessor();
+  Preprocessor(const Preprocessor &) = delete;
+  Preprocessor &operator=(const Preprocessor &) = delete;
+
+  /// Stores the next preprocessed pp token in \p token, false at the end of
+  /// the main file.
+  bool lex(Token &token);
+  /// lex() followed by the lexer's conversion to a C token. Constants go to
+  /// the literal pool of the main lexer.
+  bool lexCToken(Token &token);
+  /// every remaining pp token, as for -E. \p positions receives where each
+  /// token was written in the file: its own spelling, or the name of the
+  /// macro invocation it came out of.
+  std::vector<Token> preprocess(std::vector<const char *> *positions = nullptr);
+  /// every remaining C token
+  std::vector<Token> lexCTokens();
+  /// errors reported while pulling through lexCToken
+  [[nodiscard]] unsigned numErrors() const { return mNumErrors; }
+  /// where an end of file token points
+  [[nodiscard]] const char *getBufferEnd() const;
+  /// searched for #include <name>, and for "name" after the directory of
+  /// the including file, in the order added
+  void addIncludeDir(llvm::StringRef dir) { mIncludeDirs.emplace_back(dir); }
+  /// #include'd files are looked up and read through \p files, shared
+  /// with other compiles of the process
+  void setFileManager(FileManager &files) { mFileMgr = &files; }
+  /// Runs the directives of the main file and of everything it includes,
+  /// for a dependency scan. Conditionals are evaluated and includes
+  /// followed as in a full run, but the lines in between are passed over
+  /// by the raw scan for inactive groups instead of being lexed; the files
+  /// read are in getIncludedFiles() afterwards.
+  void scanDirectives();
+  /// bytes of inactive conditional groups passed over by the raw scan, and
+  /// the time it took
+  [[nodiscard]] size_t getSkippedBytes() const { return mSkippedBytes; }
+  [[nodiscard]] double getSkipSeconds() const {
+    return std::chrono::duration<double>(mSkipTime).count();
+  }
+  /// every file entered by #include, in the order first entered
+  [[nodiscard]] const std::vector<IncludedFile> &getIncludedFiles() const {
+    return mIncludedFiles;
+  }
+  /// Records the include guard or #pragma once of the main file like that
+  /// of an #include'd header, for a precompiled header the including files
+  /// often #include again by name.
+  void markMainFileAsHeader();
+  /// Starts from the state saved in \p pch instead of the predefined
+  /// macros, which it holds as the header left them. Called before the
+  /// first token is read; \p pch has to outlive the preprocessor.
+  void includePCH(PrecompiledHeader &pch);
+  /// includes of guarded or #pragma once files that were not entered again
+  [[nodiscard]] unsigned numSkippedIncludes() const {
+    return mNumSkippedIncludes;
+  }
+
+private:
+  /// next pp token of \p file with the line splices removed, false at its
+  /// end
+  bool NextFileToken(FileState &file, Token &token);
+  /// raw token of the innermost file, newlines folded into \p atLineStart
+  bool NextRawToken(Token &token, bool &atLineStart);
+  void LeaveFile();
+  /// the rest of the current line into mLine
+  void ReadLine();
+  /// moves the innermost file to the next conditional directive without
+  /// lexing the inactive lines in between; with \p anyDirective to the
+  /// next directive, from \p midLine if the scan starts inside a line
+  void SkipInactive(bool anyDirective = false, const char *midLine = nullptr);
+  /// next token of the active part of the files, directives executed
+  bool ReadFileToken(PPToken &token);
+  bool NextToken(unsigned depth, PPToken &token);
+  const PPToken *PeekToken(unsigned depth);
+  Level &GetLevel(unsigned depth);
+  /// next fully macro expanded token of level \p depth
+  bool Expand(unsigned depth, PPToken &token);
+  void ExpandList(llvm::ArrayRef<PPToken> tokens, unsigned depth,
+                  std::vector<PPToken> &out);
+  /// reads the arguments of \p name into the level, false on an error
+  bool CollectArguments(unsigned depth, const Token &name, const Macro &macro,
+                        PPToken &rParen);
+  void Substitute(unsigned depth, const Macro &macro, uint32_t hideSet);
+  llvm::ArrayRef<PPToken> ExpandedArgument(unsigned depth, uint32_t index);
+  Token Stringify(llvm::ArrayRef<PPToken> tokens, const Token &hash);
+  /// false if the result is not a single pp token
+  bool Paste(const Token &lhs, const Token &rhs, Token &result);
+  Token ExpandBuiltin(Builtin builtin, const Token &name);
+  /// relexes \p spelling, false unless it is exactly one pp token
+  bool LexSpelling(llvm::StringRef spelling, Token &token);
+  Macro *LookupMacro(const Token &token);
+  /// identifier id of an identifier or keyword token
+  uint32_t IdentifierIdOf(const Token &token);
+  MacroSlot &GetMacroSlot(uint32_t id);
+  /// reads the body of a macro of the precompiled header
+  void LoadMacroBody(Macro &macro);
+  void DefineBuiltin(llvm::StringRef name, Builtin builtin);
+  void EnterFile(std::unique_ptr<Lexer> lexer);
+
+  void HandleDirective(const Token &hash);
+  void HandleDefine();
+  void HandleUndef();
+  void HandleIf(const Token &directive, bool isElif);
+  void HandleIfdef(const Token &directive, bool isDefined, bool isElif);
+  void HandleElse(const Token &directive);
+  void HandleEndif(const Token &directive);
+  void HandleInclude(const Token &hash);
+  void HandleEmbed(const Token &hash);
+  void HandleLine(const Token &hash);
+  /// the macro of `#ifndef X` or `#if !defined X` on mLine
+  std::optional<uint32_t> GetGuardMacro(bool isIfndef);
+  void CheckExtraTokens(const Token &directive, size_t expected);
+  [[nodiscard]] bool IsSkipping() const {
+    return !mConditionals.empty() && !mConditionals.back().active;
+  }
+
+  /// value of the #if expression on mLine after the directive name
+  bool EvaluateCondition();
+  struct Value {
+    uint64_t value{0};
+    bool isUnsigned{false};
+  };
+  Value EvalConditional(bool evaluate);
+  Value EvalBinary(unsigned minPrecedence, bool evaluate);
+  Value EvalUnary(bool evaluate);
+  Value EvalPrimary(bool evaluate);
+  [[nodiscard]] const Token *PeekExpr() const {
+    return mExprPos < mExpr.size() ? &mExpr[mExprPos].token : nullptr;
+  }
+  void ExprError(unsigned diagID, llvm::StringRef arg = {});
+};
+} // namespace lcc
+
+#endif // LCC_PREPROCESSOR_H
@@ -15,56 +15,76 @@
 #include <cassert>
 #include <cstdint>
 #include <string>
-#include <variant>
-#include "llvm/Support/SourceMgr.h"
+#include <vector>
+#include "lcc/Lexer/LiteralPool.h"
+#include "lcc/Basic/SourceManager.h"
 #include "llvm/Support/SMLoc.h"
 #include "llvm/ADT/StringRef.h"
 namespace lcc{
+/// A token is a view of its spelling in the source buffer plus one 32-bit
+/// side index: the interned id for identifiers and keywords, the LiteralPool
+/// slot for constants. No token owns memory, which keeps it at 16 bytes.
 class Token {
+public:
+  using ValueType = LiteralPool::ValueType;
+  /// longest spelling a token can have, the length shares a word with the kind
+  static constexpr uint32_t MaxLength = (1u << 24) - 1;
+
 private:
-  using TokenValue =
-      std::variant<std::monostate, int32_t, uint32_t, int64_t, uint64_t, float, double, std::string>;
-  TokenValue mValue;
-  tok::TokenKind mTokenKind;
   const char *mOffsetPtr{nullptr};
-  uint32_t mLength;
-  llvm::SourceMgr &mSrcMgr;
+  uint32_t mLength : 24;
+  uint32_t mTokenKind : 8;
+  uint32_t mIndex{0};
+
 public:
-  using ValueType = TokenValue;
   Token(tok::TokenKind tokenKind, const char *offsetPtr, uint32_t length,
-        llvm::SourceMgr &mgr, ValueType value = std::monostate{})
-      : mValue(std::move(value)), mTokenKind(tokenKind), mOffsetPtr(offsetPtr), mLength(length),
-        mSrcMgr(mgr){}
+        uint32_t index = 0)
+      : mOffsetPtr(offsetPtr), mLength(length), mTokenKind(tokenKind),
+        mIndex(index) {
+    assert(length <= MaxLength);
+  }
 
+  /// The spelling as written in the source, never a copy.
   [[nodiscard]] llvm::StringRef getRepresentation() const {
-      if (std::holds_alternative<std::string>(mValue)) {
-        return std::get<std::string>(mValue);
-      }else {
-        auto *mem = mSrcMgr.getMemoryBuffer(mSrcMgr.getMainFileID());
-        uint32_t offset = mOffsetPtr - mem->getBufferStart();
-        return mem->getBuffer().substr(offset, mLength);
-      }
+    return {mOffsetPtr, mLength};
+  }
+
+  [[nodiscard]] std::pair<unsigned, unsigned>
+  getLineAndColumn(const SourceManager &mgr) const {
+    return mgr.getLineAndColumn(getLocation(mgr));
   }
 
-  [[nodiscard]] std::pair<unsigned, unsigned> getLineAndColumn() const {
+  /// \p mgr owns the buffer the token points into
+  [[nodiscard]] SourceLocation getLocation(const SourceManager &mgr) const {
     assert(mOffsetPtr);
-    return mSrcMgr.getLineAndColumn(llvm::SMLoc::getFromPointer(mOffsetPtr));
+    return mgr.getLocation(mOffsetPtr);
   }
 
   [[nodiscard]] tok::TokenKind getTokenKind() const {
-    return mTokenKind;
+    return static_cast<tok::TokenKind>(mTokenKind);
   }
 
   void setTokenKind(tok::TokenKind tokenKind) {
     mTokenKind = tokenKind;
   }
 
-  [[nodiscard]] ValueType getValue() const {
-    return mValue;
+  /// id in the IdentifierTable, valid for identifiers and keywords
+  [[nodiscard]] uint32_t getIdentifierId() const {
+    return mIndex;
+  }
+
+  /// slot in the LiteralPool, valid for numeric, char and string constants
+  /// and embed_data
+  [[nodiscard]] uint32_t getLiteralIndex() const {
+    return mIndex;
+  }
+
+  void setIndex(uint32_t index) {
+    mIndex = index;
   }
 
-  void setValue(ValueType value) {
-    mValue = std::move(value);
+  [[nodiscard]] uint32_t getLength() const {
+    return mLength;
   }
 
   [[nodiscard]] const char *getOffset() const {
@@ -75,7 +95,8 @@ public:
     return llvm::SMLoc::getFromPointer(getOffset());
   }
 };
-using TokIter = std::vector<Token>::const_iterator;
+static_assert(sizeof(Token) == 16, "Token is expected to stay compact");
+static_assert(tok::NUM_TOKENS <= 256, "token kind must fit in 8 bits");
 } // namespace lcc::lexer
 
 #endif // LCC_CTOKEN_H
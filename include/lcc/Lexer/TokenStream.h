@@ -0,0 +1,118 @@
+/***********************************
+ * File:     TokenStream.h
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/5
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#ifndef LCC_TOKENSTREAM_H
+#define LCC_TOKENSTREAM_H
+#include "lcc/Lexer/Token.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace lcc {
+class Lexer;
+class Preprocessor;
+
+/// The tokens the parser reads, addressed by their absolute index in the
+/// file. Backed either by an already lexed vector, or by a Lexer or
+/// Preprocessor that is pulled on demand into a ring buffer. In the streaming case only the
+/// window between the last discardBefore() and the furthest lookahead is
+/// resident; the ring grows when a construct needs a larger window.
+/// Reading past the last token yields a tok::eof token.
+///
+/// Brackets are matched while the tokens come in, so that the parser can
+/// jump over a group of them in one step.
+class TokenStream {
+public:
+  static constexpr uint32_t NoMatch = ~0u;
+  /// how far a streamed getMatch() lexes ahead of the opener
+  static constexpr uint32_t MatchWindow = 1 << 16;
+
+private:
+  Lexer *mLexer{nullptr};
+  Preprocessor *mPreprocessor{nullptr};
+  const std::vector<Token> *mTokens{nullptr};
+  std::vector<Token> mRing;
+  uint32_t mMask{0};
+  /// absolute indices: oldest retained token, one past the newest lexed
+  uint32_t mBegin{0};
+  uint32_t mEnd{0};
+  bool mExhausted{false};
+  Token mEof;
+  /// by token index, the index of the matching bracket or NoMatch; parallel
+  /// to mRing when streaming, where an opener not closed yet is Pending
+  std::vector<uint32_t> mMatch;
+  static constexpr uint32_t Pending = NoMatch - 1;
+  /// the openers not closed yet and the pair they are of, with their
+  /// number by pair
+  std::vector<std::pair<uint32_t, int>> mOpen;
+  uint32_t mNumOpen[3]{};
+
+public:
+  explicit TokenStream(Lexer &lexer, uint32_t initialWindow = 1024);
+  explicit TokenStream(Preprocessor &pp, uint32_t initialWindow = 1024);
+  explicit TokenStream(const std::vector<Token> &tokens);
+  TokenStream(const TokenStream &) = delete;
+  TokenStream &operator=(const TokenStream &) = delete;
+
+  /// Lexes up to \p index if needed. The reference is valid until the next
+  /// call that may lex.
+  const Token &get(uint32_t index);
+
+  /// Tokens before \p index will not be read again.
+  void discardBefore(uint32_t index);
+
+  /// The ) ] or } closing the ( [ or { at \p index, the opener for a
+  /// closer, NoMatch for other tokens and brackets left unpaired. When
+  /// streaming, the tokens up to the closer are lexed, but no more than
+  /// MatchWindow of them: an opener not closed by then is NoMatch for now,
+  /// so a stray { cannot pull the rest of the file into the window.
+  uint32_t getMatch(uint32_t index);
+
+  /// the whole file when the stream is backed by a vector, else nullptr
+  [[nodiscard]] const std::vector<Token> *getTokens() const { return mTokens; }
+
+  /// largest number of tokens that were resident at once
+  [[nodiscard]] size_t getWindowCapacity() const { return mRing.size(); }
+
+private:
+  void InitRing(uint32_t initialWindow);
+  bool Pull(Token &token);
+  void Grow();
+  void MatchBracket(uint32_t index, tok::TokenKind kind);
+  void SetMatch(uint32_t index, uint32_t match);
+  void CloseAll();
+};
+
+/// A position in a TokenStream, used by the parser like a vector iterator.
+class TokenCursor {
+private:
+  TokenStream *mStream;
+  uint32_t mIndex;
+
+public:
+  TokenCursor(TokenStream &stream, uint32_t index = 0)
+      : mStream(&stream), mIndex(index) {}
+
+  const Token &operator*() const { return mStream->get(mIndex); }
+  const Token *operator->() const { return &mStream->get(mIndex); }
+
+  TokenCursor &operator++() {
+    ++mIndex;
+    return *this;
+  }
+  TokenCursor operator+(uint32_t n) const { return {*mStream, mIndex + n}; }
+  TokenCursor operator-(uint32_t n) const { return {*mStream, mIndex - n}; }
+
+  [[nodiscard]] uint32_t getIndex() const { return mIndex; }
+};
+} // namespace lcc
+
+#endif // LCC_TOKENSTREAM_H
@@ -12,51 +12,198 @@
 #define LCC_PARSER_H
 #include "lcc/AST/AST.h"
 #include "lcc/Basic/Diagnostic.h"
+#include "lcc/Basic/IdentifierTable.h"
 #include "lcc/Lexer/Token.h"
+#include "lcc/Lexer/TokenStream.h"
+#include "llvm/ADT/ArrayRef.h"
 #include <bitset>
+#include <deque>
 #include <map>
 #include <optional>
 #include <set>
 #include <string>
-#include <unordered_map>
 #include <vector>
 namespace lcc {
 using TokenBitSet = std::bitset<tok::TokenKind::NUM_TOKENS>;
 class Parser {
 private:
-  const std::vector<Token>& mTokens;
-  TokIter mTokCursor;
-  TokIter mTokEnd;
+  TokenStream &mTokens;
+  const LiteralPool &mLiterals;
+  IdentifierTable &mIdents;
+  TokenCursor mTokCursor;
   bool mIsCheckTypedefType{true};
   DiagnosticEngine &Diag;
+  /// statements, expressions, initializers and declarators nested in one
+  /// another, each level costs C++ frames
+  unsigned mNestingDepth{0};
+  unsigned mMaxNestingDepth{DefaultMaxNestingDepth};
+  /// a parenthesized expression ParsePostFixExpr has closed, the primary
+  /// expression of the enclosing one, which goes on behind it
+  std::optional<Syntax::PrimaryExprParentheses> mLeadingOperand;
 private:
+  /// The ordinary identifiers declared so far, enough to tell a typedef
+  /// name from the others. One flat table indexed by IdentifierTable id
+  /// holds the innermost declaration of each name, which links to the one
+  /// it shadows. The declarations form a stack in declaration order that
+  /// doubles as the undo log, leaving a scope pops the ones made in it.
   class Scope {
   private:
+    static constexpr uint32_t NoSymbol = ~0u;
     struct Symbol {
-      std::string_view identifier;
-      bool isTypedef{false};
+      uint32_t id;
+      /// the declaration of the name in an enclosing scope, or NoSymbol
+      uint32_t shadowed;
+      /// 0 for file scope
+      uint32_t level;
+      bool isTypedef;
     };
-    std::vector<std::unordered_map<std::string_view, Symbol>> mCurrentScope;
+    std::vector<Symbol> mSymbols;
+    /// by id, the innermost declaration of the name or NoSymbol
+    std::vector<uint32_t> mVisible;
+    /// the size of mSymbols when each open scope was entered
+    std::vector<uint32_t> mScopeBegins;
+    /// the file scope of another parser, of which the first mFileScopeSize
+    /// declarations are visible under the ones made here
+    const Scope *mFileScope{nullptr};
+    uint32_t mFileScopeSize{0};
+
+    [[nodiscard]] const Symbol *lookup(uint32_t id) const {
+      if (id < mVisible.size() && mVisible[id] != NoSymbol) {
+        return &mSymbols[mVisible[id]];
+      }
+      if (mFileScope && id < mFileScope->mVisible.size() &&
+          mFileScope->mVisible[id] < mFileScopeSize) {
+        return &mFileScope->mSymbols[mFileScope->mVisible[id]];
+      }
+      return nullptr;
+    }
+    void declare(uint32_t id, bool isTypedef);
+
   public:
-    Scope() {
-      mCurrentScope.emplace_back();
+    void addTypedef(uint32_t id) { declare(id, true); }
+    void addToScope(uint32_t id) { declare(id, false); }
+    [[nodiscard]] bool isTypedefInScope(uint32_t id) const {
+      const Symbol *symbol = lookup(id);
+      return symbol && symbol->isTypedef;
     }
-    void addTypedef(std::string_view name);
-    bool isTypedefInScope(std::string_view name) const;
-    bool checkIsTypedefInCurrentScope(std::string_view name) const;
-    void addToScope(std::string_view name);
-    void pushScope();
+    [[nodiscard]] bool checkIsTypedefInCurrentScope(uint32_t id) const {
+      const Symbol *symbol = lookup(id);
+      return symbol && symbol->isTypedef &&
+             symbol->level == mScopeBegins.size();
+    }
+    void pushScope() { mScopeBegins.push_back(mSymbols.size()); }
     void popScope();
+    /// number of file scope declarations, which keep their place in
+    /// declaration order: the first \p size of them are a snapshot
+    [[nodiscard]] uint32_t getFileScopeSize() const {
+      return mScopeBegins.empty() ? mSymbols.size() : mScopeBegins.front();
+    }
+    /// makes the first \p size file scope declarations of \p scope
+    /// visible here, \p scope must not change meanwhile
+    void setFileScope(const Scope *scope, uint32_t size) {
+      mFileScope = scope;
+      mFileScopeSize = size;
+    }
+    /// forgets the file scope declarations after the first \p size
+    void truncateFileScope(uint32_t size);
+    [[nodiscard]] std::vector<uint32_t> getGlobalTypedefs() const;
   };
   Scope mScope;
+  /// A function body the serial pass jumped over, parsed on a worker
+  /// afterwards with what the serial pass knew when it got there.
+  struct SkippedBody {
+    /// token indices of the { and one past its matching }
+    uint32_t begin;
+    uint32_t end;
+    uint32_t fileScopeSize;
+    std::vector<uint32_t> parameters;
+    /// the FunctionDefinition waiting for it in the translation unit
+    size_t declIndex{0};
+    /// what the serial pass reported between the previous body and this one
+    DiagnosticEngine::Buffer leadingDiag;
+    std::optional<Syntax::BlockStmt> stmt;
+    /// where the worker stopped, end unless the error recovery ran past it
+    uint32_t parsedEnd{0};
+    DiagnosticEngine::Buffer diag;
+  };
+  unsigned mParseThreads{1};
+  bool mLazyBodies{false};
+  /// whether function bodies are jumped over for later
+  bool mSkipBodies{false};
+  /// the { of the innermost block or struct body being parsed, the error
+  /// recovery does not run past its }
+  uint32_t mEnclosingBrace{TokenStream::NoMatch};
+  std::deque<SkippedBody> mSkippedBodies;
+  /// what the serial pass reported since the last skipped body
+  DiagnosticEngine::Buffer mSkeletonDiag;
   TokenBitSet FirstDeclaration, FirstExpression, FirstStatement;
   TokenBitSet FirstStructDeclaration, FirstExternalDeclaration;
 public:
-  explicit Parser(const std::vector<Token> & tokens, DiagnosticEngine &diag);
+  static constexpr unsigned DefaultMaxNestingDepth = 256;
+
+  explicit Parser(TokenStream &tokens, const LiteralPool &literals,
+                  IdentifierTable &idents, DiagnosticEngine &diag);
   Syntax::TranslationUnit ParseTranslationUnit();
-  
+  /// typedef names declared at file scope, what a precompiled header keeps
+  /// of the parse
+  [[nodiscard]] std::vector<std::string_view> getFileScopeTypedefs() const {
+    std::vector<std::string_view> names;
+    for (uint32_t id : mScope.getGlobalTypedefs()) {
+      names.push_back(mIdents.getName(id));
+    }
+    return names;
+  }
+  /// declares \p names as file scope typedefs, as if the header declaring
+  /// them had been parsed first
+  void addFileScopeTypedefs(const std::vector<std::string_view> &names) {
+    for (std::string_view name : names) {
+      mScope.addTypedef(mIdents.get(name));
+    }
+  }
+  /// parsing is cut off with an error at a construct nested deeper than
+  /// \p depth, before the C++ stack runs out
+  void setMaxNestingDepth(unsigned depth) { mMaxNestingDepth = depth; }
+  /// Parses the function bodies on \p threads threads, after a serial pass
+  /// over the rest. Takes effect when the tokens come from a vector; the
+  /// tree and the diagnostics are the same as without.
+  void setParseThreads(unsigned threads) { mParseThreads = threads; }
+  /// Leaves every function body to be parsed, with its diagnostics, when
+  /// FunctionDefinition::getCompoundStatement() is first called. Takes
+  /// effect when the tokens come from a vector; the token stream, literal
+  /// pool, identifier table and diagnostics engine must then outlive the
+  /// tree.
+  void setLazyBodies(bool lazy) { mLazyBodies = lazy; }
+
 private:
+  /// one level of nesting for as long as it lives, false if it is one
+  /// too many
+  class NestingLevel {
+    Parser &mParser;
+    bool mAllowed;
+
+  public:
+    explicit NestingLevel(Parser &parser)
+        : mParser(parser), mAllowed(parser.EnterNesting()) {}
+    ~NestingLevel() { --mParser.mNestingDepth; }
+    NestingLevel(const NestingLevel &) = delete;
+    NestingLevel &operator=(const NestingLevel &) = delete;
+    explicit operator bool() const { return mAllowed; }
+  };
+  bool EnterNesting();
+  void CutOffParsing();
+  llvm::SMLoc GetExprBeginLoc();
+
+  void ParseExternalDeclarations(
+      ArenaVector<Syntax::ExternalDeclaration> &decls);
   std::optional<Syntax::ExternalDeclaration> ParseExternalDeclaration();
+  Syntax::BlockStmt SkipFunctionBody(llvm::ArrayRef<uint32_t> parameters);
+  Syntax::BlockStmt ParseFunctionBody(llvm::ArrayRef<uint32_t> parameters);
+  void ParseSkippedBodies(ASTContext &context,
+                          ArenaVector<Syntax::ExternalDeclaration> &decls);
+  class LazyBodyParser;
+  class LazyBody;
+  void DeferSkippedBodies(ASTContext &context,
+                          ArenaVector<Syntax::ExternalDeclaration> &decls);
   std::optional<Syntax::Declaration> ParseDeclarationSuffix(
       Syntax::DeclSpec &&declSpec,
       std::optional<Syntax::Declarator> &&alreadyParsedDeclarator = {});
@@ -64,7 +211,7 @@ private:
   Syntax::DeclSpec ParseDeclarationSpecifiers();
   std::optional<Syntax::Declarator> ParseDeclarator();
   std::optional<Syntax::DirectDeclarator> ParseDirectDeclarator();
-  void ParseDirectDeclaratorSuffix(TokIter beginTokLoc, Syntax::DirectDeclarator &directDeclarator);
+  void ParseDirectDeclaratorSuffix(llvm::SMLoc beginTokLoc, Syntax::DirectDeclarator &directDeclarator);
   std::optional<Syntax::AbstractDeclarator> ParseAbstractDeclarator();
   std::optional<Syntax::DirectAbstractDeclarator> ParseDirectAbstractDec();
   std::optional<Syntax::DirectAbstractDeclarator>
@@ -84,6 +231,7 @@ private:
   std::optional<Syntax::EnumSpecifier::Enumerator> ParseEnumerator();
   std::optional<Syntax::Initializer> ParseInitializer();
   std::optional<Syntax::InitializerList> ParseInitializerList();
+  std::optional<Syntax::ConstantArray> ParseConstantRun();
 
   std::optional<Syntax::BlockStmt> ParseBlockStmt();
   std::optional<Syntax::BlockItem> ParseBlockItem();
@@ -102,22 +250,15 @@ private:
   std::optional<Syntax::Stmt> ParseExprStmt();
 
   std::optional<Syntax::Expr> ParseExpr();
+  ArenaVector<Syntax::AssignExpr> ParseEmbedData();
   std::optional<Syntax::AssignExpr> ParseAssignExpr();
   std::optional<Syntax::CondExpr> ParseConditionalExpr();
-  std::optional<Syntax::LogOrExpr> ParseLogOrExpr();
-  std::optional<Syntax::LogAndExpr> ParseLogAndExpr();
-  std::optional<Syntax::BitOrExpr> ParseBitOrExpr();
-  std::optional<Syntax::BitXorExpr> ParseBitXorExpr();
-  std::optional<Syntax::BitAndExpr> ParseBitAndExpr();
-  std::optional<Syntax::EqualExpr> ParseEqualExpr();
-  std::optional<Syntax::RelationalExpr> ParseRelationalExpr();
-  std::optional<Syntax::ShiftExpr> ParseShiftExpr();
-  std::optional<Syntax::AdditiveExpr> ParseAdditiveExpr();
-  std::optional<Syntax::MultiExpr> ParseMultiExpr();
+  std::optional<Syntax::BinaryOperand>
+  ParseBinaryExpr(unsigned minPrecedence = 1);
   std::optional<Syntax::CastExpr> ParseCastExpr();
   std::optional<Syntax::UnaryExpr> ParseUnaryExpr();
   std::optional<Syntax::PostFixExpr> ParsePostFixExpr();
-  void ParsePostFixExprSuffix(TokIter beginTokLoc,
+  void ParsePostFixExprSuffix(llvm::SMLoc beginTokLoc,
                               Syntax::PostFixExpr &postFixExpr);
 
   std::optional<Syntax::TypeName> ParseTypeName();
@@ -181,7 +322,8 @@ private:
 
   void SkipTo(TokenBitSet recoveryToken, unsigned DiagID);
 
-  std::string_view GetDeclaratorName(const Syntax::Declarator &declarator);
+  /// IdentifierTable id of the name \p declarator declares
+  uint32_t GetDeclaratorId(const Syntax::Declarator &declarator);
   const Syntax::DirectDeclaratorParamTypeList *
   GetFuncDeclarator(const Syntax::Declarator &declarator);
 };
@@ -12,10 +12,28 @@
 #ifndef LCC_DUMPTOOL_H
 #define LCC_DUMPTOOL_H
 #include "lcc/AST/AST.h"
+#include "lcc/Lexer/LiteralPool.h"
 namespace lcc::dump {
 
-void dumpTokens(const std::vector<lcc::Token> &tokens);
-void dumpAst(const Syntax::TranslationUnit &unit);
+void dumpTokens(const std::vector<lcc::Token> &tokens,
+                const SourceManager &mgr);
+/// -E output: tokens written on one source line, or expanded from a macro
+/// invocation there (\p positions), stay on one line; tokens that were not
+/// adjacent in the source are separated by a space. The bytes of an #embed
+/// are written as a list of numbers, looked up in \p literals.
+void dumpPreprocessed(const std::vector<lcc::Token> &tokens,
+                      const std::vector<const char *> &positions,
+                      const LiteralPool &literals, const SourceManager &mgr,
+                      llvm::raw_ostream &os);
+/// Makefile rule of -M and -MD: \p target depends on \p files, the input
+/// first. Lines are wrapped as gcc does; \p phony adds an empty rule per
+/// header (-MP), so a deleted header does not break the build.
+void dumpDependencies(llvm::StringRef target,
+                      const std::vector<std::string> &files, bool phony,
+                      llvm::raw_ostream &os);
+/// \p bodies false leaves out the bodies of function definitions, which
+/// are then not parsed if they were left lazy
+void dumpAst(const Syntax::TranslationUnit &unit, bool bodies = true);
 
 void visit(const Syntax::TranslationUnit &unit);
 void visit(const Syntax::Declaration &declaration);
@@ -24,6 +42,7 @@ void visit(const Syntax::DeclSpec &declarationSpecifiers);
 void visit(const Syntax::Declarator &declarator);
 void visit(const Syntax::AbstractDeclarator &abstractDeclarator);
 void visit(const Syntax::InitializerList &initializerList);
+void visit(const Syntax::ConstantArray &constantArray);
 void visit(const Syntax::Initializer &initializer);
 void visit(const Syntax::StorageClsSpec &storageClassSpecifier);
 void visit(const Syntax::TypeQualifier &typeQualifier);
@@ -57,16 +76,8 @@ void visit(const Syntax::Expr &expr);
 void visit(const Syntax::ConstantExpr &constantExpr);
 void visit(const Syntax::AssignExpr &assignExpr);
 void visit(const Syntax::CondExpr &conditionalExpr);
-void visit(const Syntax::LogOrExpr &logOrExpr);
-void visit(const Syntax::LogAndExpr &logAndExpr);
-void visit(const Syntax::BitOrExpr &bitOrExpr);
-void visit(const Syntax::BitXorExpr &bitXorExpr);
-void visit(const Syntax::BitAndExpr &bitAndExpr);
-void visit(const Syntax::EqualExpr &equalExpr);
-void visit(const Syntax::RelationalExpr &relationalExpr);
-void visit(const Syntax::ShiftExpr &shiftExpr);
-void visit(const Syntax::AdditiveExpr &additiveExpr);
-void visit(const Syntax::MultiExpr &multiExpr);
+void visit(const Syntax::BinaryOperand &binaryOperand);
+void visit(const Syntax::BinaryExpr &binaryExpr);
 void visit(const Syntax::CastExpr &castExpr);
 void visit(const Syntax::UnaryExpr &unaryExpr);
 void visit(const Syntax::TypeName &typeName);
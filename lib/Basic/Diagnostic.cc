@@ -28,4 +28,24 @@ const char *DiagnosticEngine::getDiagnosticText(unsigned int DiagID) {
 llvm::SourceMgr::DiagKind DiagnosticEngine::getDiagnosticKind(unsigned int DiagID) {
   return DiagnosticKind[DiagID];
 }
-}
\ No newline at end of file
+
+void DiagnosticEngine::emit(SourceLocation Loc, llvm::SourceMgr::DiagKind Kind,
+                            llvm::StringRef Msg, llvm::raw_ostream &os) {
+  /// SMDiagnostic only keeps the SourceMgr for its accessor, printing works
+  /// from the fields below alone
+  static const llvm::SourceMgr NoBuffers;
+  if (Loc.isInvalid()) {
+    llvm::SMDiagnostic(NoBuffers, llvm::SMLoc(), "", -1, -1, Kind, Msg, "", {})
+        .print(nullptr, os);
+    return;
+  }
+  /// named and numbered as #line says, the line shown is the real one
+  auto presumed = mSrcMgr.getPresumedLoc(Loc);
+  llvm::StringRef lineText = mSrcMgr.getLineText(Loc);
+  const char *ptr = mSrcMgr.getCharacterData(Loc);
+  llvm::SMDiagnostic(NoBuffers, llvm::SMLoc::getFromPointer(ptr),
+                     presumed.fileName, presumed.line, presumed.column - 1,
+                     Kind, Msg, lineText, {})
+      .print(nullptr, os);
+}
+}
@@ -0,0 +1,177 @@
+/***********************************
+ * File:     FileManager.cc
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/13
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#include "lcc/Basic/FileManager.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+
+using namespace lcc;
+
+const FileEntry *FileManager::getFile(llvm::StringRef path) {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mEntries.find(path);
+    if (iter != mEntries.end()) {
+      ++mStats.statHits;
+      return iter->second.get();
+    }
+  }
+  llvm::sys::fs::file_status status;
+  std::unique_ptr<FileEntry> file;
+  if (!llvm::sys::fs::status(path, status) &&
+      status.type() != llvm::sys::fs::file_type::directory_file) {
+    file = std::make_unique<FileEntry>();
+    file->mUniqueID = status.getUniqueID();
+    file->mSize = status.getSize();
+    file->mModificationTime = status.getLastModificationTime();
+  }
+  std::lock_guard<std::mutex> lock(mMutex);
+  ++mStats.statMisses;
+  auto [iter, inserted] = mEntries.try_emplace(path, std::move(file));
+  if (inserted && iter->second) {
+    iter->second->mName = iter->getKey();
+  }
+  return iter->second.get();
+}
+
+const FileEntry *
+FileManager::lookupInclude(llvm::StringRef name,
+                           std::optional<llvm::StringRef> includerDir,
+                           llvm::ArrayRef<std::string> searchDirs) {
+  bool isAbsolute = llvm::sys::path::is_absolute(name);
+  /// everything the answer depends on: the form, the including directory
+  /// and the search path
+  llvm::SmallString<256> key;
+  if (!isAbsolute) {
+    if (includerDir) {
+      key += '"';
+      key += *includerDir;
+    }
+    for (const std::string &dir : searchDirs) {
+      key += '\0';
+      key += dir;
+    }
+  }
+  key += '\0';
+  key += name;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mIncludes.find(key);
+    if (iter != mIncludes.end()) {
+      ++mStats.includeHits;
+      return iter->second;
+    }
+  }
+
+  const FileEntry *file = nullptr;
+  llvm::SmallString<256> path;
+  auto probe = [&](llvm::StringRef dir) {
+    path = dir;
+    llvm::sys::path::append(path, name);
+    file = getFile(path);
+    return file != nullptr;
+  };
+  if (isAbsolute) {
+    probe("");
+  } else if (!(includerDir && probe(*includerDir))) {
+    for (const std::string &dir : searchDirs) {
+      if (probe(dir))
+        break;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mMutex);
+  ++mStats.includeMisses;
+  return mIncludes.try_emplace(key, file).first->second;
+}
+
+llvm::ErrorOr<llvm::MemoryBufferRef>
+FileManager::getContents(const FileEntry &file) {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mContents.find(file.mUniqueID);
+    if (iter != mContents.end()) {
+      ++mStats.contentHits;
+      return iter->second->getMemBufferRef();
+    }
+  }
+  /// the size is known from the status, the file is mapped without
+  /// another stat when it is big enough
+  auto fd = llvm::sys::fs::openNativeFileForRead(file.mName);
+  if (!fd) {
+    return llvm::errorToErrorCode(fd.takeError());
+  }
+  auto buffer = llvm::MemoryBuffer::getOpenFile(*fd, file.mName, file.mSize);
+  llvm::sys::fs::closeFile(*fd);
+  if (!buffer) {
+    return buffer.getError();
+  }
+  std::lock_guard<std::mutex> lock(mMutex);
+  ++mStats.contentMisses;
+  auto &entry = mContents[file.mUniqueID];
+  if (!entry) {
+    entry = std::move(*buffer);
+  }
+  return entry->getMemBufferRef();
+}
+
+llvm::ErrorOr<llvm::MemoryBufferRef>
+FileManager::getContents(llvm::StringRef path) {
+  const FileEntry *file = getFile(path);
+  if (!file) {
+    /// a directory gets here too, report it the way reading it would
+    return llvm::sys::fs::is_directory(path)
+               ? std::make_error_code(std::errc::is_a_directory)
+               : std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+  return getContents(*file);
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+FileManager::getBuffer(const FileEntry &file) {
+  auto contents = getContents(file);
+  if (!contents) {
+    return contents.getError();
+  }
+  /// named by the path it was reached through, which a link may make
+  /// differ from the one it was read under
+  return llvm::MemoryBuffer::getMemBuffer(contents->getBuffer(),
+                                          file.getName());
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+FileManager::getBuffer(llvm::StringRef path) {
+  auto contents = getContents(path);
+  if (!contents) {
+    return contents.getError();
+  }
+  return llvm::MemoryBuffer::getMemBuffer(contents->getBuffer(), path);
+}
+
+FileManager::Statistics FileManager::getStatistics() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mStats;
+}
+
+void FileManager::printStatistics(llvm::raw_ostream &os) {
+  Statistics stats = getStatistics();
+  auto print = [&os](const char *what, uint64_t hits, uint64_t misses) {
+    uint64_t total = hits + misses;
+    os << llvm::format("%8llu %-16s %5.1f%% from the cache\n",
+                       (unsigned long long)total, what,
+                       total ? 100.0 * hits / total : 0.0);
+  };
+  os << "file manager:\n";
+  print("file lookups", stats.statHits, stats.statMisses);
+  print("include lookups", stats.includeHits, stats.includeMisses);
+  print("file reads", stats.contentHits, stats.contentMisses);
+}
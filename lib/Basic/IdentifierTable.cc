@@ -0,0 +1,22 @@
+/***********************************
+ * File:     IdentifierTable.cc
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/4
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#include "lcc/Basic/IdentifierTable.h"
+
+using namespace lcc;
+
+uint32_t IdentifierTable::get(llvm::StringRef name) {
+  auto [iter, inserted] = mIds.try_emplace(name, mNames.size());
+  if (inserted) {
+    mNames.push_back(iter->getKey());
+  }
+  return iter->second;
+}
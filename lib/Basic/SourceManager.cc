@@ -0,0 +1,153 @@
+/***********************************
+ * File:     SourceManager.cc
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/6
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#include "lcc/Basic/SourceManager.h"
+#include "lcc/Basic/CharScan.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+using namespace lcc;
+
+FileID SourceManager::createFileID(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+  size_t size = buffer->getBufferSize();
+  assert(size < std::numeric_limits<uint32_t>::max() - mNextOffset &&
+         "source locations exhausted");
+  uint32_t index = mFiles.size();
+  FileInfo info{std::move(buffer), mNextOffset, {}, {}};
+  /// one newline per ~40 bytes is typical for C, reserving avoids most of
+  /// the regrowth on big files
+  info.lineStarts.reserve(size / 40 + 1);
+  info.lineStarts.push_back(0);
+  const char *start = info.buffer->getBufferStart();
+  charscan::collectLineStarts(start, start, info.buffer->getBufferEnd(),
+                              info.lineStarts);
+  mNextOffset += size + 1;
+
+  auto pos = std::upper_bound(
+      mBufferRanges.begin(), mBufferRanges.end(), start,
+      [](const char *ptr, const auto &range) { return ptr < range.first; });
+  mBufferRanges.insert(pos, {start, index});
+  mFiles.push_back(std::move(info));
+  return FileID(index);
+}
+
+llvm::ErrorOr<const llvm::MemoryBuffer *>
+SourceManager::getBinaryFile(llvm::StringRef path) {
+  std::lock_guard<std::mutex> lock(mBinaryFilesMutex);
+  auto &entry = mBinaryFiles[path];
+  if (!entry) {
+    /// no null terminator, so files of a page multiple can be mapped too
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+      mBinaryFiles.erase(path);
+      return buffer.getError();
+    }
+    entry = std::move(*buffer);
+  }
+  return entry.get();
+}
+
+std::vector<std::string> SourceManager::getBinaryFilePaths() {
+  std::lock_guard<std::mutex> lock(mBinaryFilesMutex);
+  std::vector<std::string> paths;
+  for (const auto &entry : mBinaryFiles) {
+    paths.push_back(entry.getKey().str());
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+SourceLocation SourceManager::getLocation(const char *ptr) const {
+  auto pos = std::upper_bound(
+      mBufferRanges.begin(), mBufferRanges.end(), ptr,
+      [](const char *p, const auto &range) { return p < range.first; });
+  assert(pos != mBufferRanges.begin() && "pointer is not in a loaded buffer");
+  --pos;
+  const FileInfo &info = mFiles[pos->second];
+  assert(ptr <= info.buffer->getBufferEnd() &&
+         "pointer is not in a loaded buffer");
+  return SourceLocation(info.startOffset + (ptr - pos->first));
+}
+
+FileID SourceManager::getFileID(SourceLocation loc) const {
+  assert(loc.isValid() && loc.mID < mNextOffset);
+  /// files are laid out in load order, the owner is the last one starting at
+  /// or before loc
+  auto pos = std::upper_bound(
+      mFiles.begin(), mFiles.end(), loc.mID,
+      [](uint32_t id, const FileInfo &info) { return id < info.startOffset; });
+  return FileID(std::prev(pos) - mFiles.begin());
+}
+
+const char *SourceManager::getCharacterData(SourceLocation loc) const {
+  const FileInfo &info = getFileInfo(loc);
+  return info.buffer->getBufferStart() + (loc.mID - info.startOffset);
+}
+
+std::pair<unsigned, unsigned>
+SourceManager::getLineAndColumn(SourceLocation loc) const {
+  const FileInfo &info = getFileInfo(loc);
+  uint32_t offset = loc.mID - info.startOffset;
+  auto pos = std::upper_bound(info.lineStarts.begin(), info.lineStarts.end(),
+                              offset);
+  unsigned line = pos - info.lineStarts.begin();
+  return {line, offset - *std::prev(pos) + 1};
+}
+
+void SourceManager::addLineDirective(SourceLocation loc, unsigned line,
+                                     llvm::StringRef fileName) {
+  FileInfo &info = mFiles[getFileID(loc).getIndex()];
+  unsigned physicalLine = getLineAndColumn(loc).first;
+  assert(info.lineDirectives.empty() ||
+         info.lineDirectives.back().physicalLine < physicalLine);
+  if (fileName.empty()) {
+    fileName = info.lineDirectives.empty()
+                   ? info.buffer->getBufferIdentifier()
+                   : info.lineDirectives.back().fileName;
+  } else {
+    fileName = mLineFileNames.insert(fileName).first->getKey();
+  }
+  info.lineDirectives.push_back({physicalLine, line, fileName});
+}
+
+SourceManager::PresumedLoc
+SourceManager::getPresumedLoc(SourceLocation loc) const {
+  const FileInfo &info = getFileInfo(loc);
+  auto [line, column] = getLineAndColumn(loc);
+  /// the last directive on a line before this one
+  auto pos = std::lower_bound(
+      info.lineDirectives.begin(), info.lineDirectives.end(), line,
+      [](const LineDirective &directive, unsigned line) {
+        return directive.physicalLine < line;
+      });
+  if (pos == info.lineDirectives.begin()) {
+    return {info.buffer->getBufferIdentifier(), line, column};
+  }
+  --pos;
+  return {pos->fileName, pos->line + (line - pos->physicalLine - 1), column};
+}
+
+llvm::StringRef SourceManager::getLineText(SourceLocation loc) const {
+  const FileInfo &info = getFileInfo(loc);
+  uint32_t offset = loc.mID - info.startOffset;
+  auto pos = std::upper_bound(info.lineStarts.begin(), info.lineStarts.end(),
+                              offset);
+  llvm::StringRef buffer = info.buffer->getBuffer();
+  uint32_t begin = *std::prev(pos);
+  uint32_t end = pos == info.lineStarts.end() ? buffer.size() : *pos - 1;
+  llvm::StringRef line = buffer.slice(begin, end);
+  if (line.endswith("\r")) {
+    line = line.drop_back();
+  }
+  return line;
+}
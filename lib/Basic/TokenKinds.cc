@@ -11,7 +11,10 @@
  ***********************************/
 
 #include "lcc/Basic/TokenKinds.h"
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
 
 using namespace lcc;
 
@@ -46,45 +49,82 @@ const char *tok::getKeywordSpelling(TokenKind Kind) {
   return nullptr;
 }
 
+namespace {
+struct KeywordEntry {
+  std::string_view spelling;
+  tok::TokenKind kind;
+};
+
+constexpr KeywordEntry Keywords[] = {
+#define KEYWORD(ID) {#ID, tok::kw_##ID},
+#include "lcc/Basic/TokenKinds.def"
+};
+constexpr size_t NumKeywords = std::size(Keywords);
+
+constexpr size_t minKeywordLength() {
+  size_t result = ~size_t(0);
+  for (const auto &keyword : Keywords) {
+    result = std::min(result, keyword.spelling.size());
+  }
+  return result;
+}
+constexpr size_t maxKeywordLength() {
+  size_t result = 0;
+  for (const auto &keyword : Keywords) {
+    result = std::max(result, keyword.spelling.size());
+  }
+  return result;
+}
+constexpr size_t MinKeywordLength = minKeywordLength();
+constexpr size_t MaxKeywordLength = maxKeywordLength();
+static_assert(MinKeywordLength >= 2, "the hash reads the first two chars");
+
+/// Mixes the length, the first two and the last character. Only called with
+/// MinKeywordLength <= size <= MaxKeywordLength.
+constexpr uint32_t keywordHash(std::string_view spelling, uint32_t seed) {
+  uint32_t h = seed ^ static_cast<uint32_t>(spelling.size());
+  h = (h ^ static_cast<unsigned char>(spelling[0])) * 0x9E3779B1u;
+  h = (h ^ static_cast<unsigned char>(spelling[1])) * 0x85EBCA77u;
+  h = (h ^ static_cast<unsigned char>(spelling.back())) * 0xC2B2AE3Du;
+  return h >> 24;
+}
+
+/// slot -> index into Keywords plus one, zero meaning empty
+struct KeywordTable {
+  std::array<uint8_t, 256> slots{};
+  uint32_t seed{~0u};
+};
+
+/// Searches the first seed that maps every keyword to its own slot, so a
+/// lookup is one hash and at most one string compare.
+constexpr KeywordTable buildKeywordTable() {
+  static_assert(NumKeywords < 255);
+  for (uint32_t seed = 0; seed < 100000; ++seed) {
+    KeywordTable table;
+    bool perfect = true;
+    for (size_t i = 0; i < NumKeywords && perfect; ++i) {
+      auto &slot = table.slots[keywordHash(Keywords[i].spelling, seed)];
+      perfect = slot == 0;
+      slot = static_cast<uint8_t>(i + 1);
+    }
+    if (perfect) {
+      table.seed = seed;
+      return table;
+    }
+  }
+  return {};
+}
+constexpr KeywordTable KeywordTab = buildKeywordTable();
+static_assert(KeywordTab.seed != ~0u, "no perfect hash for the keyword set");
+} // namespace
+
 tok::TokenKind tok::getKeywordTokenType(std::string_view keyword) {
-  static std::unordered_map<std::string_view, tok::TokenKind> hashTable = {
-      {"_Bool", tok::kw__Bool},
-      {"auto", tok::kw_auto},
-      {"double", tok::kw_double},
-      {"int", tok::kw_int},
-      {"struct", tok::kw_struct},
-      {"break", tok::kw_break},
-      {"else", tok::kw_else},
-      {"long", tok::kw_long},
-      {"switch", tok::kw_switch},
-      {"case", tok::kw_case},
-      {"enum", tok::kw_enum},
-      {"register", tok::kw_register},
-      {"typedef", tok::kw_typedef},
-      {"char", tok::kw_char},
-      {"extern", tok::kw_extern},
-      {"return", tok::kw_return},
-      {"union", tok::kw_union},
-      {"const", tok::kw_const},
-      {"float", tok::kw_float},
-      {"short", tok::kw_short},
-      {"unsigned", tok::kw_unsigned},
-      {"continue", tok::kw_continue},
-      {"for", tok::kw_for},
-      {"signed", tok::kw_signed},
-      {"default", tok::kw_default},
-      {"goto", tok::kw_goto},
-      {"sizeof", tok::kw_sizeof},
-      {"volatile", tok::kw_volatile},
-      {"do", tok::kw_do},
-      {"if", tok::kw_if},
-      {"static", tok::kw_static},
-      {"while", tok::kw_while},
-      {"void", tok::kw_void},
-      {"restrict", tok::kw_restrict},
-      {"inline", tok::kw_inline}};
-  if (hashTable.find(keyword) != hashTable.end()) {
-    return hashTable[keyword];
+  if (keyword.size() < MinKeywordLength || keyword.size() > MaxKeywordLength) {
+    return tok::identifier;
+  }
+  auto slot = KeywordTab.slots[keywordHash(keyword, KeywordTab.seed)];
+  if (slot && Keywords[slot - 1].spelling == keyword) {
+    return Keywords[slot - 1].kind;
   }
   return tok::identifier;
 }
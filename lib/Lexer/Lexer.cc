@@ -9,28 +9,125 @@
  ***********************************/
 
 #include "lcc/Lexer/Lexer.h"
+#include "lcc/Basic/CharScan.h"
+#include "lcc/Basic/Match.h"
 #include "lcc/Basic/Util.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/Path.h"
 #include <algorithm>
+#include <array>
 #include <charconv> // std::from_chars
 #include <limits>
-#include <set>
+#include <thread>
 
 namespace lcc {
 
 using namespace llvm;
 
-Lexer::Lexer(llvm::SourceMgr &mgr, DiagnosticEngine &diag,
-             std::string &&sourceCode, std::string_view sourcePath)
-    : Mgr(mgr), Diag(diag), mSourceCode(std::move(sourceCode)) {
+Lexer::Lexer(SourceManager &mgr, DiagnosticEngine &diag,
+             IdentifierTable &idents, std::unique_ptr<MemoryBuffer> buffer)
+    : Mgr(mgr), Diag(diag), mIdents(idents) {
+  /// the buffer is scanned in place, \r\n and a leading BOM are handled by
+  /// the scanner instead of rewriting the source first
+  mFileID = Mgr.createFileID(std::move(buffer));
+  const auto &m = Mgr.getBuffer(mFileID);
+  P = m.getBufferStart();
+  Ep = m.getBufferEnd();
+  if (m.getBuffer().startswith("\xef\xbb\xbf")) {
+    P += 3;
+  }
+  mSp = P;
+}
+
+Lexer::Lexer(SourceManager &mgr, DiagnosticEngine &diag,
+             IdentifierTable &idents, FileID fileID, const char *begin,
+             const char *end)
+    : Mgr(mgr), mFileID(fileID), Diag(diag), mIdents(idents), P(begin),
+      Ep(end), mSp(begin) {}
+
+namespace {
+enum CharClass : uint8_t { DecDigit = 1, HexDigit = 2 };
+
+constexpr std::array<uint8_t, 256> CharClasses = [] {
+  std::array<uint8_t, 256> table{};
+  for (char ch = '0'; ch <= '9'; ++ch) {
+    table[static_cast<uint8_t>(ch)] = DecDigit | HexDigit;
+  }
+  for (char ch = 'a'; ch <= 'f'; ++ch) {
+    table[static_cast<uint8_t>(ch)] = HexDigit;
+    table[static_cast<uint8_t>(ch - 'a' + 'A')] = HexDigit;
+  }
+  return table;
+}();
+
+inline bool isCharClass(char ch, uint8_t charClass) {
+  return CharClasses[static_cast<uint8_t>(ch)] & charClass;
+}
 
-  RegularSourceCode();
-  auto memBuf = MemoryBuffer::getMemBuffer(mSourceCode, sourcePath);
-  Mgr.AddNewSourceBuffer(std::move(memBuf), SMLoc());
-  auto *m = Mgr.getMemoryBuffer(Mgr.getMainFileID());
-  P = m->getBufferStart();
-  Ep = m->getBufferEnd();
+/// end of the digits of class \p charClass in [p, ep), the first '.' counts
+/// as a digit and sets \p isFloat
+const char *skipMantissa(const char *p, const char *ep, uint8_t charClass,
+                         bool &isFloat) {
+  for (; p != ep; ++p) {
+    if (*p == '.' && !isFloat) {
+      isFloat = true;
+    } else if (!isCharClass(*p, charClass)) {
+      break;
+    }
+  }
+  return p;
 }
 
+enum class NumberSuffix { None, U, L, UL, LL, ULL, F, Invalid };
+
+/// u and l/ll in either order for integers, f or l for floats. ll has to be
+/// written in one case, lL is invalid like in C.
+NumberSuffix classifySuffix(const char *p, const char *ep, bool isFloat) {
+  if (p == ep) {
+    return NumberSuffix::None;
+  }
+  if (isFloat) {
+    if (ep - p != 1) {
+      return NumberSuffix::Invalid;
+    }
+    switch (*p) {
+    case 'f':
+    case 'F':
+      return NumberSuffix::F;
+    case 'l':
+    case 'L':
+      return NumberSuffix::L;
+    default:
+      return NumberSuffix::Invalid;
+    }
+  }
+  bool isUnsigned = false;
+  unsigned longs = 0;
+  while (p != ep) {
+    if ((*p == 'u' || *p == 'U') && !isUnsigned) {
+      isUnsigned = true;
+      ++p;
+    } else if ((*p == 'l' || *p == 'L') && !longs) {
+      longs = 1;
+      if (++p != ep && *p == p[-1]) {
+        longs = 2;
+        ++p;
+      }
+    } else {
+      return NumberSuffix::Invalid;
+    }
+  }
+  if (longs == 0) {
+    return NumberSuffix::U;
+  }
+  if (longs == 1) {
+    return isUnsigned ? NumberSuffix::UL : NumberSuffix::L;
+  }
+  return isUnsigned ? NumberSuffix::ULL : NumberSuffix::LL;
+}
+} // namespace
+
 /**
 整型
 10进制：123 123u 123l 123ul 123lu 123ull 123llu
@@ -54,23 +151,11 @@ Token::ValueType Lexer::ParseNumber(const Token &ppToken) {
   /// prefix
   bool isHex = character.size() > 2 &&
                (character.startswith("0x") || character.startswith("0X")) &&
-               (IsHexDigit(character[2]) || character[2] == '.');
-  std::vector<char> charSet{'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
-  if (isHex) {
-    charSet = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a',
-               'b', 'c', 'd', 'e', 'f', 'A', 'B', 'C', 'D', 'E', 'F'};
-  }
-  charSet.shrink_to_fit();
+               (isCharClass(character[2], HexDigit) || character[2] == '.');
+  const char *digitsBegin = begin + (isHex ? 2 : 0);
   bool isFloat = false;
-  auto searchFunction = [&charSet, &isFloat](char c) mutable {
-    if (c == '.' && !isFloat) {
-      isFloat = true;
-      return false;
-    }
-    return std::find(charSet.begin(), charSet.end(), c) == charSet.end();
-  };
-  const auto *suffixBegin =
-      std::find_if(begin + (isHex ? 2 : 0), end, searchFunction);
+  const char *suffixBegin =
+      skipMantissa(digitsBegin, end, isHex ? HexDigit : DecDigit, isFloat);
   // If it's a float it might still have an exponent part. If it's non hex this
   // is e [optional + or -] then again followed by digits. If it's a hex then
   // its p [optional + or -]. We check if it's either an then continue our
@@ -85,10 +170,7 @@ Token::ValueType Lexer::ParseNumber(const Token &ppToken) {
     const auto *prev = suffixBegin;
     /// The exponent of a hex floating point number is actually normal decimal
     /// digits not hex
-    if (isHex) {
-      charSet.resize(10);
-    }
-    suffixBegin = std::find_if(suffixBegin, end, searchFunction);
+    suffixBegin = skipMantissa(suffixBegin, end, DecDigit, isFloat);
     /// first character must be digit
     if (prev == suffixBegin) {
       DiagReport(
@@ -115,29 +197,27 @@ Token::ValueType Lexer::ParseNumber(const Token &ppToken) {
     }
   }
 
-  auto suffix = std::string_view(suffixBegin, std::distance(suffixBegin, end));
-  bool valid;
-  if (!isFloat) {
-    static std::set<std::string_view> variants = {
-        "u",   "U",   "ul", "Ul", "uL", "UL", "uLL", "ULL",
-        "ull", "Ull", "lu", "lU", "Lu", "LU", "LLu", "LLU",
-        "llu", "llU", "l",  "L",  "ll", "LL", ""};
-    valid = variants.find(suffix) != variants.end();
-  } else {
-    static std::set<std::string_view> variants = {"f", "l", "F", "L", ""};
-    valid = variants.find(suffix) != variants.end();
-  }
-  if (!valid) {
+  NumberSuffix suffix = classifySuffix(suffixBegin, end, isFloat);
+  if (suffix == NumberSuffix::Invalid) {
     DiagReport(
         Diag,
         SMLoc::getFromPointer(ppToken.getOffset() + (suffixBegin - begin)),
         diag::err_lex_invalid_literal_suffix);
+    /// already diagnosed, carry on with the value of the plain literal
+    suffix = NumberSuffix::None;
   }
 
   if (!isFloat) {
-    std::string_view sv(begin, suffixBegin - begin);
-    std::uint64_t number = std::strtoull(sv.data(), nullptr, 0);
-    if (suffix.empty()) {
+    /// a leading 0 is an octal prefix, parsing stops at the first 8 or 9
+    /// like strtoull does after the diagnostic above
+    int base = isHex ? 16 : (begin[0] == '0' ? 8 : 10);
+    std::uint64_t number = 0;
+    auto [ptr, ec] = std::from_chars(digitsBegin, suffixBegin, number, base);
+    if (ec == std::errc::result_out_of_range) {
+      number = std::numeric_limits<uint64_t>::max();
+    }
+    switch (suffix) {
+    case NumberSuffix::None:
       if (number > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
         if (isHexOrOctal && number <= std::numeric_limits<uint32_t>::max()) {
           return static_cast<uint32_t>(number);
@@ -151,12 +231,13 @@ Token::ValueType Lexer::ParseNumber(const Token &ppToken) {
       } else {
         return static_cast<int32_t>(number);
       }
-    } else if (suffix == "u" || suffix == "U") {
+    case NumberSuffix::U:
       if (number > std::numeric_limits<uint32_t>::max()) {
         return number;
       }
       return static_cast<uint32_t>(number);
-    } else if (suffix == "L" || suffix == "l") {
+    case NumberSuffix::L:
+    case NumberSuffix::LL:
       /// think about long case
       if (isHexOrOctal) {
         if (number >
@@ -165,44 +246,31 @@ Token::ValueType Lexer::ParseNumber(const Token &ppToken) {
         }
       }
       return static_cast<int64_t>(number);
-    } else if (suffix.size() == 2 &&
-               std::any_of(suffix.begin(), suffix.end(),
-                           [](char c) { return c == 'u' || c == 'U'; }) &&
-               std::any_of(suffix.begin(), suffix.end(),
-                           [](char c) { return c == 'l' || c == 'L'; })) {
-      /// just think about ul
-      return static_cast<uint64_t>(number);
-    } else if (suffix == "ll" || suffix == "LL") {
-      if (isHexOrOctal) {
-        if (number >
-            static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
-          return number;
-        }
-      }
-      return static_cast<int64_t>(number);
-    } else if (suffix.size() == 3 &&
-               std::any_of(suffix.begin(), suffix.end(),
-                           [](char c) { return c == 'u' || c == 'U'; }) &&
-               (suffix.find("LL") != std::string_view::npos ||
-                suffix.find("ll") != std::string_view::npos)) {
-      /// just think about ull
+    case NumberSuffix::UL:
+    case NumberSuffix::ULL:
       return number;
-    } else {
+    default:
       LCC_UNREACHABLE;
     }
-  } else {
-    auto input = (*begin == '.' ? "0" : "") + std::string(begin, suffixBegin);
-    if (suffix.empty()) {
-      return std::strtod(input.c_str(), nullptr);
-    }
-    if (suffix == "f" || suffix == "F") {
-      return std::strtof(input.c_str(), nullptr);
-    }
-    if (suffix == "l" || suffix == "L") {
-      return std::strtod(input.c_str(), nullptr);
+  }
+
+  /// from_chars takes hex floats without their 0x
+  auto format = isHex ? std::chars_format::hex : std::chars_format::general;
+  if (suffix == NumberSuffix::F) {
+    float value = 0;
+    auto [ptr, ec] = std::from_chars(digitsBegin, suffixBegin, value, format);
+    if (ec == std::errc::result_out_of_range) {
+      /// from_chars leaves the value alone, strtof gives inf or 0
+      return std::strtof(std::string(begin, suffixBegin).c_str(), nullptr);
     }
+    return value;
   }
-  LCC_UNREACHABLE;
+  double value = 0;
+  auto [ptr, ec] = std::from_chars(digitsBegin, suffixBegin, value, format);
+  if (ec == std::errc::result_out_of_range) {
+    return std::strtod(std::string(begin, suffixBegin).c_str(), nullptr);
+  }
+  return value;
 }
 
 tok::TokenKind Lexer::ParsePunctuation(const char *&offset, char curChar,
@@ -440,30 +508,503 @@ tok::TokenKind Lexer::ParsePunctuation(const char *&offset, char curChar,
   }
   return type;
 }
-std::vector<Token> Lexer::tokenize() {
+std::vector<Token> Lexer::tokenize() { return Lex(false); }
+
+std::vector<Token> Lexer::lexCTokens() { return Lex(true); }
+
+std::vector<Token> Lexer::tokenize(unsigned threads) {
+  return LexParallel(false, threads);
+}
+
+std::vector<Token> Lexer::lexCTokens(unsigned threads) {
+  return LexParallel(true, threads);
+}
+
+bool Lexer::lexCToken(Token &token) {
+  /// lex in small batches, a call per token through the whole state machine
+  /// setup would dominate
+  constexpr size_t PullBatch = 256;
+  if (mPendingPos == mPending.size()) {
+    mPending.clear();
+    mPendingPos = 0;
+    unsigned errors = Diag.numErrors();
+    LexInto(mPending, true, PullBatch);
+    /// After a lexer error the parser gets no more tokens, but the rest of
+    /// the file is still lexed for its own errors. What the parser says
+    /// about the input ending there is noise.
+    if (Diag.numErrors() != errors) {
+      while (!mPending.empty()) {
+        mPending.clear();
+        LexInto(mPending, true, PullBatch);
+      }
+      mNumErrors += Diag.numErrors() - errors;
+      Diag.suppressAllDiagnostics();
+      return false;
+    }
+    if (mPending.empty()) {
+      return false;
+    }
+  }
+  token = mPending[mPendingPos++];
+  return true;
+}
+
+std::vector<Token> Lexer::Lex(bool cTokens) {
+  std::vector<Token> results;
+  /// roughly one token every five bytes of typical C
+  results.reserve((Ep - P) / 5 + 16);
+  LexInto(results, cTokens, std::numeric_limits<size_t>::max());
+  return results;
+}
+
+namespace {
+/// Output of one chunk: its own diagnostics buffer, identifier table and (in
+/// its lexer) literal pool, so the workers share nothing but the read-only
+/// source.
+struct Chunk {
+  DiagnosticEngine::Buffer diagBuffer;
+  DiagnosticEngine diag;
+  IdentifierTable idents;
+  std::unique_ptr<Lexer> lexer;
+  std::vector<Token> tokens;
+  /// filled while stitching: chunk local id -> id in the shared table
+  std::vector<uint32_t> idMap;
+  uint32_t literalBase{0};
+  /// position of the first token in the stitched result
+  size_t offset{0};
 
+  explicit Chunk(SourceManager &mgr) : diag(mgr, llvm::nulls()) {
+    diag.setBuffer(&diagBuffer);
+  }
+};
+} // namespace
+
+std::vector<Token> Lexer::LexParallel(bool cTokens, unsigned threads) {
+  /// a thread per chunk smaller than this costs more than it saves
+  constexpr size_t MinChunkSize = 1 << 20;
+  size_t size = Ep - P;
+  threads = std::min<size_t>(threads, size / MinChunkSize);
+  if (threads <= 1 || mFinished || mSp != P) {
+    return Lex(cTokens);
+  }
+
+  /// chunk i is [bounds[i], bounds[i + 1]), every cut right behind a newline
+  /// that really ends a line, a spliced one could be inside a line comment
+  std::vector<const char *> bounds{P};
+  for (unsigned i = 1; i < threads; ++i) {
+    const char *target = std::max(P + size / threads * i, bounds.back());
+    const char *nl = charscan::findSplicedLineEnd(target, Ep);
+    if (nl == Ep || nl + 1 == Ep) {
+      break;
+    }
+    bounds.push_back(nl + 1);
+  }
+  bounds.push_back(Ep);
+
+  /// The first chunk runs on this thread straight into our identifier
+  /// table, literal pool, diagnostics and result vector; only the later
+  /// chunks need the renumbering below.
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+    auto chunk = std::make_unique<Chunk>(Mgr);
+    chunk->lexer.reset(new Lexer(Mgr, i ? chunk->diag : Diag,
+                                 i ? chunk->idents : mIdents, mFileID,
+                                 bounds[i], bounds[i + 1]));
+    chunk->lexer->mResolveEmbed = mResolveEmbed;
+    chunks.push_back(std::move(chunk));
+  }
+  std::swap(mLiterals, chunks[0]->lexer->mLiterals);
   std::vector<Token> results;
+  /// roughly one token every five bytes of typical C
+  results.reserve(size / 5 + 16);
 
+  /// A chunk after a cut inside a literal or comment starts in the wrong
+  /// state. Every chunk is lexed speculatively anyway, the stitching below
+  /// finds out which results to drop.
+  auto lexChunk = [&](Chunk &chunk, std::vector<Token> &tokens) {
+    chunk.lexer->LexInto(tokens, cTokens, std::numeric_limits<size_t>::max());
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    chunks[i]->tokens.reserve((bounds[i + 1] - bounds[i]) / 5 + 16);
+    workers.emplace_back(lexChunk, std::ref(*chunks[i]),
+                         std::ref(chunks[i]->tokens));
+  }
+  lexChunk(*chunks[0], results);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  /// Decide which results survive, in order. The ids and literal slots of a
+  /// surviving chunk are chunk local; its identifier table holds the names
+  /// in order of first sight, so interning them in table order hands out
+  /// the ids the serial lexer would. Literal slots only move by the size of
+  /// the pool so far.
+  std::vector<Chunk *> live;
+  size_t total = results.size();
+  for (size_t i = 0; i < chunks.size();) {
+    Chunk &chunk = *chunks[i];
+    size_t next = i + 1;
+    /// chunk i was lexed from the right state, but a literal or comment ran
+    /// over its end: the next chunk started inside it and is dropped, chunk
+    /// i lexes on through the next one's range instead
+    while (chunk.lexer->mSpilled) {
+      chunk.lexer->mSpilled = false;
+      chunk.lexer->Ep = bounds[++next];
+      lexChunk(chunk, i ? chunk.tokens : results);
+    }
+    if (i == 0) {
+      std::swap(mLiterals, chunk.lexer->mLiterals);
+      total = results.size();
+      i = next;
+      continue;
+    }
+    chunk.idMap.reserve(chunk.idents.size());
+    for (uint32_t id = 0; id < chunk.idents.size(); ++id) {
+      chunk.idMap.push_back(mIdents.get(chunk.idents.getName(id)));
+    }
+    chunk.literalBase = mLiterals.append(std::move(chunk.lexer->mLiterals));
+    chunk.offset = total;
+    total += chunk.tokens.size();
+    Diag.emitBuffered(chunk.diagBuffer);
+    live.push_back(&chunk);
+    i = next;
+  }
+
+  /// the renumbered tokens go to disjoint ranges of results, in parallel
+  results.resize(total, Token(tok::eof, Ep, 0));
+  auto renumber = [&](Chunk &chunk) {
+    Token *out = results.data() + chunk.offset;
+    for (Token token : chunk.tokens) {
+      switch (token.getTokenKind()) {
+      case tok::identifier:
+        token.setIndex(chunk.idMap[token.getIdentifierId()]);
+        break;
+      case tok::numeric_constant:
+      case tok::string_literal:
+      case tok::char_constant:
+        if (cTokens) {
+          token.setIndex(chunk.literalBase + token.getLiteralIndex());
+        }
+        break;
+      case tok::embed_data:
+        /// resolved while lexing, in both modes
+        token.setIndex(chunk.literalBase + token.getLiteralIndex());
+        break;
+      default:
+        break;
+      }
+      *out++ = token;
+    }
+    chunk.tokens = {};
+  };
+  workers.clear();
+  for (size_t i = 1; i < live.size(); ++i) {
+    workers.emplace_back(renumber, std::ref(*live[i]));
+  }
+  if (!live.empty()) {
+    renumber(*live[0]);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  mSp = P = Ep;
+  mFinished = true;
+  return results;
+}
+
+namespace {
+/// end of the directive name \p name if it follows the '#' that ends at
+/// \p p, nullptr otherwise
+const char *matchDirectiveName(const char *p, const char *ep, StringRef name) {
+  p = charscan::skipHorizontalSpace(p, ep);
+  const char *end = charscan::skipIdentifier(p, ep);
+  return StringRef(p, end - p) == name ? end : nullptr;
+}
+} // namespace
+
+/**
+ # embed "file" embed-parameter-sequence{opt} new-line
+ # embed <file> embed-parameter-sequence{opt} new-line
+
+ embed-parameter:
+    limit ( constant-expression )
+    prefix ( balanced-token-sequence{opt} )
+    suffix ( balanced-token-sequence{opt} )
+    if_empty ( balanced-token-sequence{opt} )
+
+ The file is looked up next to the including file, then relative to the
+ working directory. Its bytes are not turned into tokens: the embed_data
+ token keeps a view of the mapped file in the literal pool and the parser
+ takes that view over as it is. A limit has to be an integer literal here.
+ */
+const char *Lexer::LexEmbedDirective(const char *hash, const char *p,
+                                     std::vector<Token> &expansion) {
+  const char *lineEnd = charscan::findLineEnd(p, Ep);
+  const char *end = lineEnd;
+  if (end != p && end[-1] == '\r') {
+    --end;
+  }
+  p = charscan::skipHorizontalSpace(p, end);
+  char closing = '\0';
+  if (p != end && *p == '"') {
+    closing = '"';
+  } else if (p != end && *p == '<') {
+    closing = '>';
+  }
+  const char *nameEnd = closing ? std::find(p + 1, end, closing) : end;
+  if (nameEnd == end) {
+    DiagReport(Diag, SMLoc::getFromPointer(p),
+               diag::err_lex_embed_expected_file);
+    return end;
+  }
+  StringRef fileName(p + 1, nameEnd - p - 1);
+
+  /// The parameters are ordinary pp tokens. The newline is lexed along, it
+  /// ends a trailing number like it ends every other token.
+  Lexer paramLexer(Mgr, Diag, mIdents, mFileID, nameEnd + 1,
+                   lineEnd == Ep ? Ep : lineEnd + 1);
+  paramLexer.mResolveEmbed = false;
+  std::vector<Token> params = paramLexer.Lex(false);
+  if (paramLexer.mSpilled) {
+    switch (*paramLexer.P) {
+    case '\'':
+      DiagReport(Diag, SMLoc::getFromPointer(paramLexer.P),
+                 diag::err_lex_unclosed_char);
+      break;
+    case '"':
+      DiagReport(Diag, SMLoc::getFromPointer(paramLexer.P),
+                 diag::err_lex_unclosed_string);
+      break;
+    default:
+      DiagReport(Diag, SMLoc::getFromPointer(paramLexer.P),
+                 diag::err_lex_unclosed_block_comment);
+      break;
+    }
+    return end;
+  }
+  if (!params.empty() && params.back().getTokenKind() == tok::pp_newline) {
+    params.pop_back();
+  }
+
+  std::optional<uint64_t> limit;
+  std::optional<ArrayRef<Token>> prefix, suffix, ifEmpty;
+  bool valid = true;
+  for (size_t i = 0; i < params.size();) {
+    const Token &nameToken = params[i];
+    if (nameToken.getTokenKind() != tok::identifier) {
+      DiagReport(Diag, nameToken.getSMLoc(),
+                 diag::err_lex_embed_unknown_parameter,
+                 nameToken.getRepresentation());
+      return end;
+    }
+    /// vendor parameters are prefix::name, none is supported
+    size_t clause = i + 1;
+    bool isVendor = clause + 2 < params.size() &&
+                    params[clause].getTokenKind() == tok::colon &&
+                    params[clause + 1].getTokenKind() == tok::colon;
+    if (isVendor) {
+      clause += 3;
+    }
+    /// the clause runs to the matching ')'
+    size_t close = clause;
+    if (close < params.size() && params[close].getTokenKind() == tok::l_paren) {
+      for (unsigned depth = 0; close < params.size(); ++close) {
+        auto kind = params[close].getTokenKind();
+        depth += kind == tok::l_paren;
+        depth -= kind == tok::r_paren;
+        if (kind == tok::r_paren && !depth) {
+          break;
+        }
+      }
+    }
+    StringRef name(nameToken.getOffset(),
+                   params[clause - 1].getOffset() +
+                       params[clause - 1].getLength() - nameToken.getOffset());
+    if (close == clause || close == params.size()) {
+      DiagReport(Diag, nameToken.getSMLoc(),
+                 diag::err_lex_embed_expected_parameter_clause, name);
+      return end;
+    }
+    ArrayRef<Token> tokens(params.data() + clause + 1, close - clause - 1);
+    i = close + 1;
+
+    /// __name__ is the reserved spelling of every standard parameter
+    if (!isVendor && name.size() > 4 && name.startswith("__") &&
+        name.endswith("__")) {
+      name = name.drop_front(2).drop_back(2);
+    }
+    std::optional<ArrayRef<Token>> *sequence = nullptr;
+    if (isVendor) {
+      DiagReport(Diag, nameToken.getSMLoc(),
+                 diag::err_lex_embed_unknown_parameter, name);
+      valid = false;
+      continue;
+    } else if (name == "prefix") {
+      sequence = &prefix;
+    } else if (name == "suffix") {
+      sequence = &suffix;
+    } else if (name == "if_empty") {
+      sequence = &ifEmpty;
+    } else if (name == "limit") {
+      if (limit) {
+        DiagReport(Diag, nameToken.getSMLoc(),
+                   diag::err_lex_embed_duplicate_parameter, name);
+        valid = false;
+        continue;
+      }
+      limit = 0;
+      if (tokens.size() != 1 || tokens[0].getTokenKind() != tok::pp_number) {
+        DiagReport(Diag, nameToken.getSMLoc(),
+                   diag::err_lex_embed_invalid_limit);
+        valid = false;
+        continue;
+      }
+      match(ParseNumber(tokens[0]), [&](const auto &value) {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_integral_v<T>) {
+          limit = value;
+        } else {
+          DiagReport(Diag, nameToken.getSMLoc(),
+                     diag::err_lex_embed_invalid_limit);
+          valid = false;
+        }
+      });
+      continue;
+    } else {
+      DiagReport(Diag, nameToken.getSMLoc(),
+                 diag::err_lex_embed_unknown_parameter, name);
+      valid = false;
+      continue;
+    }
+    if (*sequence) {
+      DiagReport(Diag, nameToken.getSMLoc(),
+                 diag::err_lex_embed_duplicate_parameter, name);
+      valid = false;
+      continue;
+    }
+    *sequence = tokens;
+  }
+  if (!valid) {
+    return end;
+  }
+
+  SmallString<256> path;
+  if (!sys::path::is_absolute(fileName)) {
+    path = sys::path::parent_path(Mgr.getBufferName(mFileID));
+  }
+  sys::path::append(path, fileName);
+  auto file = Mgr.getBinaryFile(path);
+  if (!file && path != fileName) {
+    file = Mgr.getBinaryFile(fileName);
+  }
+  if (!file) {
+    DiagReport(Diag, SMLoc::getFromPointer(p),
+               diag::err_lex_embed_cannot_open, fileName,
+               file.getError().message());
+    return end;
+  }
+  ArrayRef<uint8_t> bytes(
+      reinterpret_cast<const uint8_t *>((*file)->getBufferStart()),
+      (*file)->getBufferSize());
+  if (limit) {
+    bytes = bytes.take_front(std::min<uint64_t>(*limit, bytes.size()));
+  }
+
+  if (bytes.empty()) {
+    if (ifEmpty) {
+      expansion.insert(expansion.end(), ifEmpty->begin(), ifEmpty->end());
+    }
+    return end;
+  }
+  if (prefix) {
+    expansion.insert(expansion.end(), prefix->begin(), prefix->end());
+  }
+  expansion.emplace_back(tok::embed_data, hash, end - hash,
+                         mLiterals.add(bytes));
+  if (suffix) {
+    expansion.insert(expansion.end(), suffix->begin(), suffix->end());
+  }
+  return end;
+}
+
+void Lexer::LexInto(std::vector<Token> &results, bool cTokens, size_t limit) {
   /// Sp meaning start p
-  const char *Sp = P;
-  std::string strBuilder;
-  char includeDelimiter{' '};
+  const char *Sp = mSp;
+  char includeDelimiter = mIncludeDelimiter;
+  /// the last two pp tokens were `#` `include`, tracked here because in
+  /// cTokens mode they never reach results
+  tok::TokenKind lastKind = mLastKind;
+  bool afterHashInclude = mAfterHashInclude;
+  bool inDirective = mInDirective;
+  /// the newline ending a directive line was inserted
+  bool stop = false;
 
   auto InsertToken = [&](const char *sp, const char *p,
-                         tok::TokenKind tokenKind, std::string value = {}) {
-        results.emplace_back(tokenKind, sp, p - sp, Mgr, std::move(value));
-    strBuilder.clear();
+                         tok::TokenKind tokenKind, uint32_t index = 0) {
+    if (static_cast<size_t>(p - sp) > Token::MaxLength) {
+      DiagReport(Diag, SMLoc::getFromPointer(sp), diag::err_lex_token_too_long,
+                 Token::MaxLength);
+      p = sp + Token::MaxLength;
+    }
+    afterHashInclude = tokenKind == tok::identifier &&
+                       lastKind == tok::pp_hash &&
+                       StringRef(sp, p - sp) == "include";
+    if (mStopAfterDirective) {
+      if (tokenKind == tok::pp_hash &&
+          (lastKind == tok::pp_newline || lastKind == tok::unknown)) {
+        inDirective = true;
+      } else if (tokenKind == tok::pp_newline && inDirective &&
+                 lastKind != tok::pp_backslash) {
+        inDirective = false;
+        stop = true;
+      }
+    }
+    lastKind = tokenKind;
+    Token token(tokenKind, sp, p - sp, index);
+    if (!cTokens || ConvertToCToken(token)) {
+      results.push_back(token);
+    }
+  };
+
+  /// P points behind the opening quote, the token spans both quotes
+  auto LexQuoted = [&](char quote, tok::TokenKind tokenKind) {
+    const char *closing = ScanQuotedBody(P, Ep, quote);
+    if (closing == Ep) {
+      /// unclosed, reported after the loop
+      state = quote == '"' ? State::StringLiteral : State::CharacterLiteral;
+      P = Ep;
+      return;
+    }
+    if (tokenKind == tok::char_constant && closing == P) {
+      DiagReport(Diag, SMLoc::getFromPointer(Sp),
+                 diag::err_lex_empty_char_literal);
+    }
+    P = closing + 1;
+    InsertToken(Sp, P, tokenKind);
   };
 
-  while (P < Ep) {
+  while (P < Ep && results.size() < limit && !stop) {
     char curChar = (P < Ep ? P[0] : '\0');
     char nextChar = (P < Ep - 1) ? P[1] : '\0';
 
     switch (state) {
     case State::Start: {
+      if (charscan::isHorizontalSpace(curChar)) {
+        P = charscan::skipHorizontalSpace(P + 1, Ep);
+        break;
+      }
       if (IsLetter(curChar)) {
-        state = State::Identifier;
         Sp = P;
+        P = charscan::skipIdentifier(P + 1, Ep);
+        StringRef spelling(Sp, P - Sp);
+        auto kind = tok::getKeywordTokenType(spelling);
+        if (kind != tok::identifier) {
+          InsertToken(Sp, P, kind);
+        } else {
+          InsertToken(Sp, P, tok::identifier, mIdents.get(spelling));
+        }
         break;
       }
       if (IsDigit(curChar) || (curChar == '.' && IsDigit(nextChar))) {
@@ -472,53 +1013,72 @@ std::vector<Token> Lexer::tokenize() {
         break;
       }
       if (curChar == '\'') {
-        state = State::CharacterLiteral;
         Sp = P++;
+        LexQuoted('\'', tok::char_constant);
         break;
       }
       if (curChar == '"') {
-        if (results.size() >= 2 &&
-            results[results.size() - 2].getTokenKind() == tok::pp_hash &&
-            results[results.size() - 1].getTokenKind() == tok::identifier &&
-            results[results.size() - 1].getRepresentation() == "include") {
+        if (afterHashInclude) {
           state = State::AfterInclude;
           includeDelimiter = '"';
           Sp = P++;
         } else {
-          state = State::StringLiteral;
           Sp = P++;
+          LexQuoted('"', tok::string_literal);
         }
         break;
       }
       if (curChar == '\\') {
+        Sp = P;
         InsertToken(Sp, ++P, tok::pp_backslash);
         break;
       }
       /// \r\n meaning \n in windows
       if (curChar == '\r' && nextChar == '\n') {
+        Sp = P;
         InsertToken(Sp + 1, P += 2, tok::pp_newline);
         break;
       }
       if (curChar == '\n') {
+        Sp = P;
         InsertToken(Sp, ++P, tok::pp_newline);
         break;
       }
       if (curChar == '/' && nextChar == '/') {
-        state = State::LineComment;
-        P += 2;
+        /// a backslash at the end of the line continues the comment
+        P = charscan::findSplicedLineEnd(P + 2, Ep);
         break;
       }
       if (curChar == '/' && nextChar == '*') {
-        state = State::BlockComment;
-        P += 2;
+        Sp = P;
+        const char *end = charscan::findBlockCommentEnd(P + 2, Ep);
+        if (end == Ep) {
+          /// unclosed, reported after the loop
+          state = State::BlockComment;
+          P = Ep;
+        } else {
+          P = end + 2;
+        }
         break;
       }
+      /// #embed is resolved right here, there is no preprocessor pass that
+      /// could expand it later
+      if (curChar == '#' && mResolveEmbed &&
+          (lastKind == tok::pp_newline || lastKind == tok::unknown)) {
+        if (const char *name = matchDirectiveName(P + 1, Ep, "embed")) {
+          std::vector<Token> expansion;
+          const char *end = LexEmbedDirective(P, name, expansion);
+          for (const Token &token : expansion) {
+            InsertToken(token.getOffset(), token.getOffset() + token.getLength(),
+                        token.getTokenKind(), token.getLiteralIndex());
+          }
+          P = end;
+          break;
+        }
+      }
       /// Line comments and block comments need to be processed first
       if (IsPunctuation(curChar)) {
-        if (curChar == '<' && results.size() >= 2 &&
-            results[results.size() - 2].getTokenKind() == tok::pp_hash &&
-            results[results.size() - 1].getTokenKind() == tok::identifier &&
-            results[results.size() - 1].getRepresentation() == "include") {
+        if (curChar == '<' && afterHashInclude) {
           state = State::AfterInclude;
           includeDelimiter = '>';
           Sp = P++;
@@ -533,66 +1093,28 @@ std::vector<Token> Lexer::tokenize() {
         P++;
         break;
       }
-      DiagReport(Diag, SMLoc::getFromPointer(Sp), diag::err_lex_illegal_char);
+      DiagReport(Diag, SMLoc::getFromPointer(P), diag::err_lex_illegal_char);
       P++; /// skip this char
       break;
     }
-    case State::CharacterLiteral: {
-      if (curChar == '\'' && strBuilder.empty()) {
-        state = State::Start;
-        InsertToken(Sp, P, tok::char_constant, strBuilder);
-        DiagReport(Diag, SMLoc::getFromPointer(Sp),
-                   diag::err_lex_empty_char_literal);
-      } else if (curChar == '\'' && !strBuilder.ends_with('\\')) {
-        state = State::Start;
-        InsertToken(Sp, P, tok::char_constant, strBuilder);
-      } else {
-        strBuilder += curChar;
-      }
-      P++;
-      break;
-    }
-    case State::StringLiteral: {
-      if (curChar == '"' &&
-          (strBuilder.empty() || !strBuilder.ends_with('\\'))) {
-        state = State::Start;
-        InsertToken(Sp, P, tok::string_literal, strBuilder);
-      } else {
-        strBuilder += curChar;
-      }
-      P++;
-      break;
-    }
-    case State::Identifier: {
-      if (IsLetter(curChar) || IsDigit(curChar)) {
-        strBuilder += curChar;
-        P++;
-      } else {
-        state = State::Start;
-        InsertToken(Sp, P, tok::identifier, strBuilder);
-      }
-      break;
-    }
     case State::Number: {
       constexpr std::uint8_t toLower = 32;
-      if (strBuilder.empty()) {
-        strBuilder += curChar;
+      if (P == Sp) {
         P++;
       } else {
+        std::string_view preCharacters(Sp, P - Sp);
         char lower_char = (curChar | toLower);
-        if (!IsJudgeNumber(strBuilder, lower_char) && (lower_char != 'e') &&
+        if (!IsJudgeNumber(preCharacters, lower_char) && (lower_char != 'e') &&
             (lower_char != 'p') && (lower_char != 'f') && (lower_char != 'u') &&
             (lower_char != 'l') && (lower_char != '.') &&
-            (((strBuilder.back() | toLower) != 'e' &&
-              (strBuilder.back() | toLower) != 'p') ||
+            (((preCharacters.back() | toLower) != 'e' &&
+              (preCharacters.back() | toLower) != 'p') ||
              (lower_char != '+' && lower_char != '-'))) {
-          InsertToken(Sp, P, tok::pp_number, strBuilder);
+          InsertToken(Sp, P, tok::pp_number);
           state = State::Start;
         } else {
-          strBuilder += curChar;
           P++;
         }
-        break;
       }
       break;
     }
@@ -600,45 +1122,60 @@ std::vector<Token> Lexer::tokenize() {
       char nnChar = (P < Ep - 2) ? P[2] : '\0';
       tok::TokenKind tk = ParsePunctuation(P, curChar, nextChar, nnChar);
       LCC_ASSERT(tk != tok::unknown);
-      InsertToken(Sp, P, tk, tok::getPunctuatorSpelling(tk));
+      InsertToken(Sp, P, tk);
       state = State::Start;
       break;
     }
-    case State::LineComment: {
-      if (curChar == '\n') {
-        state = State::Start;
-      } else {
-        P++;
-      }
-      break;
-    }
-    case State::BlockComment: {
-      if (curChar == '*' && nextChar == '/') {
-        state = State::Start;
-        P += 2;
-      } else {
-        P++;
-      }
-      break;
-    }
     case State::AfterInclude: {
-      if (curChar != includeDelimiter && curChar != '\n') {
-        strBuilder += curChar;
+      bool lineEnd = curChar == '\n' || (curChar == '\r' && nextChar == '\n');
+      if (curChar != includeDelimiter && !lineEnd) {
         P++;
         break;
       }
       /// curChar is delimiter
-      if (curChar != '\n') {
-        InsertToken(Sp, P++, tok::string_literal, strBuilder);
+      if (!lineEnd) {
+        InsertToken(Sp, ++P, tok::string_literal);
         state = State::Start;
         break;
       }
       DiagReport(Diag, SMLoc::getFromPointer(P),
                  diag::err_lex_illegal_newline_in_after_include);
+      state = State::Start;
+      break;
     }
+    case State::CharacterLiteral:
+    case State::StringLiteral:
+    case State::BlockComment:
+      LCC_UNREACHABLE;
     }
   }
-  results.shrink_to_fit();
+
+  mSp = Sp;
+  mIncludeDelimiter = includeDelimiter;
+  mLastKind = lastKind;
+  mAfterHashInclude = afterHashInclude;
+  mInDirective = inDirective;
+  if (P < Ep || mFinished) {
+    return;
+  }
+  if (Ep != Mgr.getBuffer(mFileID).getBufferEnd()) {
+    /// Chunks end behind a newline, which ends every token but literals and
+    /// comments. One of those crosses into the next chunk: rewind to its
+    /// start, LexParallel moves Ep on and lexes again from there.
+    if (state != State::Start) {
+      P = Sp;
+      state = State::Start;
+      mSpilled = true;
+    }
+    return;
+  }
+  mFinished = true;
+
+  if (state == State::Number) {
+    InsertToken(Sp, P, tok::pp_number);
+    state = State::Start;
+  }
+  /// no shrink_to_fit, the reallocation would briefly hold the tokens twice
 
   if (state == State::CharacterLiteral) {
     DiagReport(Diag, SMLoc::getFromPointer(Sp), diag::err_lex_unclosed_char);
@@ -651,71 +1188,197 @@ std::vector<Token> Lexer::tokenize() {
     DiagReport(Diag, SMLoc::getFromPointer(Sp),
                diag::err_lex_unclosed_after_include);
   }
+}
 
-  return results;
+namespace {
+/// behind a backslash newline (or \r\n) at \p p, else p itself
+const char *skipLineSplice(const char *p, const char *ep) {
+  if (p < ep && *p == '\\') {
+    if (p + 1 < ep && p[1] == '\n') {
+      return p + 2;
+    }
+    if (p + 2 < ep && p[1] == '\r' && p[2] == '\n') {
+      return p + 3;
+    }
+  }
+  return p;
 }
 
-std::vector<Token> Lexer::toCTokens(std::vector<Token> &&ppTokens) {
-  std::vector<Token> results;
-  for (auto &iter : ppTokens) {
-    switch (iter.getTokenKind()) {
-    case tok::pp_hash:
-    case tok::pp_hashhash:
-    case tok::pp_backslash:
-      DiagReport(Diag, SMLoc::getFromPointer(iter.getOffset()),
-                 diag::err_lex_illegal_token_in_c);
+/// Skips white space, block comments and line splices on one line.
+/// Returns the first other character, an unclosed comment is left alone.
+const char *skipSpaceAndComments(const char *p, const char *ep) {
+  while (p < ep) {
+    if (charscan::isHorizontalSpace(*p) || *p == '\r') {
+      ++p;
+    } else if (*p == '/' && p + 1 < ep && p[1] == '*') {
+      const char *end = charscan::findBlockCommentEnd(p + 2, ep);
+      if (end == ep) {
+        return p;
+      }
+      p = end + 2;
+    } else if (const char *next = skipLineSplice(p, ep); next != p) {
+      p = next;
+    } else {
+      return p;
+    }
+  }
+  return p;
+}
+
+bool isConditionalDirective(StringRef name) {
+  return StringSwitch<bool>(name)
+      .Cases("if", "ifdef", "ifndef", "elif", "elifdef", "elifndef", true)
+      .Cases("else", "endif", true)
+      .Default(false);
+}
+
+/// the '#' of the next directive line from \p p on, of the next conditional
+/// one with \p conditionalOnly, or \p ep
+const char *scanToDirective(const char *p, const char *ep, bool atLineStart,
+                            bool conditionalOnly) {
+  while (p < ep) {
+    if (atLineStart) {
+      atLineStart = false;
+      p = skipSpaceAndComments(p, ep);
+      if (p < ep && *p == '#') {
+        if (!conditionalOnly) {
+          return p;
+        }
+        const char *name = skipSpaceAndComments(p + 1, ep);
+        const char *end = charscan::skipIdentifier(name, ep);
+        if (isConditionalDirective(StringRef(name, end - name))) {
+          return p;
+        }
+      }
+    }
+    p = charscan::findSkippedSpecial(p, ep);
+    if (p == ep) {
       break;
-    case tok::pp_newline:
+    }
+    switch (*p) {
+    case '\n':
+      ++p;
+      atLineStart = true;
       break;
-    case tok::identifier: {
-      iter.setTokenKind(tok::getKeywordTokenType(iter.getRepresentation()));
-      results.push_back(iter);
+    case '"':
+    case '\'': {
+      /// Inactive text need not be valid C, an apostrophe in prose is
+      /// common. As in gcc, an unclosed literal ends with its line.
+      char quote = *p++;
+      while (p < ep) {
+        p = charscan::findQuoteOrEscape(p, charscan::findLineEnd(p, ep), quote);
+        if (p < ep && *p == '\\') {
+          p = std::min(p + 2, ep);
+          continue;
+        }
+        if (p < ep && *p == quote) {
+          ++p;
+        }
+        break;
+      }
       break;
     }
-    case tok::pp_number: {
-      auto number = ParseNumber(iter);
-      iter.setTokenKind(tok::numeric_constant);
-      iter.setValue(number);
-      results.push_back(iter);
+    case '/':
+      if (p + 1 < ep && p[1] == '*') {
+        const char *end = charscan::findBlockCommentEnd(p + 2, ep);
+        /// an unclosed comment is left to the lexer, which reports it
+        if (end == ep) {
+          return p;
+        }
+        p = end + 2;
+      } else if (p + 1 < ep && p[1] == '/') {
+        /// a line comment ends at the first newline that is not spliced
+        p = charscan::findSplicedLineEnd(p + 2, ep);
+      } else {
+        ++p;
+      }
       break;
-    }
-    case tok::string_literal: {
-      auto chars = ParseCharacters(iter, false);
-      std::string str(chars.begin(), chars.end());
-      iter.setTokenKind(tok::string_literal);
-      iter.setValue(str);
-      results.push_back(iter);
+    default:
+      p = std::max(skipLineSplice(p, ep), p + 1);
       break;
     }
-    case tok::char_constant: {
-      auto chars = ParseCharacters(iter, true);
-      iter.setTokenKind(tok::char_constant);
-      iter.setValue((int32_t)chars[0]);
-      results.push_back(iter);
-      break;
+  }
+  return ep;
+}
+} // namespace
+
+const char *Lexer::SkipConditionalBlock(const char *p) {
+  return scanToDirective(p, Ep, /*atLineStart=*/true, /*conditionalOnly=*/true);
+}
+
+const char *Lexer::SkipToDirective(const char *p, bool atLineStart) {
+  return scanToDirective(p, Ep, atLineStart, /*conditionalOnly=*/false);
+}
+
+void Lexer::ResumeAt(const char *p) {
+  if (mFinished) {
+    return;
+  }
+  P = mSp = p;
+  state = State::Start;
+  mLastKind = tok::pp_newline;
+  mAfterHashInclude = false;
+  mInDirective = false;
+}
+
+const char *Lexer::ScanQuotedBody(const char *p, const char *ep, char quote) {
+  while (true) {
+    p = charscan::findQuoteOrEscape(p, ep, quote);
+    if (p == ep || *p == quote) {
+      return p;
     }
-    default:
-      iter.setValue(tok::getPunctuatorSpelling(iter.getTokenKind()));
-      results.push_back(iter);
+    /// skip the backslash and the escaped character
+    p += 2;
+    if (p >= ep) {
+      return ep;
     }
   }
+}
+
+std::vector<Token> Lexer::toCTokens(std::vector<Token> &&ppTokens) {
+  /// convert in place, C tokens never outnumber pp tokens
+  std::vector<Token> results = MV_(ppTokens);
+  size_t count = 0;
+  for (auto &token : results) {
+    if (ConvertToCToken(token)) {
+      results[count++] = token;
+    }
+  }
+  results.erase(results.begin() + count, results.end());
   results.shrink_to_fit();
   return results;
 }
 
-void Lexer::RegularSourceCode() {
-  /// check BOM header
-  std::string_view UTF8_BOM = "\xef\xbb\xbf";
-  if (mSourceCode.size() >= 3 && mSourceCode.substr(0, 3) == UTF8_BOM) {
-    mSourceCode = mSourceCode.substr(3);
+bool Lexer::ConvertToCToken(Token &token) {
+  switch (token.getTokenKind()) {
+  case tok::pp_hash:
+  case tok::pp_hashhash:
+  case tok::pp_backslash:
+    DiagReport(Diag, SMLoc::getFromPointer(token.getOffset()),
+               diag::err_lex_illegal_token_in_c);
+    return false;
+  case tok::pp_newline:
+    return false;
+  case tok::pp_number: {
+    auto number = ParseNumber(token);
+    token.setTokenKind(tok::numeric_constant);
+    token.setIndex(mLiterals.add(MV_(number)));
+    return true;
   }
-  /// compatible with windows
-  std::string::size_type pos = 0;
-  while ((pos = mSourceCode.find("\r\n", pos)) != mSourceCode.npos) {
-    mSourceCode.erase(pos, 1);
+  case tok::string_literal: {
+    auto chars = ParseCharacters(token, false);
+    std::string str(chars.begin(), chars.end());
+    token.setIndex(mLiterals.add(MV_(str)));
+    return true;
+  }
+  case tok::char_constant: {
+    auto chars = ParseCharacters(token, true);
+    token.setIndex(mLiterals.add((int32_t)chars[0]));
+    return true;
+  }
+  default:
+    return true;
   }
-
-  mSourceCode.shrink_to_fit();
 }
 
 bool Lexer::IsLetter(char ch) {
@@ -794,15 +1457,20 @@ std::uint32_t Lexer::ParseEscapeChar(const char *p, char escape) {
 
 std::vector<char> Lexer::ParseCharacters(const Token &ppToken,
                                          bool handleCharMode) {
-  const auto *sp = ppToken.getOffset();
+  /// skip the opening quote, offsets below are relative to the content
+  const auto *sp = ppToken.getOffset() + 1;
 
-  llvm::StringRef characters = ppToken.getRepresentation();
+  llvm::StringRef characters =
+      ppToken.getRepresentation().drop_front().drop_back();
   std::vector<char> result;
   result.reserve(characters.size());
   size_t offset = 0, resultStart = 0;
   while (offset < characters.size()) {
     char ch = characters[offset];
-    if (ch == '\n') {
+    /// \r\n is reported like \n, at the \r that ends the line
+    bool crlf = ch == '\r' && offset + 1 < characters.size() &&
+                characters[offset + 1] == '\n';
+    if (ch == '\n' || crlf) {
       if (handleCharMode) {
         DiagReport(Diag, SMLoc::getFromPointer(sp + offset),
                    diag::err_lex_implicit_newline_in_char);
@@ -810,7 +1478,7 @@ std::vector<char> Lexer::ParseCharacters(const Token &ppToken,
         DiagReport(Diag, SMLoc::getFromPointer(sp + offset),
                    diag::err_lex_implicit_newline_in_string);
       }
-      offset++;
+      offset += crlf ? 2 : 1;
       continue;
     }
     if (ch != '\\') {
@@ -819,7 +1487,7 @@ std::vector<char> Lexer::ParseCharacters(const Token &ppToken,
       offset++;
       if (handleCharMode) {
         if (resultStart > 1) {
-          DiagReport(Diag, SMLoc::getFromPointer(sp + offset),
+          DiagReport(Diag, SMLoc::getFromPointer(sp + offset - 1),
                      diag::warn_lex_multi_character);
         }
       }
@@ -898,7 +1566,7 @@ std::vector<char> Lexer::ParseCharacters(const Token &ppToken,
   return result;
 }
 
-bool Lexer::IsJudgeNumber(const std::string &preCharacters, char curChar) {
+bool Lexer::IsJudgeNumber(std::string_view preCharacters, char curChar) {
   if (preCharacters.size() == 1 && preCharacters.back() == '0' &&
       (curChar == 'x' || curChar == 'X')) {
     return true;
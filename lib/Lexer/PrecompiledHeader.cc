@@ -0,0 +1,346 @@
+/***********************************
+ * File:     PrecompiledHeader.cc
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/12
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#include "lcc/Lexer/PrecompiledHeader.h"
+#include "lcc/Lexer/Lexer.h"
+#include "lcc/Lexer/Preprocessor.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace lcc {
+
+using namespace llvm;
+
+namespace {
+constexpr char Magic[4] = {'L', 'P', 'C', 'H'};
+
+int64_t getModificationTime(const sys::fs::file_status &status) {
+  return status.getLastModificationTime().time_since_epoch().count();
+}
+
+bool isAdjacent(const Token &lhs, const Token &rhs) {
+  return lhs.getOffset() + lhs.getLength() == rhs.getOffset();
+}
+
+/// appends \p size bytes at an 8 byte boundary, every record type can be
+/// read in place there
+PrecompiledHeader::Section appendSection(std::string &image, const void *data,
+                                         size_t size, size_t count) {
+  image.resize(alignTo(image.size(), alignof(uint64_t)), '\0');
+  assert(image.size() + size <= std::numeric_limits<uint32_t>::max() &&
+         "precompiled header too large");
+  PrecompiledHeader::Section section{uint32_t(image.size()), uint32_t(count)};
+  image.append(static_cast<const char *>(data), size);
+  return section;
+}
+
+template <class T>
+PrecompiledHeader::Section appendSection(std::string &image,
+                                         const std::vector<T> &records) {
+  return appendSection(image, records.data(), records.size() * sizeof(T),
+                       records.size());
+}
+
+template <class T>
+bool getSection(StringRef image, PrecompiledHeader::Section section,
+                ArrayRef<T> &records) {
+  if (section.offset % alignof(T) || section.offset > image.size() ||
+      (image.size() - section.offset) / sizeof(T) < section.count) {
+    return false;
+  }
+  records = ArrayRef<T>(
+      reinterpret_cast<const T *>(image.data() + section.offset),
+      section.count);
+  return true;
+}
+
+bool getBlob(StringRef image, PrecompiledHeader::Section section,
+             StringRef &blob) {
+  ArrayRef<char> bytes;
+  if (!getSection(image, section, bytes)) {
+    return false;
+  }
+  blob = StringRef(bytes.data(), bytes.size());
+  return true;
+}
+} // namespace
+
+bool PrecompiledHeader::write(StringRef path, Preprocessor &pp,
+                              ArrayRef<std::string_view> typedefs,
+                              DiagnosticEngine &diag) {
+  std::string text, strings;
+  std::vector<FileRecord> files;
+  std::vector<StringRecord> identifiers;
+  std::vector<MacroRecord> macros;
+  std::vector<TokenRecord> tokens;
+  std::vector<uint32_t> typedefIds;
+  std::vector<HeaderRecord> headers;
+  StringMap<uint32_t> identifierIndex;
+  auto addString = [&](StringRef string) {
+    StringRecord record{uint32_t(strings.size()), uint32_t(string.size())};
+    strings.append(string.begin(), string.end());
+    return record;
+  };
+  auto addIdentifier = [&](StringRef name) {
+    auto [iter, inserted] =
+        identifierIndex.try_emplace(name, uint32_t(identifiers.size()));
+    if (inserted) {
+      identifiers.push_back(addString(name));
+    }
+    return iter->second;
+  };
+
+  /// the header itself, then what it included
+  std::vector<std::string> paths{
+      pp.Mgr.getBufferName(pp.mMainLexer.getFileID()).str()};
+  for (const auto &file : pp.mIncludedFiles) {
+    paths.push_back(file.path);
+  }
+  for (uint32_t i = 0; i < paths.size(); ++i) {
+    sys::fs::file_status status;
+    auto contents = MemoryBuffer::getFile(paths[i], /*IsText=*/false,
+                                          /*RequiresNullTerminator=*/false);
+    std::error_code ec = contents.getError();
+    if (!ec) {
+      ec = sys::fs::status(paths[i], status);
+    }
+    if (ec) {
+      DiagReport(diag, SourceLocation(), diag::err_pch_cannot_write, path,
+                 paths[i] + ": " + ec.message());
+      return false;
+    }
+    StringRecord name = addString(paths[i]);
+    files.push_back({name.offset, name.length, status.getSize(),
+                     getModificationTime(status),
+                     xxHash64((*contents)->getBuffer())});
+    auto iter = pp.mHeaders.find(status.getUniqueID());
+    if (iter == pp.mHeaders.end()) {
+      continue;
+    }
+    const auto &info = iter->second;
+    uint32_t flags = (info.hasGuard ? uint32_t(HasGuard) : 0u) |
+                     (info.once ? uint32_t(Once) : 0u);
+    if (flags) {
+      headers.push_back(
+          {i,
+           info.hasGuard ? addIdentifier(pp.mIdents.getName(info.guardMacro))
+                         : 0,
+           flags});
+    }
+  }
+
+  /// one `#define` line per macro, the body tokens spelled as written
+  for (uint32_t id = 0; id < pp.mMacros.size(); ++id) {
+    Preprocessor::Macro *macro = pp.mMacros[id].macro;
+    if (!macro || macro->builtin != Preprocessor::Builtin::None) {
+      continue;
+    }
+    if (macro->pchMacro) {
+      pp.LoadMacroBody(*macro);
+    }
+    StringRef name = pp.mIdents.getName(id);
+    ArrayRef<Token> body = macro->body;
+    macros.push_back({addIdentifier(name), uint32_t(tokens.size()),
+                      uint32_t(body.size()), macro->numParams,
+                      (macro->isFunctionLike ? FunctionLike : 0u) |
+                          (macro->isVariadic ? Variadic : 0u)});
+    text += "#define ";
+    text += name;
+    if (macro->isFunctionLike) {
+      /// the parameter names survive only in the body
+      SmallVector<StringRef, 8> params(macro->numParams);
+      for (const Token &token : body) {
+        if (token.getTokenKind() == tok::pp_macro_param) {
+          params[token.getLiteralIndex()] = token.getRepresentation();
+        }
+      }
+      text += '(';
+      for (uint32_t i = 0; i < params.size(); ++i) {
+        bool isVaArgs = macro->isVariadic && i + 1 == params.size();
+        if (i) {
+          text += ", ";
+        }
+        if (!isVaArgs || (!params[i].empty() && params[i] != "__VA_ARGS__")) {
+          text += params[i].empty() ? "__arg" + std::to_string(i)
+                                    : params[i].str();
+        }
+        if (isVaArgs) {
+          text += "...";
+        }
+      }
+      text += ')';
+    }
+    for (size_t j = 0; j < body.size(); ++j) {
+      const Token &token = body[j];
+      if (!j || !isAdjacent(body[j - 1], token)) {
+        text += ' ';
+      }
+      uint32_t index = token.getTokenKind() == tok::identifier
+                           ? addIdentifier(pp.mIdents.getName(
+                                 token.getIdentifierId()))
+                           : token.getLiteralIndex();
+      tokens.push_back({uint32_t(text.size()), token.getLength(),
+                        uint32_t(token.getTokenKind()), index});
+      text += token.getRepresentation();
+    }
+    text += '\n';
+  }
+
+  for (std::string_view name : typedefs) {
+    typedefIds.push_back(addIdentifier(StringRef(name.data(), name.size())));
+  }
+
+  ImageHeader header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  std::string image(sizeof(ImageHeader), '\0');
+  header.text = appendSection(image, text.data(), text.size(), text.size());
+  header.strings =
+      appendSection(image, strings.data(), strings.size(), strings.size());
+  header.files = appendSection(image, files);
+  header.identifiers = appendSection(image, identifiers);
+  header.macros = appendSection(image, macros);
+  header.tokens = appendSection(image, tokens);
+  header.typedefs = appendSection(image, typedefIds);
+  header.headers = appendSection(image, headers);
+  std::memcpy(image.data(), &header, sizeof(header));
+
+  std::error_code ec;
+  raw_fd_ostream os(path, ec, sys::fs::OF_None);
+  if (!ec) {
+    os << image;
+    os.close();
+    ec = os.error();
+    os.clear_error();
+  }
+  if (ec) {
+    DiagReport(diag, SourceLocation(), diag::err_pch_cannot_write, path,
+               ec.message());
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<PrecompiledHeader>
+PrecompiledHeader::load(StringRef path, SourceManager &mgr,
+                        IdentifierTable &idents, DiagnosticEngine &diag) {
+  auto buffer = mgr.getBinaryFile(path);
+  if (!buffer) {
+    DiagReport(diag, SourceLocation(), diag::err_pch_cannot_open, path,
+               buffer.getError().message());
+    return nullptr;
+  }
+  StringRef image = (*buffer)->getBuffer();
+  std::unique_ptr<PrecompiledHeader> pch(new PrecompiledHeader(idents));
+  ImageHeader header;
+  bool valid = image.size() >= sizeof(header);
+  if (valid) {
+    std::memcpy(&header, image.data(), sizeof(header));
+    valid = !std::memcmp(header.magic, Magic, sizeof(Magic)) &&
+            header.version == Version &&
+            getBlob(image, header.text, pch->mText) &&
+            getBlob(image, header.strings, pch->mStrings) &&
+            getSection(image, header.files, pch->mFiles) &&
+            getSection(image, header.identifiers, pch->mIdentifiers) &&
+            getSection(image, header.macros, pch->mMacros) &&
+            getSection(image, header.tokens, pch->mTokens) &&
+            getSection(image, header.typedefs, pch->mTypedefs) &&
+            getSection(image, header.headers, pch->mHeaders);
+  }
+  /// the records are read in place from here on, indices out of their
+  /// sections would read past them
+  size_t numIdentifiers = pch->mIdentifiers.size();
+  for (size_t i = 0; valid && i < pch->mMacros.size(); ++i) {
+    const MacroRecord &macro = pch->mMacros[i];
+    valid = macro.name < numIdentifiers &&
+            macro.firstToken <= pch->mTokens.size() &&
+            macro.numTokens <= pch->mTokens.size() - macro.firstToken;
+  }
+  for (size_t i = 0; valid && i < pch->mHeaders.size(); ++i) {
+    const HeaderRecord &record = pch->mHeaders[i];
+    valid = record.file < pch->mFiles.size() &&
+            (!(record.flags & HasGuard) || record.guardMacro < numIdentifiers);
+  }
+  for (size_t i = 0; valid && i < pch->mTypedefs.size(); ++i) {
+    valid = pch->mTypedefs[i] < numIdentifiers;
+  }
+  if (!valid) {
+    DiagReport(diag, SourceLocation(), diag::err_pch_invalid, path);
+    return nullptr;
+  }
+
+  /// size and time decide, the contents are only hashed for a file that
+  /// was touched without being changed
+  pch->mFileIDs.reserve(pch->mFiles.size());
+  for (uint32_t i = 0; i < pch->mFiles.size(); ++i) {
+    const FileRecord &record = pch->mFiles[i];
+    StringRef file = pch->getFilePath(i);
+    sys::fs::file_status status;
+    bool same = !sys::fs::status(file, status) &&
+                status.getSize() == record.size;
+    if (same && getModificationTime(status) != record.modificationTime) {
+      auto contents = MemoryBuffer::getFile(file, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+      same = contents && xxHash64((*contents)->getBuffer()) == record.hash;
+    }
+    if (!same) {
+      DiagReport(diag, SourceLocation(), diag::err_pch_file_changed, path,
+                 file);
+      return nullptr;
+    }
+    pch->mFileIDs.push_back(status.getUniqueID());
+  }
+
+  if (!pch->mText.empty()) {
+    mgr.createFileID(MemoryBuffer::getMemBuffer(
+        pch->mText, path, /*RequiresNullTerminator=*/false));
+  }
+  pch->mIdentifierIds.assign(numIdentifiers, NoId);
+  return pch;
+}
+
+uint32_t PrecompiledHeader::getIdentifierId(uint32_t index) {
+  uint32_t &id = mIdentifierIds[index];
+  if (id == NoId) {
+    id = mIdents.get(getIdentifier(index));
+  }
+  return id;
+}
+
+void PrecompiledHeader::readMacroBody(const MacroRecord &macro, Token *out) {
+  for (uint32_t i = 0; i < macro.numTokens; ++i) {
+    const TokenRecord &record = mTokens[macro.firstToken + i];
+    assert(record.offset + record.length <= mText.size());
+    auto kind = static_cast<tok::TokenKind>(record.kind);
+    uint32_t index =
+        kind == tok::identifier ? getIdentifierId(record.index) : record.index;
+    new (out + i) Token(kind, mText.data() + record.offset, record.length,
+                        index);
+  }
+}
+
+std::vector<std::string_view> PrecompiledHeader::getTypedefs() const {
+  std::vector<std::string_view> names;
+  names.reserve(mTypedefs.size());
+  for (uint32_t index : mTypedefs) {
+    StringRef name = getIdentifier(index);
+    names.emplace_back(name.data(), name.size());
+  }
+  return names;
+}
+} // namespace lcc
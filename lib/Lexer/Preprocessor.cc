@@ -0,0 +1,1792 @@
+/***********************************
+ * File:     Preprocessor.cc
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/8
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#include "lcc/Lexer/Preprocessor.h"
+#include "lcc/Basic/Match.h"
+#include "lcc/Basic/Util.h"
+#include "lcc/Lexer/Lexer.h"
+#include "lcc/Lexer/PrecompiledHeader.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+namespace lcc {
+
+using namespace llvm;
+
+bool HideSetTable::contains(uint32_t set, uint32_t macro) const {
+  const Set &s = mSets[set];
+  uint32_t word = macro / 64;
+  if (word < s.firstWord || word - s.firstWord >= s.words.size()) {
+    return false;
+  }
+  return s.words[word - s.firstWord] >> (macro % 64) & 1;
+}
+
+uint32_t HideSetTable::add(uint32_t set, uint32_t macro) {
+  auto [iter, inserted] =
+      mAddCache.try_emplace(uint64_t(set) << 32 | macro, Empty);
+  if (!inserted) {
+    return iter->second;
+  }
+  const Set &s = mSets[set];
+  uint32_t word = macro / 64;
+  uint32_t first = word, last = word;
+  if (!s.words.empty()) {
+    first = std::min(first, s.firstWord);
+    last = std::max<uint32_t>(last, s.firstWord + s.words.size() - 1);
+  }
+  mWords.assign(last - first + 1, 0);
+  std::copy(s.words.begin(), s.words.end(),
+            mWords.begin() + (s.firstWord - first));
+  mWords[word - first] |= uint64_t(1) << (macro % 64);
+  /// Intern leaves the caches alone, iter stays valid
+  iter->second = Intern(first);
+  return iter->second;
+}
+
+uint32_t HideSetTable::unite(uint32_t a, uint32_t b) {
+  if (a == b || b == Empty) {
+    return a;
+  }
+  if (a == Empty) {
+    return b;
+  }
+  auto [iter, inserted] = mUniteCache.try_emplace(
+      uint64_t(std::min(a, b)) << 32 | std::max(a, b), Empty);
+  if (!inserted) {
+    return iter->second;
+  }
+  const Set &sa = mSets[a], &sb = mSets[b];
+  uint32_t first = std::min(sa.firstWord, sb.firstWord);
+  uint32_t end = std::max<uint32_t>(sa.firstWord + sa.words.size(),
+                                    sb.firstWord + sb.words.size());
+  mWords.assign(end - first, 0);
+  for (const Set *s : {&sa, &sb}) {
+    for (size_t i = 0; i < s->words.size(); ++i) {
+      mWords[s->firstWord - first + i] |= s->words[i];
+    }
+  }
+  iter->second = Intern(first);
+  return iter->second;
+}
+
+uint32_t HideSetTable::intersect(uint32_t a, uint32_t b) {
+  if (a == b) {
+    return a;
+  }
+  if (a == Empty || b == Empty) {
+    return Empty;
+  }
+  auto [iter, inserted] = mIntersectCache.try_emplace(
+      uint64_t(std::min(a, b)) << 32 | std::max(a, b), Empty);
+  if (!inserted) {
+    return iter->second;
+  }
+  const Set &sa = mSets[a], &sb = mSets[b];
+  uint32_t first = std::max(sa.firstWord, sb.firstWord);
+  uint32_t end = std::min<uint32_t>(sa.firstWord + sa.words.size(),
+                                    sb.firstWord + sb.words.size());
+  if (first >= end) {
+    return Empty;
+  }
+  mWords.assign(end - first, 0);
+  for (uint32_t word = first; word < end; ++word) {
+    mWords[word - first] = sa.words[word - sa.firstWord] &
+                           sb.words[word - sb.firstWord];
+  }
+  iter->second = Intern(first);
+  return iter->second;
+}
+
+uint32_t HideSetTable::Intern(uint32_t firstWord) {
+  size_t begin = 0, end = mWords.size();
+  while (begin != end && !mWords[begin]) {
+    ++begin;
+  }
+  while (end != begin && !mWords[end - 1]) {
+    --end;
+  }
+  if (begin == end) {
+    return Empty;
+  }
+  firstWord += begin;
+  ArrayRef<uint64_t> words(mWords.data() + begin, end - begin);
+  SmallString<64> key;
+  key.append(StringRef(reinterpret_cast<const char *>(&firstWord),
+                       sizeof(firstWord)));
+  key.append(reinterpret_cast<const char *>(words.data()),
+             reinterpret_cast<const char *>(words.data() + words.size()));
+  auto [iter, inserted] = mIds.try_emplace(key, mSets.size());
+  if (inserted) {
+    uint64_t *stored = mArena.Allocate<uint64_t>(words.size());
+    std::copy(words.begin(), words.end(), stored);
+    mSets.push_back({firstWord, {stored, words.size()}});
+  }
+  return iter->second;
+}
+
+StringRef ScratchBuffer::copy(StringRef text) {
+  constexpr size_t ChunkSize = 64 * 1024;
+  size_t size = text.size() + 1;
+  if (size > static_cast<size_t>(mEnd - mCur)) {
+    /// zero filled, so the line table built on loading has a single line;
+    /// the lines are added as the copies come in
+    auto buffer = WritableMemoryBuffer::getNewMemBuffer(
+        std::max(size, ChunkSize), "<scratch space>");
+    mCur = buffer->getBufferStart();
+    mEnd = buffer->getBufferEnd();
+    mStart = mCur;
+    mFileID = mMgr.createFileID(std::move(buffer));
+  }
+  char *begin = mCur;
+  std::memcpy(begin, text.data(), text.size());
+  begin[text.size()] = '\n';
+  mCur += size;
+  if (mCur != mEnd) {
+    mMgr.addLineStart(mFileID, mCur - mStart);
+  }
+  return {begin, text.size()};
+}
+
+namespace {
+/// index of a ## in a macro body that is the paste operator, a ## that came
+/// in through an argument is an ordinary token
+constexpr uint32_t PasteOperator = 1;
+
+/// pp tokens pulled from a lexer at a time
+constexpr size_t FileBatch = 256;
+
+constexpr const char Predefines[] = "#define __STDC__ 1\n"
+                                    "#define __STDC_VERSION__ 201710L\n"
+                                    "#define __STDC_HOSTED__ 1\n"
+                                    "#define __lcc__ 1\n";
+
+bool isPasteOperator(const Token &token) {
+  return token.getTokenKind() == tok::pp_hashhash &&
+         token.getLiteralIndex() == PasteOperator;
+}
+
+bool isIdentifierOrKeyword(const Token &token) {
+  return token.getTokenKind() == tok::identifier ||
+         tok::getKeywordSpelling(token.getTokenKind());
+}
+
+/// the two tokens were written next to each other
+bool isAdjacent(const Token &lhs, const Token &rhs) {
+  return lhs.getOffset() + lhs.getLength() == rhs.getOffset();
+}
+
+void appendEscaped(SmallVectorImpl<char> &out, StringRef text) {
+  for (char ch : text) {
+    if (ch == '"' || ch == '\\') {
+      out.push_back('\\');
+    }
+    out.push_back(ch);
+  }
+}
+} // namespace
+
+Preprocessor::Preprocessor(Lexer &lexer, DiagnosticEngine &diag,
+                           IdentifierTable &idents, unsigned lexThreads)
+    : mMainLexer(lexer), Mgr(lexer.Mgr), Diag(diag), mIdents(idents),
+      mScratch(Mgr), mZero(tok::pp_number, nullptr, 0),
+      mOne(tok::pp_number, nullptr, 0) {
+  mOwnFileMgr = std::make_unique<FileManager>();
+  mFileMgr = mOwnFileMgr.get();
+  lexer.mResolveEmbed = false;
+  lexer.mStopAfterDirective = true;
+  mDefinedId = mIdents.get("defined");
+  mVaArgsId = mIdents.get("__VA_ARGS__");
+  mZero = Token(tok::pp_number, mScratch.copy("0").data(), 1);
+  mOne = Token(tok::pp_number, mScratch.copy("1").data(), 1);
+
+  std::time_t now = std::time(nullptr);
+  char text[32];
+  std::strftime(text, sizeof(text), "\"%b %e %Y\"", std::localtime(&now));
+  mDate = text;
+  std::strftime(text, sizeof(text), "\"%H:%M:%S\"", std::localtime(&now));
+  mTime = text;
+  DefineBuiltin("__FILE__", Builtin::File);
+  DefineBuiltin("__LINE__", Builtin::Line);
+  DefineBuiltin("__COUNTER__", Builtin::Counter);
+  DefineBuiltin("__DATE__", Builtin::Date);
+  DefineBuiltin("__TIME__", Builtin::Time);
+
+  FileState main{&lexer};
+  if (lexThreads > 1) {
+    main.batch = lexer.tokenize(lexThreads);
+  }
+  mFiles.push_back(std::move(main));
+  /// the predefined macros are read first, like an include at the top of
+  /// the main file
+  EnterFile(std::make_unique<Lexer>(
+      Mgr, Diag, mIdents,
+      MemoryBuffer::getMemBuffer(StringRef(Predefines, sizeof(Predefines) - 1),
+                                 "<built-in>")));
+}
+
+Preprocessor::~Preprocessor() = default;
+
+const char *Preprocessor::getBufferEnd() const {
+  return mMainLexer.getBufferEnd();
+}
+
+void Preprocessor::EnterFile(std::unique_ptr<Lexer> lexer) {
+  lexer->mResolveEmbed = false;
+  lexer->mStopAfterDirective = true;
+  FileState file{lexer.get(), std::move(lexer)};
+  file.conditionalDepth = mConditionals.size();
+  mFiles.push_back(std::move(file));
+}
+
+void Preprocessor::markMainFileAsHeader() {
+  const FileEntry *file =
+      mFileMgr->getFile(Mgr.getBufferName(mMainLexer.getFileID()));
+  if (!file) {
+    return;
+  }
+  mFiles.front().isHeader = true;
+  mFiles.front().uniqueID = file->getUniqueID();
+  mHeaders.try_emplace(file->getUniqueID());
+}
+
+void Preprocessor::includePCH(PrecompiledHeader &pch) {
+  /// nothing was read yet, the predefines are still on top of the main file
+  LCC_ASSERT(mFiles.size() == 2 && !mPCH);
+  mFiles.pop_back();
+  mPCH = &pch;
+  ArrayRef<PrecompiledHeader::MacroRecord> records = pch.getMacros();
+  for (size_t i = 0; i < records.size(); ++i) {
+    const auto &record = records[i];
+    MacroSlot &slot = GetMacroSlot(pch.getIdentifierId(record.name));
+    if (!slot.hasId) {
+      slot.hasId = true;
+      slot.id = mNumMacroIds++;
+    }
+    auto *macro = new (mArena.Allocate<Macro>()) Macro{};
+    macro->id = slot.id;
+    macro->numParams = record.numParams;
+    macro->isFunctionLike = record.flags & PrecompiledHeader::FunctionLike;
+    macro->isVariadic = record.flags & PrecompiledHeader::Variadic;
+    macro->pchMacro = i + 1;
+    if (!slot.macro && tok::getKeywordTokenType(pch.getIdentifier(
+                           record.name)) != tok::identifier) {
+      ++mNumKeywordMacros;
+    }
+    slot.macro = macro;
+  }
+  for (const auto &record : pch.getHeaders()) {
+    HeaderInfo &info = mHeaders[pch.getFileUniqueID(record.file)];
+    info.once = record.flags & PrecompiledHeader::Once;
+    info.hasGuard = record.flags & PrecompiledHeader::HasGuard;
+    if (info.hasGuard) {
+      info.guardMacro = pch.getIdentifierId(record.guardMacro);
+    }
+  }
+}
+
+void Preprocessor::LoadMacroBody(Macro &macro) {
+  const auto &record = mPCH->getMacros()[macro.pchMacro - 1];
+  Token *body = mArena.Allocate<Token>(record.numTokens);
+  mPCH->readMacroBody(record, body);
+  macro.body = ArrayRef<Token>(body, record.numTokens);
+  macro.pchMacro = 0;
+}
+
+void Preprocessor::DefineBuiltin(StringRef name, Builtin builtin) {
+  auto *macro = new (mArena.Allocate<Macro>()) Macro{};
+  macro->builtin = builtin;
+  MacroSlot &slot = GetMacroSlot(mIdents.get(name));
+  slot.macro = macro;
+  slot.hasId = true;
+  slot.id = macro->id = mNumMacroIds++;
+}
+
+bool Preprocessor::lex(Token &token) {
+  unsigned errors = Diag.numErrors();
+  PPToken result{Token(tok::eof, nullptr, 0)};
+  bool found = Expand(0, result);
+  mNumErrors += Diag.numErrors() - errors;
+  if (found) {
+    token = result.token;
+  }
+  return found;
+}
+
+bool Preprocessor::lexCToken(Token &token) {
+  while (lex(token)) {
+    unsigned errors = Diag.numErrors();
+    bool keep = mMainLexer.ConvertToCToken(token);
+    mNumErrors += Diag.numErrors() - errors;
+    /// After an error the parser gets no more tokens, like from
+    /// Lexer::lexCToken, but the rest of the input is still preprocessed
+    /// for its own errors
+    if (mNumErrors) {
+      while (lex(token)) {
+        errors = Diag.numErrors();
+        mMainLexer.ConvertToCToken(token);
+        mNumErrors += Diag.numErrors() - errors;
+      }
+      Diag.suppressAllDiagnostics();
+      return false;
+    }
+    if (keep) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<Token>
+Preprocessor::preprocess(std::vector<const char *> *positions) {
+  std::vector<Token> results;
+  Token token(tok::eof, nullptr, 0);
+  while (lex(token)) {
+    results.push_back(token);
+    if (positions) {
+      positions->push_back(mExpansionPos);
+    }
+  }
+  return results;
+}
+
+void Preprocessor::scanDirectives() {
+  mDirectivesOnly = true;
+  PPToken token{Token(tok::eof, nullptr, 0)};
+  while (ReadFileToken(token)) {
+  }
+}
+
+std::vector<Token> Preprocessor::lexCTokens() {
+  std::vector<Token> results;
+  Token token(tok::eof, nullptr, 0);
+  while (lexCToken(token)) {
+    results.push_back(token);
+  }
+  return results;
+}
+
+bool Preprocessor::NextFileToken(FileState &file, Token &token) {
+  while (true) {
+    if (file.pos == file.batch.size()) {
+      file.batch.clear();
+      file.pos = 0;
+      file.lexer->LexInto(file.batch, false, FileBatch);
+      if (file.batch.empty()) {
+        return false;
+      }
+    }
+    token = file.batch[file.pos++];
+    if (token.getTokenKind() == tok::pp_backslash) {
+      /// a backslash newline splices the lines
+      if (file.pos == file.batch.size()) {
+        file.lexer->LexInto(file.batch, false, file.batch.size() + 1);
+      }
+      if (file.pos < file.batch.size() &&
+          file.batch[file.pos].getTokenKind() == tok::pp_newline) {
+        ++file.pos;
+        continue;
+      }
+    }
+    return true;
+  }
+}
+
+bool Preprocessor::NextRawToken(Token &token, bool &atLineStart) {
+  while (!mFiles.empty()) {
+    FileState &file = mFiles.back();
+    if (!NextFileToken(file, token)) {
+      LeaveFile();
+      continue;
+    }
+    if (token.getTokenKind() == tok::pp_newline) {
+      file.atLineStart = true;
+      continue;
+    }
+    atLineStart = file.atLineStart;
+    file.atLineStart = false;
+    return true;
+  }
+  return false;
+}
+
+void Preprocessor::LeaveFile() {
+  FileState &file = mFiles.back();
+  while (mConditionals.size() > file.conditionalDepth) {
+    DiagReport(Diag, SMLoc::getFromPointer(mConditionals.back().loc),
+               diag::err_pp_unterminated_conditional);
+    mConditionals.pop_back();
+    file.guardClosed = false;
+  }
+  /// the whole file was one #ifndef group, later includes need not look
+  /// at it while the macro is defined
+  if (file.isHeader && file.guardMacro && file.guardClosed &&
+      !file.outsideGuard) {
+    HeaderInfo &info = mHeaders[file.uniqueID];
+    info.guardMacro = *file.guardMacro;
+    info.hasGuard = true;
+  }
+  mFiles.pop_back();
+}
+
+void Preprocessor::ReadLine() {
+  mLine.clear();
+  FileState &file = mFiles.back();
+  Token token(tok::eof, nullptr, 0);
+  while (NextFileToken(file, token)) {
+    if (token.getTokenKind() == tok::pp_newline) {
+      file.atLineStart = true;
+      break;
+    }
+    mLine.push_back(token);
+  }
+}
+
+void Preprocessor::SkipInactive(bool anyDirective, const char *midLine) {
+  auto start = std::chrono::steady_clock::now();
+  FileState &file = mFiles.back();
+  Lexer &lexer = *file.lexer;
+  /// the directive line was the last one lexed, unless the whole file was
+  /// lexed up front
+  bool inBatch = file.pos < file.batch.size();
+  const char *from = midLine      ? midLine
+                     : inBatch    ? file.batch[file.pos].getOffset()
+                                  : lexer.P;
+  const char *stop = anyDirective ? lexer.SkipToDirective(from, !midLine)
+                                  : lexer.SkipConditionalBlock(from);
+  if (inBatch && stop <= file.batch.back().getOffset()) {
+    file.pos = std::lower_bound(file.batch.begin() + file.pos,
+                                file.batch.end(), stop,
+                                [](const Token &token, const char *p) {
+                                  return token.getOffset() < p;
+                                }) -
+               file.batch.begin();
+  } else {
+    file.batch.clear();
+    file.pos = 0;
+    lexer.ResumeAt(stop);
+  }
+  file.atLineStart = true;
+  mSkippedBytes += stop - from;
+  mSkipTime += std::chrono::steady_clock::now() - start;
+}
+
+bool Preprocessor::ReadFileToken(PPToken &token) {
+  if (mLookahead) {
+    token = *mLookahead;
+    mLookahead.reset();
+    return true;
+  }
+  while (true) {
+    if (mDirectiveOutputPos < mDirectiveOutput.size()) {
+      token = {mDirectiveOutput[mDirectiveOutputPos++]};
+      return true;
+    }
+    /// a line of a scan is only lexed if it is a directive
+    if (mDirectivesOnly && !mFiles.empty() && mFiles.back().atLineStart &&
+        !IsSkipping()) {
+      SkipInactive(true);
+    }
+    Token raw(tok::eof, nullptr, 0);
+    bool atLineStart = false;
+    if (!NextRawToken(raw, atLineStart)) {
+      return false;
+    }
+    if (atLineStart && raw.getTokenKind() == tok::pp_hash) {
+      HandleDirective(raw);
+      if (IsSkipping()) {
+        SkipInactive();
+      }
+      continue;
+    }
+    if (IsSkipping()) {
+      continue;
+    }
+    FileState &file = mFiles.back();
+    if (mConditionals.size() == file.conditionalDepth) {
+      file.outsideGuard = true;
+    }
+    if (mDirectivesOnly) {
+      SkipInactive(true, raw.getOffset() + raw.getLength());
+      continue;
+    }
+    mLastFilePos = raw.getOffset();
+    token = {raw};
+    return true;
+  }
+}
+
+Preprocessor::Level &Preprocessor::GetLevel(unsigned depth) {
+  while (depth >= mLevels.size()) {
+    mLevels.push_back(std::make_unique<Level>());
+  }
+  return *mLevels[depth];
+}
+
+bool Preprocessor::NextToken(unsigned depth, PPToken &token) {
+  Level &level = GetLevel(depth);
+  if (!level.pending.empty()) {
+    token = level.pending.back();
+    level.pending.pop_back();
+    return true;
+  }
+  return depth == 0 && ReadFileToken(token);
+}
+
+const Preprocessor::PPToken *Preprocessor::PeekToken(unsigned depth) {
+  Level &level = GetLevel(depth);
+  if (!level.pending.empty()) {
+    return &level.pending.back();
+  }
+  if (depth != 0) {
+    return nullptr;
+  }
+  if (!mLookahead) {
+    PPToken token{Token(tok::eof, nullptr, 0)};
+    if (!ReadFileToken(token)) {
+      return nullptr;
+    }
+    mLookahead = token;
+  }
+  return &*mLookahead;
+}
+
+uint32_t Preprocessor::IdentifierIdOf(const Token &token) {
+  if (token.getTokenKind() == tok::identifier) {
+    return token.getIdentifierId();
+  }
+  return mIdents.get(token.getRepresentation());
+}
+
+Preprocessor::MacroSlot &Preprocessor::GetMacroSlot(uint32_t id) {
+  if (id >= mMacros.size()) {
+    mMacros.resize(id + 1);
+  }
+  return mMacros[id];
+}
+
+Preprocessor::Macro *Preprocessor::LookupMacro(const Token &token) {
+  uint32_t id;
+  if (token.getTokenKind() == tok::identifier) {
+    id = token.getIdentifierId();
+  } else if (mNumKeywordMacros && isIdentifierOrKeyword(token)) {
+    id = mIdents.get(token.getRepresentation());
+  } else {
+    return nullptr;
+  }
+  return id < mMacros.size() ? mMacros[id].macro : nullptr;
+}
+
+bool Preprocessor::Expand(unsigned depth, PPToken &token) {
+  while (true) {
+    bool fromFile = depth == 0 && GetLevel(0).pending.empty();
+    if (!NextToken(depth, token)) {
+      break;
+    }
+    if (fromFile) {
+      mExpansionPos = token.token.getOffset();
+    }
+    Macro *macro = LookupMacro(token.token);
+    if (!macro || mHideSets.contains(token.hideSet, macro->id)) {
+      return true;
+    }
+    if (macro->builtin != Builtin::None) {
+      token.token = ExpandBuiltin(macro->builtin, token.token);
+      return true;
+    }
+    if (macro->pchMacro) {
+      LoadMacroBody(*macro);
+    }
+    if (!macro->isFunctionLike) {
+      Substitute(depth, *macro, mHideSets.add(token.hideSet, macro->id));
+      continue;
+    }
+    /// a function-like macro name without arguments is an identifier
+    const PPToken *next = PeekToken(depth);
+    if (!next || next->token.getTokenKind() != tok::l_paren) {
+      return true;
+    }
+    PPToken name = token;
+    NextToken(depth, token);
+    PPToken rParen = token;
+    if (!CollectArguments(depth, name.token, *macro, rParen)) {
+      continue;
+    }
+    Substitute(depth, *macro,
+               mHideSets.add(mHideSets.intersect(name.hideSet, rParen.hideSet),
+                             macro->id));
+  }
+  return false;
+}
+
+void Preprocessor::ExpandList(ArrayRef<PPToken> tokens, unsigned depth,
+                              std::vector<PPToken> &out) {
+  Level &level = GetLevel(depth);
+  LCC_ASSERT(level.pending.empty());
+  level.pending.assign(tokens.rbegin(), tokens.rend());
+  PPToken token{Token(tok::eof, nullptr, 0)};
+  while (Expand(depth, token)) {
+    out.push_back(token);
+  }
+}
+
+bool Preprocessor::CollectArguments(unsigned depth, const Token &name,
+                                    const Macro &macro, PPToken &rParen) {
+  Level &level = GetLevel(depth);
+  level.args.clear();
+  level.argBounds.assign(1, 0);
+  unsigned parens = 0;
+  PPToken token{Token(tok::eof, nullptr, 0)};
+  while (true) {
+    if (!NextToken(depth, token)) {
+      DiagReport(Diag, name.getSMLoc(), diag::err_pp_unterminated_macro_call,
+                 name.getRepresentation());
+      return false;
+    }
+    auto kind = token.token.getTokenKind();
+    if (kind == tok::l_paren) {
+      ++parens;
+    } else if (kind == tok::r_paren) {
+      if (!parens) {
+        rParen = token;
+        break;
+      }
+      --parens;
+    } else if (kind == tok::comma && !parens &&
+               !(macro.isVariadic &&
+                 level.argBounds.size() == macro.numParams)) {
+      /// the commas of the variable arguments stay in __VA_ARGS__
+      level.argBounds.push_back(level.args.size());
+      continue;
+    }
+    level.args.push_back(token);
+  }
+  level.argBounds.push_back(level.args.size());
+  uint32_t numArgs = level.argBounds.size() - 1;
+  if (macro.numParams == 0 && numArgs == 1 && level.args.empty()) {
+    /// f() passes no argument rather than an empty one
+    level.argBounds.pop_back();
+    numArgs = 0;
+  } else if (macro.isVariadic && numArgs + 1 == macro.numParams) {
+    /// the variable arguments may be left out entirely
+    level.argBounds.push_back(level.args.size());
+    ++numArgs;
+  }
+  if (numArgs != macro.numParams) {
+    DiagReport(Diag, name.getSMLoc(), diag::err_pp_macro_arg_count,
+               name.getRepresentation(), macro.numParams, numArgs);
+    return false;
+  }
+  level.expanded.clear();
+  level.expandedBounds.assign(numArgs, {std::numeric_limits<uint32_t>::max(),
+                                        std::numeric_limits<uint32_t>::max()});
+  return true;
+}
+
+ArrayRef<Preprocessor::PPToken>
+Preprocessor::ExpandedArgument(unsigned depth, uint32_t index) {
+  Level &level = GetLevel(depth);
+  auto &bounds = level.expandedBounds[index];
+  if (bounds.first == std::numeric_limits<uint32_t>::max()) {
+    uint32_t begin = level.expanded.size();
+    /// an argument is expanded on its own, as if it was the rest of the file
+    ExpandList(ArrayRef<PPToken>(level.args)
+                   .slice(level.argBounds[index],
+                          level.argBounds[index + 1] - level.argBounds[index]),
+               depth + 1, level.expanded);
+    bounds = {begin, level.expanded.size()};
+  }
+  return ArrayRef<PPToken>(level.expanded)
+      .slice(bounds.first, bounds.second - bounds.first);
+}
+
+void Preprocessor::Substitute(unsigned depth, const Macro &macro,
+                              uint32_t hideSet) {
+  Level &level = GetLevel(depth);
+  auto &out = level.result;
+  out.clear();
+  auto rawArgument = [&](uint32_t index) {
+    return ArrayRef<PPToken>(level.args)
+        .slice(level.argBounds[index],
+               level.argBounds[index + 1] - level.argBounds[index]);
+  };
+  ArrayRef<Token> body = macro.body;
+  /// a ## is pending, and the left operand of it was empty (a placemarker)
+  bool paste = false, lastEmpty = false;
+  PPToken single{Token(tok::eof, nullptr, 0)};
+  for (size_t i = 0; i < body.size(); ++i) {
+    const Token &token = body[i];
+    if (isPasteOperator(token)) {
+      paste = true;
+      continue;
+    }
+    ArrayRef<PPToken> operand;
+    uint32_t param = std::numeric_limits<uint32_t>::max();
+    if (macro.isFunctionLike && token.getTokenKind() == tok::pp_hash) {
+      single = {Stringify(rawArgument(body[++i].getLiteralIndex()), token)};
+      operand = single;
+    } else if (token.getTokenKind() == tok::pp_macro_param) {
+      param = token.getLiteralIndex();
+      /// operands of ## are not macro expanded
+      bool pasted = paste || (i + 1 < body.size() && isPasteOperator(body[i + 1]));
+      operand = pasted ? rawArgument(param) : ExpandedArgument(depth, param);
+    } else {
+      single = {token};
+      operand = single;
+    }
+    if (!paste) {
+      out.insert(out.end(), operand.begin(), operand.end());
+      lastEmpty = operand.empty();
+      continue;
+    }
+    paste = false;
+    /// GNU `, ## __VA_ARGS__`: the comma goes away without variable
+    /// arguments and nothing is pasted with them
+    bool gnuComma = macro.isVariadic && param + 1 == macro.numParams &&
+                    i >= 2 && body[i - 2].getTokenKind() == tok::comma &&
+                    !lastEmpty;
+    if (gnuComma) {
+      if (operand.empty()) {
+        out.pop_back();
+      }
+      out.insert(out.end(), operand.begin(), operand.end());
+      continue;
+    }
+    if (operand.empty()) {
+      continue;
+    }
+    if (lastEmpty || out.empty()) {
+      out.insert(out.end(), operand.begin(), operand.end());
+      lastEmpty = false;
+      continue;
+    }
+    Token pasted = out.back().token;
+    if (Paste(out.back().token, operand.front().token, pasted)) {
+      out.back().token = pasted;
+      operand = operand.drop_front();
+    }
+    out.insert(out.end(), operand.begin(), operand.end());
+  }
+  for (auto &token : out) {
+    token.hideSet = mHideSets.unite(token.hideSet, hideSet);
+  }
+  level.pending.insert(level.pending.end(), out.rbegin(), out.rend());
+}
+
+Token Preprocessor::Stringify(ArrayRef<PPToken> tokens, const Token &hash) {
+  SmallString<128> text("\"");
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    const Token &token = tokens[i].token;
+    /// any white space between two tokens becomes one space
+    if (i && !isAdjacent(tokens[i - 1].token, token)) {
+      text.push_back(' ');
+    }
+    if (token.getTokenKind() == tok::string_literal ||
+        token.getTokenKind() == tok::char_constant) {
+      appendEscaped(text, token.getRepresentation());
+    } else {
+      text.append(token.getRepresentation());
+    }
+  }
+  text.push_back('"');
+  if (text.size() > Token::MaxLength) {
+    DiagReport(Diag, hash.getSMLoc(), diag::err_lex_token_too_long,
+               Token::MaxLength);
+    text.resize(Token::MaxLength - 1);
+    text.push_back('"');
+  }
+  StringRef spelling = mScratch.copy(text);
+  return Token(tok::string_literal, spelling.data(), spelling.size());
+}
+
+bool Preprocessor::Paste(const Token &lhs, const Token &rhs, Token &result) {
+  SmallString<64> text(lhs.getRepresentation());
+  text.append(rhs.getRepresentation());
+  if (LexSpelling(text, result)) {
+    return true;
+  }
+  DiagReport(Diag, lhs.getSMLoc(), diag::err_pp_invalid_paste, text);
+  return false;
+}
+
+bool Preprocessor::LexSpelling(StringRef spelling, Token &token) {
+  StringRef copy = mScratch.copy(spelling);
+  FileID fileID = Mgr.getFileID(Mgr.getLocation(copy.data()));
+  /// the copy is followed by a newline, so a number or identifier at its
+  /// end is finished without reaching the end of the chunk
+  Lexer lexer(Mgr, Diag, mIdents, fileID, copy.begin(), copy.end() + 1);
+  lexer.mResolveEmbed = false;
+  mSpellingTokens.clear();
+  lexer.LexInto(mSpellingTokens, false, 3);
+  if (lexer.mSpilled || mSpellingTokens.size() != 2 ||
+      mSpellingTokens[1].getTokenKind() != tok::pp_newline ||
+      mSpellingTokens[0].getLength() != copy.size()) {
+    return false;
+  }
+  token = mSpellingTokens[0];
+  return true;
+}
+
+Token Preprocessor::ExpandBuiltin(Builtin builtin, const Token &name) {
+  const char *pos = mLastFilePos ? mLastFilePos : name.getOffset();
+  SmallString<64> text;
+  auto kind = tok::pp_number;
+  switch (builtin) {
+  case Builtin::File:
+    text.push_back('"');
+    appendEscaped(text, Mgr.getPresumedLoc(Mgr.getLocation(pos)).fileName);
+    text.push_back('"');
+    kind = tok::string_literal;
+    break;
+  case Builtin::Line:
+    text = std::to_string(Mgr.getPresumedLoc(Mgr.getLocation(pos)).line);
+    break;
+  case Builtin::Counter:
+    text = std::to_string(mCounter++);
+    break;
+  case Builtin::Date:
+    text = mDate;
+    kind = tok::string_literal;
+    break;
+  case Builtin::Time:
+    text = mTime;
+    kind = tok::string_literal;
+    break;
+  case Builtin::None:
+    LCC_UNREACHABLE;
+  }
+  StringRef spelling = mScratch.copy(text);
+  return Token(kind, spelling.data(), spelling.size());
+}
+
+void Preprocessor::HandleDirective(const Token &hash) {
+  ReadLine();
+  /// a # alone on its line is the null directive
+  if (mLine.empty()) {
+    return;
+  }
+  const Token &name = mLine[0];
+  enum class Kind {
+    Define,
+    Undef,
+    If,
+    Ifdef,
+    Ifndef,
+    Elif,
+    Elifdef,
+    Elifndef,
+    Else,
+    Endif,
+    Include,
+    Embed,
+    Error,
+    Warning,
+    Pragma,
+    Line,
+    Ignored,
+    Invalid
+  };
+  Kind kind = Kind::Invalid;
+  if (isIdentifierOrKeyword(name)) {
+    kind = StringSwitch<Kind>(name.getRepresentation())
+               .Case("define", Kind::Define)
+               .Case("undef", Kind::Undef)
+               .Case("if", Kind::If)
+               .Case("ifdef", Kind::Ifdef)
+               .Case("ifndef", Kind::Ifndef)
+               .Case("elif", Kind::Elif)
+               .Case("elifdef", Kind::Elifdef)
+               .Case("elifndef", Kind::Elifndef)
+               .Case("else", Kind::Else)
+               .Case("endif", Kind::Endif)
+               .Case("include", Kind::Include)
+               .Case("embed", Kind::Embed)
+               .Case("error", Kind::Error)
+               .Case("warning", Kind::Warning)
+               .Case("pragma", Kind::Pragma)
+               .Case("line", Kind::Line)
+               .Case("ident", Kind::Ignored)
+               .Default(Kind::Invalid);
+  }
+
+  /// Multiple include optimization, as in clang's MultipleIncludeOpt: a
+  /// file is guarded if nothing but the group of a leading #ifndef X or
+  /// #if !defined X is at its top level, and the group has no #else.
+  FileState &file = mFiles.back();
+  if (mConditionals.size() == file.conditionalDepth) {
+    std::optional<uint32_t> guard;
+    if ((kind == Kind::Ifndef || kind == Kind::If) && !file.outsideGuard &&
+        !file.guardMacro) {
+      guard = GetGuardMacro(kind == Kind::Ifndef);
+    }
+    if (guard) {
+      file.guardMacro = guard;
+    } else {
+      file.outsideGuard = true;
+    }
+  } else if (mConditionals.size() == file.conditionalDepth + 1 &&
+             file.guardMacro && !file.guardClosed) {
+    if (kind == Kind::Endif) {
+      file.guardClosed = true;
+    } else if (kind == Kind::Else || kind == Kind::Elif ||
+               kind == Kind::Elifdef || kind == Kind::Elifndef) {
+      file.outsideGuard = true;
+    }
+  }
+
+  /// in a skipped region only the conditionals are looked at
+  if (IsSkipping()) {
+    switch (kind) {
+    case Kind::If:
+    case Kind::Ifdef:
+    case Kind::Ifndef:
+      mConditionals.push_back({hash.getOffset(), false, true});
+      return;
+    case Kind::Elif:
+      return HandleIf(name, true);
+    case Kind::Elifdef:
+    case Kind::Elifndef:
+      return HandleIfdef(name, kind == Kind::Elifdef, true);
+    case Kind::Else:
+      return HandleElse(name);
+    case Kind::Endif:
+      return HandleEndif(name);
+    default:
+      return;
+    }
+  }
+
+  switch (kind) {
+  case Kind::Define:
+    return HandleDefine();
+  case Kind::Undef:
+    return HandleUndef();
+  case Kind::If:
+  case Kind::Elif:
+    return HandleIf(name, kind == Kind::Elif);
+  case Kind::Ifdef:
+  case Kind::Ifndef:
+    return HandleIfdef(name, kind == Kind::Ifdef, false);
+  case Kind::Elifdef:
+  case Kind::Elifndef:
+    return HandleIfdef(name, kind == Kind::Elifdef, true);
+  case Kind::Else:
+    return HandleElse(name);
+  case Kind::Endif:
+    return HandleEndif(name);
+  case Kind::Include:
+    return HandleInclude(hash);
+  case Kind::Embed:
+    return HandleEmbed(hash);
+  case Kind::Line:
+    return HandleLine(hash);
+  case Kind::Error:
+  case Kind::Warning: {
+    StringRef message;
+    if (mLine.size() > 1) {
+      const char *begin = mLine[1].getOffset();
+      const char *end = mLine.back().getOffset() + mLine.back().getLength();
+      message = StringRef(begin, end - begin);
+    }
+    if (kind == Kind::Error) {
+      DiagReport(Diag, hash.getSMLoc(), diag::err_pp_error_directive, message);
+    } else {
+      DiagReport(Diag, hash.getSMLoc(), diag::warn_pp_warning_directive,
+                 message);
+    }
+    return;
+  }
+  case Kind::Pragma:
+    if (mLine.size() > 1 && mLine[1].getRepresentation() == "once" &&
+        file.isHeader) {
+      CheckExtraTokens(name, 2);
+      mHeaders[file.uniqueID].once = true;
+    }
+    return;
+  case Kind::Ignored:
+    return;
+  case Kind::Invalid:
+    DiagReport(Diag, name.getSMLoc(), diag::err_pp_invalid_directive);
+    return;
+  }
+}
+
+void Preprocessor::CheckExtraTokens(const Token &directive, size_t expected) {
+  if (mLine.size() > expected) {
+    DiagReport(Diag, mLine[expected].getSMLoc(), diag::warn_pp_extra_tokens,
+               directive.getRepresentation());
+  }
+}
+
+/**
+ # define identifier replacement-list new-line
+ # define identifier lparen identifier-list{opt} ) replacement-list new-line
+ # define identifier lparen ... ) replacement-list new-line
+ # define identifier lparen identifier-list , ... ) replacement-list new-line
+ */
+void Preprocessor::HandleDefine() {
+  if (mLine.size() < 2 || !isIdentifierOrKeyword(mLine[1])) {
+    DiagReport(Diag, (mLine.size() < 2 ? mLine[0] : mLine[1]).getSMLoc(),
+               diag::err_pp_expected_macro_name);
+    return;
+  }
+  const Token &name = mLine[1];
+  uint32_t nameId = IdentifierIdOf(name);
+  if (nameId == mDefinedId) {
+    DiagReport(Diag, name.getSMLoc(), diag::err_pp_defined_as_macro_name);
+    return;
+  }
+
+  Macro macro{};
+  SmallVector<uint32_t, 8> params;
+  size_t i = 2;
+  /// only a ( right behind the name starts a parameter list
+  if (i < mLine.size() && mLine[i].getTokenKind() == tok::l_paren &&
+      isAdjacent(name, mLine[i])) {
+    macro.isFunctionLike = true;
+    ++i;
+    bool closed = i < mLine.size() && mLine[i].getTokenKind() == tok::r_paren;
+    if (closed) {
+      ++i;
+    }
+    while (!closed) {
+      if (i == mLine.size()) {
+        DiagReport(Diag, mLine.back().getSMLoc(),
+                   diag::err_pp_invalid_macro_params);
+        return;
+      }
+      const Token &param = mLine[i++];
+      if (param.getTokenKind() == tok::ellipsis) {
+        macro.isVariadic = true;
+        params.push_back(mVaArgsId);
+      } else if (param.getTokenKind() == tok::identifier) {
+        uint32_t id = param.getIdentifierId();
+        if (std::find(params.begin(), params.end(), id) != params.end()) {
+          DiagReport(Diag, param.getSMLoc(), diag::err_pp_duplicate_macro_param,
+                     param.getRepresentation());
+          return;
+        }
+        params.push_back(id);
+        /// GNU named variable arguments, `args...`
+        if (i < mLine.size() && mLine[i].getTokenKind() == tok::ellipsis) {
+          macro.isVariadic = true;
+          ++i;
+        }
+      } else {
+        DiagReport(Diag, param.getSMLoc(), diag::err_pp_invalid_macro_params);
+        return;
+      }
+      if (i < mLine.size() && mLine[i].getTokenKind() == tok::comma &&
+          !macro.isVariadic) {
+        ++i;
+      } else if (i < mLine.size() &&
+                 mLine[i].getTokenKind() == tok::r_paren) {
+        ++i;
+        closed = true;
+      } else {
+        DiagReport(Diag, (i < mLine.size() ? mLine[i] : mLine.back()).getSMLoc(),
+                   diag::err_pp_invalid_macro_params);
+        return;
+      }
+    }
+    macro.numParams = params.size();
+  }
+
+  size_t bodySize = mLine.size() - i;
+  Token *body = mArena.Allocate<Token>(bodySize);
+  for (size_t j = 0; j < bodySize; ++j) {
+    Token token = mLine[i + j];
+    if (macro.isFunctionLike && token.getTokenKind() == tok::identifier) {
+      auto *pos = std::find(params.begin(), params.end(),
+                            token.getIdentifierId());
+      if (pos != params.end()) {
+        token.setTokenKind(tok::pp_macro_param);
+        token.setIndex(pos - params.begin());
+      }
+    } else if (token.getTokenKind() == tok::pp_hashhash) {
+      token.setIndex(PasteOperator);
+    }
+    new (body + j) Token(token);
+  }
+  macro.body = ArrayRef<Token>(body, bodySize);
+  for (size_t j = 0; j < bodySize; ++j) {
+    if (macro.isFunctionLike && body[j].getTokenKind() == tok::pp_hash &&
+        (j + 1 == bodySize ||
+         body[j + 1].getTokenKind() != tok::pp_macro_param)) {
+      DiagReport(Diag, body[j].getSMLoc(), diag::err_pp_stringify_not_param);
+      return;
+    }
+  }
+  if (bodySize && (isPasteOperator(body[0]) ||
+                   isPasteOperator(body[bodySize - 1]))) {
+    DiagReport(Diag,
+               (isPasteOperator(body[0]) ? body[0] : body[bodySize - 1])
+                   .getSMLoc(),
+               diag::err_pp_paste_at_edge);
+    return;
+  }
+
+  MacroSlot &slot = GetMacroSlot(nameId);
+  if (!slot.hasId) {
+    slot.hasId = true;
+    slot.id = mNumMacroIds++;
+  }
+  macro.id = slot.id;
+  if (Macro *old = slot.macro) {
+    if (old->pchMacro) {
+      LoadMacroBody(*old);
+    }
+    /// a redefinition has to be the same token for token, with white space
+    /// in the same places
+    bool same = old->builtin == Builtin::None &&
+                old->isFunctionLike == macro.isFunctionLike &&
+                old->isVariadic == macro.isVariadic &&
+                old->numParams == macro.numParams &&
+                old->body.size() == macro.body.size();
+    for (size_t j = 0; same && j < bodySize; ++j) {
+      const Token &a = old->body[j], &b = macro.body[j];
+      same = a.getTokenKind() == b.getTokenKind() &&
+             a.getRepresentation() == b.getRepresentation() &&
+             (!j || isAdjacent(old->body[j - 1], a) ==
+                        isAdjacent(macro.body[j - 1], b));
+    }
+    if (!same) {
+      DiagReport(Diag, name.getSMLoc(), diag::warn_pp_macro_redefined,
+                 name.getRepresentation());
+    }
+  } else if (name.getTokenKind() != tok::identifier) {
+    ++mNumKeywordMacros;
+  }
+  slot.macro = new (mArena.Allocate<Macro>()) Macro(macro);
+}
+
+void Preprocessor::HandleUndef() {
+  if (mLine.size() < 2 || !isIdentifierOrKeyword(mLine[1])) {
+    DiagReport(Diag, (mLine.size() < 2 ? mLine[0] : mLine[1]).getSMLoc(),
+               diag::err_pp_expected_macro_name);
+    return;
+  }
+  CheckExtraTokens(mLine[0], 2);
+  MacroSlot &slot = GetMacroSlot(IdentifierIdOf(mLine[1]));
+  if (slot.macro && mLine[1].getTokenKind() != tok::identifier) {
+    --mNumKeywordMacros;
+  }
+  slot.macro = nullptr;
+}
+
+void Preprocessor::HandleIf(const Token &directive, bool isElif) {
+  if (!isElif) {
+    bool value = EvaluateCondition();
+    mConditionals.push_back({directive.getOffset(), value, value});
+    return;
+  }
+  if (mConditionals.empty()) {
+    DiagReport(Diag, directive.getSMLoc(),
+               diag::err_pp_conditional_without_if,
+               directive.getRepresentation());
+    return;
+  }
+  if (mConditionals.back().sawElse) {
+    DiagReport(Diag, directive.getSMLoc(), diag::err_pp_conditional_after_else,
+               directive.getRepresentation());
+  }
+  if (mConditionals.back().taken) {
+    mConditionals.back().active = false;
+    return;
+  }
+  bool value = EvaluateCondition();
+  mConditionals.back().active = value;
+  mConditionals.back().taken = value;
+}
+
+void Preprocessor::HandleIfdef(const Token &directive, bool isDefined,
+                               bool isElif) {
+  if (isElif) {
+    if (mConditionals.empty()) {
+      DiagReport(Diag, directive.getSMLoc(),
+                 diag::err_pp_conditional_without_if,
+                 directive.getRepresentation());
+      return;
+    }
+    if (mConditionals.back().sawElse) {
+      DiagReport(Diag, directive.getSMLoc(),
+                 diag::err_pp_conditional_after_else,
+                 directive.getRepresentation());
+    }
+    if (mConditionals.back().taken) {
+      mConditionals.back().active = false;
+      return;
+    }
+  }
+  bool value = false;
+  if (mLine.size() < 2 || !isIdentifierOrKeyword(mLine[1])) {
+    DiagReport(Diag, (mLine.size() < 2 ? mLine[0] : mLine[1]).getSMLoc(),
+               diag::err_pp_expected_macro_name);
+  } else {
+    CheckExtraTokens(directive, 2);
+    value = (LookupMacro(mLine[1]) != nullptr) == isDefined;
+  }
+  if (isElif) {
+    mConditionals.back().active = value;
+    mConditionals.back().taken = value;
+  } else {
+    mConditionals.push_back({directive.getOffset(), value, value});
+  }
+}
+
+void Preprocessor::HandleElse(const Token &directive) {
+  if (mConditionals.empty()) {
+    DiagReport(Diag, directive.getSMLoc(),
+               diag::err_pp_conditional_without_if,
+               directive.getRepresentation());
+    return;
+  }
+  Conditional &conditional = mConditionals.back();
+  if (conditional.sawElse) {
+    DiagReport(Diag, directive.getSMLoc(), diag::err_pp_conditional_after_else,
+               directive.getRepresentation());
+  }
+  CheckExtraTokens(directive, 1);
+  conditional.sawElse = true;
+  conditional.active = !conditional.taken;
+  conditional.taken = true;
+}
+
+void Preprocessor::HandleEndif(const Token &directive) {
+  if (mConditionals.empty()) {
+    DiagReport(Diag, directive.getSMLoc(),
+               diag::err_pp_conditional_without_if,
+               directive.getRepresentation());
+    return;
+  }
+  CheckExtraTokens(directive, 1);
+  mConditionals.pop_back();
+}
+
+std::optional<uint32_t> Preprocessor::GetGuardMacro(bool isIfndef) {
+  auto kindAt = [&](size_t i) {
+    return i < mLine.size() ? mLine[i].getTokenKind() : tok::unknown;
+  };
+  auto isDefined = [&](size_t i) {
+    return kindAt(i) == tok::identifier &&
+           mLine[i].getIdentifierId() == mDefinedId;
+  };
+  /// #ifndef X
+  if (isIfndef) {
+    if (mLine.size() == 2 && kindAt(1) == tok::identifier) {
+      return mLine[1].getIdentifierId();
+    }
+    return std::nullopt;
+  }
+  /// #if !defined X, #if !defined(X)
+  if (kindAt(1) != tok::exclaim || !isDefined(2)) {
+    return std::nullopt;
+  }
+  if (mLine.size() == 4 && kindAt(3) == tok::identifier) {
+    return mLine[3].getIdentifierId();
+  }
+  if (mLine.size() == 6 && kindAt(3) == tok::l_paren &&
+      kindAt(4) == tok::identifier && kindAt(5) == tok::r_paren) {
+    return mLine[4].getIdentifierId();
+  }
+  return std::nullopt;
+}
+
+/**
+ # include "q-char-sequence" new-line
+ # include <h-char-sequence> new-line
+ # include pp-tokens new-line
+ */
+void Preprocessor::HandleInclude(const Token &hash) {
+  const Token &directive = mLine[0];
+  if (mLine.size() < 2) {
+    DiagReport(Diag, directive.getSMLoc(), diag::err_pp_expected_filename);
+    return;
+  }
+  /// the lexer spells "name" and <name> as one string literal right after
+  /// #include; anything else is macro expanded first
+  SmallString<128> spelling;
+  const Token *at = &mLine[1];
+  if (mLine[1].getTokenKind() == tok::string_literal) {
+    spelling = mLine[1].getRepresentation();
+    CheckExtraTokens(directive, 2);
+  } else {
+    mExprTokens.clear();
+    for (size_t i = 1; i < mLine.size(); ++i) {
+      mExprTokens.push_back({mLine[i]});
+    }
+    mExprExpanded.clear();
+    ExpandList(mExprTokens, 1, mExprExpanded);
+    if (!mExprExpanded.empty() &&
+        mExprExpanded[0].token.getTokenKind() == tok::string_literal) {
+      spelling = mExprExpanded[0].token.getRepresentation();
+    } else if (!mExprExpanded.empty() &&
+               mExprExpanded[0].token.getTokenKind() == tok::less) {
+      for (size_t i = 0; i < mExprExpanded.size(); ++i) {
+        const Token &token = mExprExpanded[i].token;
+        if (i > 1 && !isAdjacent(mExprExpanded[i - 1].token, token)) {
+          spelling.push_back(' ');
+        }
+        spelling.append(token.getRepresentation());
+        if (token.getTokenKind() == tok::greater) {
+          break;
+        }
+      }
+    }
+  }
+  bool isQuoted = spelling.startswith("\"") && spelling.endswith("\"");
+  bool isAngled = spelling.startswith("<") && spelling.endswith(">");
+  if (spelling.size() < 3 || (!isQuoted && !isAngled)) {
+    DiagReport(Diag, at->getSMLoc(), diag::err_pp_expected_filename);
+    return;
+  }
+  if (mFiles.size() > MaxIncludeDepth) {
+    DiagReport(Diag, hash.getSMLoc(), diag::err_pp_include_too_deep);
+    return;
+  }
+  StringRef name = StringRef(spelling).drop_front().drop_back();
+
+  /// "name" is looked up next to the including file first
+  std::optional<StringRef> includerDir;
+  if (!isAngled) {
+    includerDir = sys::path::parent_path(
+        Mgr.getBufferName(mFiles.back().lexer->getFileID()));
+  }
+  const FileEntry *file =
+      mFileMgr->lookupInclude(name, includerDir, mIncludeDirs);
+  if (!file) {
+    DiagReport(Diag, at->getSMLoc(), diag::err_pp_file_not_found, name);
+    return;
+  }
+
+  /// keyed on the file, not on the spelling that led to it
+  sys::fs::UniqueID uniqueID = file->getUniqueID();
+  auto iter = mHeaders.find(uniqueID);
+  if (iter != mHeaders.end()) {
+    const HeaderInfo &info = iter->second;
+    if (info.once ||
+        (info.hasGuard && GetMacroSlot(info.guardMacro).macro)) {
+      ++mNumSkippedIncludes;
+      return;
+    }
+  }
+  auto buffer = mFileMgr->getBuffer(*file);
+  if (!buffer) {
+    DiagReport(Diag, at->getSMLoc(), diag::err_pp_cannot_open_include, name,
+               buffer.getError().message());
+    return;
+  }
+  bool isSystem = isAngled || mFiles.back().isSystem;
+  if (mHeaders.try_emplace(uniqueID).second) {
+    mIncludedFiles.push_back({file->getName().str(), isSystem});
+  }
+  EnterFile(std::make_unique<Lexer>(Mgr, Diag, mIdents, std::move(*buffer)));
+  mFiles.back().isHeader = true;
+  mFiles.back().isSystem = isSystem;
+  mFiles.back().uniqueID = uniqueID;
+}
+
+void Preprocessor::HandleEmbed(const Token &hash) {
+  const Token &name = mLine[0];
+  Lexer &lexer = *mFiles.back().lexer;
+  std::vector<Token> expansion;
+  lexer.LexEmbedDirective(hash.getOffset(),
+                          name.getOffset() + name.getLength(), expansion);
+  if (mDirectiveOutputPos == mDirectiveOutput.size()) {
+    mDirectiveOutput.clear();
+    mDirectiveOutputPos = 0;
+  }
+  for (Token &token : expansion) {
+    /// the bytes belong in the pool the parser reads
+    if (token.getTokenKind() == tok::embed_data && &lexer != &mMainLexer) {
+      token.setIndex(mMainLexer.mLiterals.add(
+          lexer.mLiterals.get(token.getLiteralIndex())));
+    }
+    mDirectiveOutput.push_back(token);
+  }
+}
+
+/**
+ # line digit-sequence new-line
+ # line digit-sequence " s-char-sequence{opt} " new-line
+ # line pp-tokens new-line
+ */
+void Preprocessor::HandleLine(const Token &hash) {
+  const Token &directive = mLine[0];
+  /// a number right after #line is taken as written, anything else is
+  /// macro expanded first
+  SmallVector<Token, 4> operands;
+  if (mLine.size() > 1 && mLine[1].getTokenKind() == tok::pp_number) {
+    operands.append(mLine.begin() + 1, mLine.end());
+  } else {
+    mExprTokens.clear();
+    for (size_t i = 1; i < mLine.size(); ++i) {
+      mExprTokens.push_back({mLine[i]});
+    }
+    mExprExpanded.clear();
+    ExpandList(mExprTokens, 1, mExprExpanded);
+    for (const auto &expanded : mExprExpanded) {
+      operands.push_back(expanded.token);
+    }
+  }
+
+  unsigned line = 0;
+  StringRef digits =
+      operands.empty() ? StringRef() : operands[0].getRepresentation();
+  if (operands.empty() || operands[0].getTokenKind() != tok::pp_number ||
+      digits.find_first_not_of("0123456789") != StringRef::npos ||
+      digits.getAsInteger(10, line) || line == 0 || line > 2147483647u) {
+    DiagReport(Diag, (operands.empty() ? directive : operands[0]).getSMLoc(),
+               diag::err_pp_line_requires_integer);
+    return;
+  }
+
+  SmallString<128> fileName;
+  if (operands.size() > 1) {
+    StringRef spelling = operands[1].getRepresentation();
+    if (operands[1].getTokenKind() != tok::string_literal ||
+        !spelling.startswith("\"")) {
+      DiagReport(Diag, operands[1].getSMLoc(),
+                 diag::err_pp_line_invalid_filename);
+      return;
+    }
+    spelling = spelling.drop_front().drop_back();
+    for (size_t i = 0; i < spelling.size(); ++i) {
+      if (spelling[i] == '\\' && i + 1 < spelling.size()) {
+        ++i;
+      }
+      fileName.push_back(spelling[i]);
+    }
+    if (operands.size() > 2) {
+      DiagReport(Diag, operands[2].getSMLoc(), diag::warn_pp_extra_tokens,
+                 directive.getRepresentation());
+    }
+  }
+  Mgr.addLineDirective(Mgr.getLocation(hash.getOffset()), line, fileName);
+}
+
+bool Preprocessor::EvaluateCondition() {
+  const Token &directive = mLine[0];
+  /// `defined X` and `defined ( X )` are resolved before macro expansion
+  mExprTokens.clear();
+  for (size_t i = 1; i < mLine.size(); ++i) {
+    const Token &token = mLine[i];
+    if (token.getTokenKind() != tok::identifier ||
+        token.getIdentifierId() != mDefinedId) {
+      mExprTokens.push_back({token});
+      continue;
+    }
+    bool paren = i + 1 < mLine.size() &&
+                 mLine[i + 1].getTokenKind() == tok::l_paren;
+    size_t nameIndex = i + 1 + paren;
+    if (nameIndex >= mLine.size() || !isIdentifierOrKeyword(mLine[nameIndex])) {
+      DiagReport(Diag, token.getSMLoc(), diag::err_pp_defined_expected_ident);
+      return false;
+    }
+    bool defined = LookupMacro(mLine[nameIndex]) != nullptr;
+    i = nameIndex;
+    if (paren) {
+      if (i + 1 >= mLine.size() ||
+          mLine[i + 1].getTokenKind() != tok::r_paren) {
+        DiagReport(Diag, mLine[i].getSMLoc(), diag::err_pp_expected_in_expr,
+                   ")");
+        return false;
+      }
+      ++i;
+    }
+    mExprTokens.push_back({defined ? mOne : mZero});
+  }
+  mExprExpanded.clear();
+  ExpandList(mExprTokens, 1, mExprExpanded);
+  mExpr = mExprExpanded;
+  mExprPos = 0;
+  mExprError = false;
+  if (mExpr.empty()) {
+    DiagReport(Diag, directive.getSMLoc(), diag::err_pp_expected_value_in_expr);
+    return false;
+  }
+  Value value = EvalConditional(true);
+  if (!mExprError && mExprPos != mExpr.size()) {
+    ExprError(diag::err_pp_invalid_operator_in_expr);
+  }
+  return !mExprError && value.value != 0;
+}
+
+void Preprocessor::ExprError(unsigned diagID, StringRef arg) {
+  if (mExprError) {
+    return;
+  }
+  mExprError = true;
+  const Token &at =
+      mExprPos < mExpr.size() ? mExpr[mExprPos].token : mExpr.back().token;
+  if (arg.empty()) {
+    DiagReport(Diag, at.getSMLoc(), diagID);
+  } else {
+    DiagReport(Diag, at.getSMLoc(), diagID, arg);
+  }
+}
+
+/// cond ? expr : cond, the only right associative operator
+Preprocessor::Value Preprocessor::EvalConditional(bool evaluate) {
+  Value cond = EvalBinary(1, evaluate);
+  const Token *token = PeekExpr();
+  if (mExprError || !token || token->getTokenKind() != tok::question) {
+    return cond;
+  }
+  ++mExprPos;
+  bool isTrue = cond.value != 0;
+  Value lhs = EvalConditional(evaluate && isTrue);
+  token = PeekExpr();
+  if (!token || token->getTokenKind() != tok::colon) {
+    ExprError(diag::err_pp_expected_in_expr, ":");
+    return {};
+  }
+  ++mExprPos;
+  Value rhs = EvalConditional(evaluate && !isTrue);
+  Value result = isTrue ? lhs : rhs;
+  result.isUnsigned = lhs.isUnsigned || rhs.isUnsigned;
+  return result;
+}
+
+namespace {
+unsigned getBinaryPrecedence(tok::TokenKind kind) {
+  switch (kind) {
+  case tok::star:
+  case tok::slash:
+  case tok::percent:
+    return 10;
+  case tok::plus:
+  case tok::minus:
+    return 9;
+  case tok::less_less:
+  case tok::greater_greater:
+    return 8;
+  case tok::less:
+  case tok::greater:
+  case tok::less_equal:
+  case tok::greater_equal:
+    return 7;
+  case tok::equal_equal:
+  case tok::exclaim_equal:
+    return 6;
+  case tok::amp:
+    return 5;
+  case tok::caret:
+    return 4;
+  case tok::pipe:
+    return 3;
+  case tok::amp_amp:
+    return 2;
+  case tok::pipe_pipe:
+    return 1;
+  default:
+    return 0;
+  }
+}
+} // namespace
+
+/// Precedence climbing over the binary operators. Values are intmax_t or
+/// uintmax_t as in C, signed arithmetic wraps instead of being undefined.
+Preprocessor::Value Preprocessor::EvalBinary(unsigned minPrecedence,
+                                             bool evaluate) {
+  Value lhs = EvalUnary(evaluate);
+  while (!mExprError) {
+    const Token *op = PeekExpr();
+    unsigned precedence = op ? getBinaryPrecedence(op->getTokenKind()) : 0;
+    if (!precedence || precedence < minPrecedence) {
+      break;
+    }
+    auto kind = op->getTokenKind();
+    ++mExprPos;
+    bool evaluateRhs = evaluate;
+    if (kind == tok::amp_amp) {
+      evaluateRhs = evaluate && lhs.value;
+    } else if (kind == tok::pipe_pipe) {
+      evaluateRhs = evaluate && !lhs.value;
+    }
+    Value rhs = EvalBinary(precedence + 1, evaluateRhs);
+    if (mExprError) {
+      break;
+    }
+    bool isUnsigned = lhs.isUnsigned || rhs.isUnsigned;
+    auto a = static_cast<int64_t>(lhs.value), b = static_cast<int64_t>(rhs.value);
+    Value result{0, isUnsigned};
+    switch (kind) {
+    case tok::star:
+      result.value = lhs.value * rhs.value;
+      break;
+    case tok::slash:
+    case tok::percent:
+      if (!rhs.value) {
+        if (evaluate) {
+          --mExprPos;
+          ExprError(diag::err_pp_division_by_zero);
+        }
+        break;
+      }
+      if (isUnsigned) {
+        result.value = kind == tok::slash ? lhs.value / rhs.value
+                                          : lhs.value % rhs.value;
+      } else if (b == -1) {
+        /// INTMAX_MIN / -1 wraps
+        result.value = kind == tok::slash ? 0 - lhs.value : 0;
+      } else {
+        result.value = kind == tok::slash ? a / b : a % b;
+      }
+      break;
+    case tok::plus:
+      result.value = lhs.value + rhs.value;
+      break;
+    case tok::minus:
+      result.value = lhs.value - rhs.value;
+      break;
+    case tok::less_less:
+    case tok::greater_greater:
+      /// the type of a shift is the type of its left operand
+      result.isUnsigned = lhs.isUnsigned;
+      if (rhs.value >= 64) {
+        result.value =
+            kind == tok::greater_greater && !lhs.isUnsigned && a < 0 ? -1 : 0;
+      } else if (kind == tok::less_less) {
+        result.value = lhs.value << rhs.value;
+      } else {
+        result.value = lhs.isUnsigned ? lhs.value >> rhs.value
+                                      : static_cast<uint64_t>(a >> rhs.value);
+      }
+      break;
+    case tok::less:
+      result = {isUnsigned ? lhs.value < rhs.value : a < b, false};
+      break;
+    case tok::greater:
+      result = {isUnsigned ? lhs.value > rhs.value : a > b, false};
+      break;
+    case tok::less_equal:
+      result = {isUnsigned ? lhs.value <= rhs.value : a <= b, false};
+      break;
+    case tok::greater_equal:
+      result = {isUnsigned ? lhs.value >= rhs.value : a >= b, false};
+      break;
+    case tok::equal_equal:
+      result = {lhs.value == rhs.value, false};
+      break;
+    case tok::exclaim_equal:
+      result = {lhs.value != rhs.value, false};
+      break;
+    case tok::amp:
+      result.value = lhs.value & rhs.value;
+      break;
+    case tok::caret:
+      result.value = lhs.value ^ rhs.value;
+      break;
+    case tok::pipe:
+      result.value = lhs.value | rhs.value;
+      break;
+    case tok::amp_amp:
+      result = {lhs.value && rhs.value, false};
+      break;
+    case tok::pipe_pipe:
+      result = {lhs.value || rhs.value, false};
+      break;
+    default:
+      LCC_UNREACHABLE;
+    }
+    lhs = result;
+  }
+  return lhs;
+}
+
+Preprocessor::Value Preprocessor::EvalUnary(bool evaluate) {
+  const Token *token = PeekExpr();
+  if (!token) {
+    ExprError(diag::err_pp_expected_value_in_expr);
+    return {};
+  }
+  switch (token->getTokenKind()) {
+  case tok::plus:
+    ++mExprPos;
+    return EvalUnary(evaluate);
+  case tok::minus: {
+    ++mExprPos;
+    Value value = EvalUnary(evaluate);
+    value.value = 0 - value.value;
+    return value;
+  }
+  case tok::tilde: {
+    ++mExprPos;
+    Value value = EvalUnary(evaluate);
+    value.value = ~value.value;
+    return value;
+  }
+  case tok::exclaim: {
+    ++mExprPos;
+    Value value = EvalUnary(evaluate);
+    return {!value.value, false};
+  }
+  case tok::l_paren: {
+    ++mExprPos;
+    Value value = EvalConditional(evaluate);
+    token = PeekExpr();
+    if (!mExprError && (!token || token->getTokenKind() != tok::r_paren)) {
+      ExprError(diag::err_pp_expected_in_expr, ")");
+    }
+    ++mExprPos;
+    return value;
+  }
+  default:
+    return EvalPrimary(evaluate);
+  }
+}
+
+Preprocessor::Value Preprocessor::EvalPrimary(bool evaluate) {
+  const Token &token = *PeekExpr();
+  switch (token.getTokenKind()) {
+  case tok::pp_number: {
+    Value value;
+    bool isFloat = false;
+    match(mMainLexer.ParseNumber(token), [&](const auto &number) {
+      using T = std::decay_t<decltype(number)>;
+      if constexpr (std::is_integral_v<T>) {
+        value = {static_cast<uint64_t>(number), std::is_unsigned_v<T>};
+      } else if constexpr (std::is_floating_point_v<T>) {
+        isFloat = true;
+      }
+    });
+    if (isFloat) {
+      ExprError(diag::err_pp_float_in_expr);
+      return {};
+    }
+    ++mExprPos;
+    return value;
+  }
+  case tok::char_constant: {
+    auto chars = mMainLexer.ParseCharacters(token, true);
+    ++mExprPos;
+    return {static_cast<uint64_t>(static_cast<int64_t>(chars[0])), false};
+  }
+  default:
+    break;
+  }
+  if (isIdentifierOrKeyword(token)) {
+    /// identifiers left after macro expansion are 0, true is 1 as in C23
+    ++mExprPos;
+    return {token.getRepresentation() == "true", false};
+  }
+  ExprError(diag::err_pp_expected_value_in_expr);
+  return {};
+}
+} // namespace lcc
@@ -0,0 +1,184 @@
+/***********************************
+ * File:     TokenStream.cc
+ *
+ * Author:   caipeng
+ *
+ * Email:    iiicp@outlook.com
+ *
+ * Date:     2023/6/5
+ *
+ * Sign:     enjoy life
+ ***********************************/
+#include "lcc/Lexer/TokenStream.h"
+#include "lcc/Basic/Util.h"
+#include "lcc/Lexer/Lexer.h"
+#include "lcc/Lexer/Preprocessor.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+
+namespace lcc {
+
+/// which of the ( [ { pairs \p kind opens or closes, -1 for no bracket
+static int BracketPair(tok::TokenKind kind, bool &isOpener) {
+  isOpener = kind == tok::l_paren || kind == tok::l_square ||
+             kind == tok::l_brace;
+  switch (kind) {
+  case tok::l_paren:
+  case tok::r_paren:
+    return 0;
+  case tok::l_square:
+  case tok::r_square:
+    return 1;
+  case tok::l_brace:
+  case tok::r_brace:
+    return 2;
+  default:
+    return -1;
+  }
+}
+
+TokenStream::TokenStream(Lexer &lexer, uint32_t initialWindow)
+    : mLexer(&lexer), mEof(tok::eof, lexer.getBufferEnd(), 0) {
+  InitRing(initialWindow);
+}
+
+TokenStream::TokenStream(Preprocessor &pp, uint32_t initialWindow)
+    : mPreprocessor(&pp), mEof(tok::eof, pp.getBufferEnd(), 0) {
+  InitRing(initialWindow);
+}
+
+void TokenStream::InitRing(uint32_t initialWindow) {
+  uint32_t size = llvm::PowerOf2Ceil(std::max<uint32_t>(initialWindow, 16));
+  mRing.assign(size, mEof);
+  mMatch.assign(size, NoMatch);
+  mMask = size - 1;
+}
+
+TokenStream::TokenStream(const std::vector<Token> &tokens)
+    : mTokens(&tokens),
+      mEof(tok::eof,
+           tokens.empty()
+               ? nullptr
+               : tokens.back().getOffset() + tokens.back().getLength(),
+           0) {
+  mEnd = tokens.size();
+  mExhausted = true;
+  mMatch.assign(tokens.size(), NoMatch);
+  for (uint32_t i = 0; i < mEnd; ++i) {
+    MatchBracket(i, tokens[i].getTokenKind());
+  }
+  CloseAll();
+}
+
+const Token &TokenStream::get(uint32_t index) {
+  if (mTokens) {
+    return index < mEnd ? (*mTokens)[index] : mEof;
+  }
+  LCC_ASSERT(index >= mBegin && "token was already discarded");
+  while (index >= mEnd) {
+    if (mExhausted) {
+      return mEof;
+    }
+    if (mEnd - mBegin == mRing.size()) {
+      Grow();
+    }
+    if (!Pull(mRing[mEnd & mMask])) {
+      mExhausted = true;
+      CloseAll();
+      return mEof;
+    }
+    mMatch[mEnd & mMask] = NoMatch;
+    ++mEnd;
+    MatchBracket(mEnd - 1, mRing[(mEnd - 1) & mMask].getTokenKind());
+  }
+  return mRing[index & mMask];
+}
+
+uint32_t TokenStream::getMatch(uint32_t index) {
+  if (mTokens) {
+    return index < mEnd ? mMatch[index] : NoMatch;
+  }
+  get(index);
+  if (index >= mEnd) {
+    return NoMatch;
+  }
+  while (mMatch[index & mMask] == Pending && mEnd - index < MatchWindow) {
+    get(mEnd);
+  }
+  uint32_t match = mMatch[index & mMask];
+  return match == Pending ? NoMatch : match;
+}
+
+/// A closer pairs with the innermost opener of its kind. The openers
+/// inside that one stay unpaired, a missing ) must not cost the block
+/// around it its }. A closer without an opener of its kind stays unpaired
+/// too.
+void TokenStream::MatchBracket(uint32_t index, tok::TokenKind kind) {
+  bool isOpener;
+  int pair = BracketPair(kind, isOpener);
+  if (pair < 0) {
+    return;
+  }
+  if (isOpener) {
+    SetMatch(index, Pending);
+    mOpen.emplace_back(index, pair);
+    ++mNumOpen[pair];
+    return;
+  }
+  if (mNumOpen[pair] == 0) {
+    return;
+  }
+  while (mOpen.back().second != pair) {
+    SetMatch(mOpen.back().first, NoMatch);
+    --mNumOpen[mOpen.back().second];
+    mOpen.pop_back();
+  }
+  SetMatch(mOpen.back().first, index);
+  SetMatch(index, mOpen.back().first);
+  --mNumOpen[pair];
+  mOpen.pop_back();
+}
+
+void TokenStream::SetMatch(uint32_t index, uint32_t match) {
+  if (mTokens) {
+    mMatch[index] = match;
+  } else if (index >= mBegin) {
+    /// the slot of a discarded token may hold a newer one by now
+    mMatch[index & mMask] = match;
+  }
+}
+
+/// at the end of the file, what is still open stays unpaired
+void TokenStream::CloseAll() {
+  for (auto [index, pair] : mOpen) {
+    SetMatch(index, NoMatch);
+  }
+  mOpen.clear();
+  std::fill(std::begin(mNumOpen), std::end(mNumOpen), 0);
+}
+
+void TokenStream::discardBefore(uint32_t index) {
+  if (mTokens) {
+    return;
+  }
+  mBegin = std::max(mBegin, std::min(index, mEnd));
+}
+
+bool TokenStream::Pull(Token &token) {
+  return mPreprocessor ? mPreprocessor->lexCToken(token)
+                       : mLexer->lexCToken(token);
+}
+
+void TokenStream::Grow() {
+  std::vector<Token> ring(mRing.size() * 2, mEof);
+  std::vector<uint32_t> match(ring.size(), NoMatch);
+  uint32_t mask = ring.size() - 1;
+  for (uint32_t i = mBegin; i != mEnd; ++i) {
+    ring[i & mask] = mRing[i & mMask];
+    match[i & mask] = mMatch[i & mMask];
+  }
+  mRing = MV_(ring);
+  mMatch = MV_(match);
+  mMask = mask;
+}
+} // namespace lcc
@@ -11,16 +11,21 @@
 #include "lcc/Parser/Parser.h"
 #include "lcc/Basic/Match.h"
 #include "lcc/Basic/Util.h"
+#include "lcc/Basic/ValueReset.h"
+#include "llvm/ADT/SmallVector.h"
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <set>
+#include <thread>
 
 namespace lcc {
 using namespace Syntax;
 
-Parser::Parser(const std::vector<Token> & tokens, DiagnosticEngine &diag)
-    : mTokens(tokens), mTokCursor(mTokens.cbegin()),
-      mTokEnd(mTokens.cend()), Diag(diag) {
+Parser::Parser(TokenStream &tokens, const LiteralPool &literals,
+               IdentifierTable &idents, DiagnosticEngine &diag)
+    : mTokens(tokens), mLiterals(literals), mIdents(idents), mTokCursor(tokens),
+      Diag(diag) {
 
   FirstDeclaration = FormTokenKinds(tok::kw_auto, tok::kw_extern, tok::kw_static,
      tok::kw_register, tok::kw_typedef, tok::kw_const, tok::kw_restrict,
@@ -44,127 +49,306 @@ Parser::Parser(const std::vector<Token> & tokens, DiagnosticEngine &diag)
 }
 
 TranslationUnit Parser::ParseTranslationUnit() {
-  std::vector<ExternalDeclaration> decls;
-  auto begin = mTokCursor;
-  while (mTokCursor != mTokEnd) {
+  auto context = std::make_unique<ASTContext>();
+  ASTContext::Scope scope(*context);
+  ArenaVector<ExternalDeclaration> decls;
+  auto begin = mTokCursor->getSMLoc();
+  /// With threads to spare, this pass jumps over the function bodies and
+  /// ParseSkippedBodies parses them afterwards. Its diagnostics are held
+  /// back to go out in between theirs. Lazy bodies are jumped over the same
+  /// way and left for their first use.
+  mSkipBodies = (mParseThreads > 1 || mLazyBodies) && mTokens.getTokens();
+  if (mSkipBodies) {
+    if (!mLazyBodies) {
+      Diag.setBuffer(&mSkeletonDiag);
+    }
+  }
+  ParseExternalDeclarations(decls);
+  if (mSkipBodies && mLazyBodies) {
+    DeferSkippedBodies(*context, decls);
+  } else if (mSkipBodies) {
+    Diag.setBuffer(nullptr);
+    ParseSkippedBodies(*context, decls);
+  }
+  return TranslationUnit(begin, MV_(context), MV_(decls));
+}
+
+void Parser::ParseExternalDeclarations(ArenaVector<ExternalDeclaration> &decls) {
+  while (!Peek(tok::eof)) {
+    /// nothing looks back across an external declaration; keep one token
+    /// for the `expect x after this` diagnostics
+    auto index = mTokCursor.getIndex();
+    mTokens.discardBefore(index == 0 ? 0 : index - 1);
     /// ; is a external declaration
     if (Peek(tok::semi)) {
       ConsumeAny();
       continue;
     }
+    size_t numSkipped = mSkippedBodies.size();
     auto result = ParseExternalDeclaration();
     if (result) {
       decls.push_back(std::move(*result));
     }
+    if (mSkippedBodies.size() != numSkipped) {
+      mSkippedBodies.back().declIndex = decls.size() - 1;
+    }
     SkipTo(FirstExternalDeclaration, diag::err_parse_skip_to_first_external_declaration);
   }
-  return TranslationUnit(begin, MV_(decls));
+}
+
+BlockStmt Parser::SkipFunctionBody(llvm::ArrayRef<uint32_t> parameters) {
+  SkippedBody &body = mSkippedBodies.emplace_back();
+  body.begin = mTokCursor.getIndex();
+  body.end = mTokens.getMatch(body.begin) + 1;
+  body.fileScopeSize = mScope.getFileScopeSize();
+  body.parameters = parameters;
+  body.leadingDiag = std::exchange(mSkeletonDiag, {});
+  auto begin = mTokCursor->getSMLoc();
+  mTokCursor = TokenCursor(mTokens, body.end);
+  return BlockStmt(begin, {});
+}
+
+/// the body of a function with \p parameters, in the scope they share
+BlockStmt Parser::ParseFunctionBody(llvm::ArrayRef<uint32_t> parameters) {
+  mScope.pushScope();
+  for (uint32_t id : parameters) {
+    mScope.addToScope(id);
+  }
+  auto compoundStmt = ParseBlockStmt();
+  mScope.popScope();
+  return MV_(*compoundStmt);
+}
+
+/// Every worker parses with a parser, diagnostics engine and arena of its
+/// own, taking the next body in turn. A body sees the file scope of the
+/// serial pass as far as it had got there, which is all the state the
+/// serial parse of it would have had.
+void Parser::ParseSkippedBodies(ASTContext &context,
+                                ArenaVector<ExternalDeclaration> &decls) {
+  mSkipBodies = false;
+  size_t numBodies = mSkippedBodies.size();
+  unsigned threads = std::min<size_t>(mParseThreads, numBodies);
+  std::atomic<size_t> next{0};
+  auto parseBodies = [&](ASTContext &workerContext) {
+    ASTContext::Scope scope(workerContext);
+    DiagnosticEngine diag(Diag.getSourceManager(), llvm::nulls());
+    Parser parser(mTokens, mLiterals, mIdents, diag);
+    parser.mMaxNestingDepth = mMaxNestingDepth;
+    for (size_t i = next++; i < numBodies; i = next++) {
+      SkippedBody &body = mSkippedBodies[i];
+      diag.setBuffer(&body.diag);
+      parser.mScope.setFileScope(&mScope, body.fileScopeSize);
+      parser.mTokCursor = TokenCursor(mTokens, body.begin);
+      body.stmt = parser.ParseFunctionBody(body.parameters);
+      body.parsedEnd = parser.mTokCursor.getIndex();
+    }
+  };
+  std::vector<std::unique_ptr<ASTContext>> contexts;
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; ++i) {
+    contexts.push_back(std::make_unique<ASTContext>());
+    if (i > 0) {
+      workers.emplace_back(parseBodies, std::ref(*contexts[i]));
+    }
+  }
+  if (threads > 0) {
+    parseBodies(*contexts[0]);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (auto &workerContext : contexts) {
+    context.adopt(MV_(workerContext));
+  }
+
+  for (SkippedBody &body : mSkippedBodies) {
+    Diag.emitBuffered(body.leadingDiag);
+    auto &definition = std::get<FunctionDefinition>(decls[body.declIndex]);
+    if (body.parsedEnd != body.end) {
+      /// The error recovery left the body somewhere else than at its
+      /// closing brace, the serial pass would have gone on from there.
+      /// Whatever came after is redone that way.
+      decls.erase(decls.begin() + body.declIndex + 1, decls.end());
+      mScope.truncateFileScope(body.fileScopeSize);
+      mTokCursor = TokenCursor(mTokens, body.begin);
+      definition.setCompoundStatement(ParseFunctionBody(body.parameters));
+      mScope.addToScope(GetDeclaratorId(definition.getDeclarator()));
+      mSkippedBodies.clear();
+      mSkeletonDiag = {};
+      SkipTo(FirstExternalDeclaration,
+             diag::err_parse_skip_to_first_external_declaration);
+      ParseExternalDeclarations(decls);
+      return;
+    }
+    Diag.emitBuffered(body.diag);
+    definition.setCompoundStatement(MV_(*body.stmt));
+  }
+  Diag.emitBuffered(mSkeletonDiag);
+  mSkippedBodies.clear();
+  mSkeletonDiag = {};
+}
+
+/// A parser of its own over the same tokens, for the bodies of one
+/// translation unit, and the file scope as the whole unit left it.
+class Parser::LazyBodyParser {
+  Scope mFileScope;
+  Parser mParser;
+  ASTContext &mContext;
+
+public:
+  LazyBodyParser(const Parser &parser, ASTContext &context)
+      : mFileScope(parser.mScope),
+        mParser(parser.mTokens, parser.mLiterals, parser.mIdents, parser.Diag),
+        mContext(context) {
+    mParser.mMaxNestingDepth = parser.mMaxNestingDepth;
+  }
+
+  BlockStmt parse(uint32_t begin, uint32_t fileScopeSize,
+                  llvm::ArrayRef<uint32_t> parameters) {
+    ASTContext::Scope scope(mContext);
+    mParser.mScope.setFileScope(&mFileScope, fileScopeSize);
+    mParser.mTokCursor = TokenCursor(mParser.mTokens, begin);
+    return mParser.ParseFunctionBody(parameters);
+  }
+};
+
+class Parser::LazyBody final : public LazyFunctionBody {
+  LazyBodyParser &mParser;
+  uint32_t mBegin;
+  uint32_t mFileScopeSize;
+  ArenaVector<uint32_t> mParameters;
+
+public:
+  LazyBody(LazyBodyParser &parser, const SkippedBody &body)
+      : mParser(parser), mBegin(body.begin),
+        mFileScopeSize(body.fileScopeSize),
+        mParameters(body.parameters.begin(), body.parameters.end()) {}
+
+  BlockStmt parse() override {
+    return mParser.parse(mBegin, mFileScopeSize, mParameters);
+  }
+};
+
+/// The body then sees the same file scope as a parse in place would. Only
+/// where the error recovery would have run past its closing brace does the
+/// tree differ: the declarations behind it were parsed on their own.
+void Parser::DeferSkippedBodies(ASTContext &context,
+                                ArenaVector<ExternalDeclaration> &decls) {
+  mSkipBodies = false;
+  if (!mSkippedBodies.empty()) {
+    auto *parser = context.createOwned<LazyBodyParser>(*this, context);
+    for (const SkippedBody &body : mSkippedBodies) {
+      auto &definition = std::get<FunctionDefinition>(decls[body.declIndex]);
+      definition.setLazyBody(context.create<LazyBody>(*parser, body));
+    }
+  }
+  mSkippedBodies.clear();
 }
 
 DeclSpec Parser::ParseDeclarationSpecifiers() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   DeclSpec decSpec(begin);
   bool seeTy = false;
 next_specifier:
   switch (mTokCursor->getTokenKind()) {
   case tok::kw_auto: {
     decSpec.addStorageClassSpecifiers(
-        StorageClsSpec(mTokCursor, StorageClsSpec::Auto));
+        StorageClsSpec(mTokCursor->getSMLoc(), StorageClsSpec::Auto));
     ConsumeAny();
     break;
   }
   case tok::kw_register: {
     decSpec.addStorageClassSpecifiers(
-        StorageClsSpec(mTokCursor, StorageClsSpec::Register));
+        StorageClsSpec(mTokCursor->getSMLoc(), StorageClsSpec::Register));
     ConsumeAny();
     break;
   }
   case tok::kw_static: {
     decSpec.addStorageClassSpecifiers(
-        StorageClsSpec(mTokCursor, StorageClsSpec::Static));
+        StorageClsSpec(mTokCursor->getSMLoc(), StorageClsSpec::Static));
     ConsumeAny();
     break;
   }
   case tok::kw_extern: {
     decSpec.addStorageClassSpecifiers(
-        StorageClsSpec(mTokCursor, StorageClsSpec::Extern));
+        StorageClsSpec(mTokCursor->getSMLoc(), StorageClsSpec::Extern));
     ConsumeAny();
     break;
   }
   case tok::kw_typedef: {
     decSpec.addStorageClassSpecifiers(
-        StorageClsSpec(mTokCursor, StorageClsSpec::Typedef));
+        StorageClsSpec(mTokCursor->getSMLoc(), StorageClsSpec::Typedef));
     ConsumeAny();
     break;
   }
   case tok::kw_volatile: {
     decSpec.addTypeQualifiers(
-        TypeQualifier(mTokCursor, TypeQualifier::Volatile));
+        TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Volatile));
     ConsumeAny();
     break;
   }
   case tok::kw_const: {
-    decSpec.addTypeQualifiers(TypeQualifier(mTokCursor, TypeQualifier::Const));
+    decSpec.addTypeQualifiers(TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Const));
     ConsumeAny();
     break;
   }
   case tok::kw_restrict: {
     decSpec.addTypeQualifiers(
-        TypeQualifier(mTokCursor, TypeQualifier::Restrict));
+        TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Restrict));
     ConsumeAny();
     break;
   }
   case tok::kw_void: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Void));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Void));
     ConsumeAny();
     break;
   }
   case tok::kw_char: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Char));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Char));
     ConsumeAny();
     break;
   }
   case tok::kw_short: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Short));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Short));
     ConsumeAny();
     break;
   }
   case tok::kw_int: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Int));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Int));
     ConsumeAny();
     break;
   }
   case tok::kw_long: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Long));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Long));
     ConsumeAny();
     break;
   }
   case tok::kw_float: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Float));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Float));
     ConsumeAny();
     break;
   }
   case tok::kw_double: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Double));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Double));
     ConsumeAny();
     break;
   }
   case tok::kw_signed: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Signed));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Signed));
     ConsumeAny();
     break;
   }
   case tok::kw_unsigned: {
     seeTy = true;
-    decSpec.addTypeSpec(TypeSpec(mTokCursor, TypeSpec::Unsigned));
+    decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), TypeSpec::Unsigned));
     ConsumeAny();
     break;
   }
@@ -172,7 +356,7 @@ next_specifier:
   case tok::kw_struct: {
     auto expected = ParseStructOrUnionSpecifier();
     if (expected) {
-      decSpec.addTypeSpec(TypeSpec(mTokCursor, MV_(*expected)));
+      decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), MV_(*expected)));
     }
     seeTy = true;
     break;
@@ -180,16 +364,16 @@ next_specifier:
   case tok::kw_enum: {
     auto expected = ParseEnumSpecifier();
     if (expected) {
-      decSpec.addTypeSpec(TypeSpec(mTokCursor, MV_(*expected)));
+      decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), MV_(*expected)));
     }
     seeTy = true;
     break;
   }
   case tok::identifier: {
     auto name = mTokCursor->getRepresentation();
-    if (!seeTy && mScope.isTypedefInScope(name)) {
+    if (!seeTy && mScope.isTypedefInScope(mTokCursor->getIdentifierId())) {
       ConsumeAny();
-      decSpec.addTypeSpec(TypeSpec(mTokCursor, name));
+      decSpec.addTypeSpec(TypeSpec(mTokCursor->getSMLoc(), name));
       seeTy = true;
       break;
     }
@@ -209,11 +393,10 @@ std::optional<Declaration> Parser::ParseDeclarationSuffix(
                   [](const StorageClsSpec &storage) {
                     return storage.getSpecifier() == StorageClsSpec::Typedef;
                   });
-  std::vector<Declaration::InitDeclarator> initDeclarators;
+  ArenaVector<Declaration::InitDeclarator> initDeclarators;
   if (alreadyParsedDeclarator) {
     if (!hasTypedef) {
-      auto name = GetDeclaratorName(*alreadyParsedDeclarator);
-      mScope.addToScope(name);
+      mScope.addToScope(GetDeclaratorId(*alreadyParsedDeclarator));
     }
     if (!Peek(tok::equal)) {
       initDeclarators.push_back({(*alreadyParsedDeclarator).getBeginLoc(),
@@ -244,11 +427,10 @@ std::optional<Declaration> Parser::ParseDeclarationSuffix(
       Expect(tok::comma);
     }
     /// handle first declarator
-    auto begin = mTokCursor;
+    auto begin = mTokCursor->getSMLoc();
     auto declarator = ParseDeclarator();
     if (!hasTypedef && declarator) {
-      auto name = GetDeclaratorName(*declarator);
-      mScope.addToScope(name);
+      mScope.addToScope(GetDeclaratorId(*declarator));
     }
     if (!Peek(tok::equal) && declarator) {
       initDeclarators.push_back({begin, MV_(*declarator), std::nullopt});
@@ -265,8 +447,7 @@ End:
   Expect(tok::semi);
   if (hasTypedef) {
     for (auto& iter : initDeclarators) {
-      auto name = GetDeclaratorName(*iter.declarator_);
-      mScope.addTypedef(name);
+      mScope.addTypedef(GetDeclaratorId(*iter.declarator_));
     }
   }
   return Declaration(declSpec.getBeginLoc(), MV_(declSpec),
@@ -274,7 +455,7 @@ End:
 }
 
 std::optional<ExternalDeclaration> Parser::ParseExternalDeclaration() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   auto declSpecs = ParseDeclarationSpecifiers();
   if (declSpecs.isEmpty()) {
     DiagReport(Diag, mTokCursor->getSMLoc(), diag::err_parse_expect_storage_class_or_type_specifier_or_qualifier);
@@ -313,6 +494,7 @@ std::optional<ExternalDeclaration> Parser::ParseExternalDeclaration() {
     /// function define
     /// func param and block stmt share a scope
     mScope.pushScope();
+    llvm::SmallVector<uint32_t, 8> parameterIds;
     auto &parameterDeclarations = parameters->getParamTypeList()
                                       .getParameterList()
                                       .getParameterDeclarations();
@@ -338,15 +520,22 @@ std::optional<ExternalDeclaration> Parser::ParseExternalDeclaration() {
       }
       if (std::holds_alternative<std::optional<AbstractDeclarator>>(
               parameterDeclarator)) {
-        DiagReport(Diag, declSpecifiers.getBeginLoc()->getSMLoc(), diag::err_parse_func_param_declaration_miss_name);
+        DiagReport(Diag, declSpecifiers.getBeginLoc(), diag::err_parse_func_param_declaration_miss_name);
         continue;
       }
       auto &decl = std::get<Declarator>(parameterDeclarator);
-      mScope.addToScope(GetDeclaratorName(decl));
+      parameterIds.push_back(GetDeclaratorId(decl));
+      mScope.addToScope(parameterIds.back());
+    }
+    std::optional<BlockStmt> compoundStmt;
+    if (mSkipBodies && Peek(tok::l_brace) &&
+        mTokens.getMatch(mTokCursor.getIndex()) != TokenStream::NoMatch) {
+      compoundStmt = SkipFunctionBody(parameterIds);
+    } else {
+      compoundStmt = ParseBlockStmt();
     }
-    auto compoundStmt = ParseBlockStmt();
     mScope.popScope();
-    mScope.addToScope(GetDeclaratorName(*declarator));
+    mScope.addToScope(GetDeclaratorId(*declarator));
     if (compoundStmt) {
       return FunctionDefinition(begin, MV_(declSpecs), MV_(*declarator),
                                 MV_(*compoundStmt));
@@ -360,7 +549,7 @@ end:
 
 /// declaration: declaration-specifiers init-declarator-list{opt} ;
 std::optional<Declaration> Parser::ParseDeclaration() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   auto declSpecs = ParseDeclarationSpecifiers();
   if (declSpecs.isEmpty()) {
     DiagReport(Diag, mTokCursor->getSMLoc(),
@@ -374,14 +563,14 @@ std::optional<Declaration> Parser::ParseDeclaration() {
 }
 
 std::optional<StructOrUnionSpec> Parser::ParseStructOrUnionSpecifier() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   bool isUnion = false;
   if (Peek(tok::kw_union)) {
     isUnion = true;
   }
   ConsumeAny();
   std::string_view tagName;
-  auto start = mTokCursor;
+  auto start = mTokCursor->getSMLoc();
   switch (mTokCursor->getTokenKind()) {
   case tok::identifier: {
     tagName = mTokCursor->getRepresentation();
@@ -393,9 +582,10 @@ std::optional<StructOrUnionSpec> Parser::ParseStructOrUnionSpecifier() {
   }
   case tok::l_brace: {
   lbrace:
+    ValueReset enclosing(mEnclosingBrace, mTokCursor.getIndex());
     ConsumeAny();
     mScope.pushScope();
-    std::vector<StructOrUnionSpec::StructDeclaration> structDeclarations;
+    ArenaVector<StructOrUnionSpec::StructDeclaration> structDeclarations;
     while (IsCurrentIn(FirstStructDeclaration)) {
       auto decl = ParseStructDeclaration();
       if (decl) {
@@ -409,14 +599,14 @@ std::optional<StructOrUnionSpec> Parser::ParseStructOrUnionSpecifier() {
     return StructOrUnionSpec(begin, isUnion, tagName, MV_(structDeclarations));
   }
   default:
-    DiagReport(Diag, start->getSMLoc(), diag::err_parse_expect_n, "identifier or { after struct/union");
+    DiagReport(Diag, start, diag::err_parse_expect_n, "identifier or { after struct/union");
     return std::nullopt;
   }
 }
 
 std::optional<StructOrUnionSpec::StructDeclaration>
 Parser::ParseStructDeclaration() {
-  TokIter begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
 
   // to support struct {;},	empty struct/union declaration
   if (Peek(tok::semi)) {
@@ -426,15 +616,15 @@ Parser::ParseStructDeclaration() {
 
   auto specs = ParseDeclarationSpecifiers();
   if (specs.getStorageClassSpecifiers().size() > 0) {
-    DiagReport(Diag, begin->getSMLoc(),
+    DiagReport(Diag, begin,
                diag::err_parse_struct_declaration_appear_storage_class);
   }
   if (specs.getTypeSpecs().size() == 0 &&
       specs.getTypeQualifiers().size() == 0) {
-    DiagReport(Diag, begin->getSMLoc(),
+    DiagReport(Diag, begin,
                diag::err_parse_expect_type_specifier_or_qualifier);
   }
-  std::vector<StructOrUnionSpec::StructDeclarator> declarators;
+  ArenaVector<StructOrUnionSpec::StructDeclarator> declarators;
   bool first = true;
   do {
     if (first) {
@@ -454,12 +644,12 @@ Parser::ParseStructDeclaration() {
 
 std::optional<StructOrUnionSpec::StructDeclarator>
 Parser::ParseStructDeclarator() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   SetCheckTypedefType(false);
   auto declarator = ParseDeclarator();
   SetCheckTypedefType(true);
   if (declarator)
-    mScope.addToScope(GetDeclaratorName(*declarator));
+    mScope.addToScope(GetDeclaratorId(*declarator));
   if (Peek(tok::colon) && declarator) {
     ConsumeAny();
     auto constant = ParseConditionalExpr();
@@ -475,8 +665,12 @@ Parser::ParseStructDeclarator() {
 
 /// declarator: pointer{opt} direct-declarator
 std::optional<Declarator> Parser::ParseDeclarator() {
-  std::vector<Pointer> pointers;
-  auto begin = mTokCursor;
+  NestingLevel level(*this);
+  if (!level) {
+    return std::nullopt;
+  }
+  ArenaVector<Pointer> pointers;
+  auto begin = mTokCursor->getSMLoc();
   while (Peek(tok::star)) {
     pointers.push_back(ParsePointer());
   }
@@ -498,7 +692,7 @@ direct-declarator:
     direct-declarator ( parameter-type-list )
     direct-declarator ( identifier-list{opt} )
  */
-void Parser::ParseDirectDeclaratorSuffix(TokIter beginTokLoc, DirectDeclarator &directDeclarator) {
+void Parser::ParseDirectDeclaratorSuffix(llvm::SMLoc beginTokLoc, DirectDeclarator &directDeclarator) {
   while (Peek(tok::l_paren) || Peek(tok::l_square)) {
     switch (mTokCursor->getTokenKind()) {
     case tok::l_paren: {
@@ -523,23 +717,23 @@ void Parser::ParseDirectDeclaratorSuffix(TokIter beginTokLoc, DirectDeclarator &
       ConsumeAny();
       if (Peek(tok::kw_static)) {
         ConsumeAny();
-        std::vector<TypeQualifier> typeQualifiers;
+        ArenaVector<TypeQualifier> typeQualifiers;
         while (Peek(tok::kw_const) || Peek(tok::kw_volatile)
                || Peek(tok::kw_restrict)) {
           switch (mTokCursor->getTokenKind()) {
           case tok::kw_const: {
             typeQualifiers.push_back(
-                TypeQualifier(mTokCursor, TypeQualifier::Const));
+                TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Const));
             break;
           }
           case tok::kw_volatile: {
             typeQualifiers.push_back(
-                TypeQualifier(mTokCursor, TypeQualifier::Volatile));
+                TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Volatile));
             break;
           }
           case tok::kw_restrict: {
             typeQualifiers.push_back(
-                TypeQualifier(mTokCursor, TypeQualifier::Restrict));
+                TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Restrict));
             break;
           }
           default:
@@ -557,23 +751,23 @@ void Parser::ParseDirectDeclaratorSuffix(TokIter beginTokLoc, DirectDeclarator &
         break;
       }
 
-      std::vector<TypeQualifier> typeQualifiers;
+      ArenaVector<TypeQualifier> typeQualifiers;
       while (Peek(tok::kw_const) || Peek(tok::kw_volatile)
              || Peek(tok::kw_restrict)) {
         switch (mTokCursor->getTokenKind()) {
         case tok::kw_const: {
           typeQualifiers.push_back(
-              TypeQualifier(mTokCursor, TypeQualifier::Const));
+              TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Const));
           break;
         }
         case tok::kw_volatile: {
           typeQualifiers.push_back(
-              TypeQualifier(mTokCursor, TypeQualifier::Volatile));
+              TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Volatile));
           break;
         }
         case tok::kw_restrict: {
           typeQualifiers.push_back(
-              TypeQualifier(mTokCursor, TypeQualifier::Restrict));
+              TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Restrict));
           break;
         }
         default:
@@ -630,16 +824,17 @@ direct-declarator:
  */
 std::optional<DirectDeclarator> Parser::ParseDirectDeclarator() {
   std::optional<DirectDeclarator> directDeclarator{std::nullopt};
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   if (Peek(tok::identifier)) {
     auto name = mTokCursor->getRepresentation();
+    auto id = mTokCursor->getIdentifierId();
     if (IsCheckTypedefType()) {
-      if (mScope.checkIsTypedefInCurrentScope(name)) {
-        DiagReport(Diag, begin->getSMLoc(), diag::err_parse_expect_n, "identifier, but get a typedef type");
+      if (mScope.checkIsTypedefInCurrentScope(id)) {
+        DiagReport(Diag, begin, diag::err_parse_expect_n, "identifier, but get a typedef type");
       }
     }
     ConsumeAny();
-    directDeclarator = DirectDeclaratorIdent(begin, name);
+    directDeclarator = DirectDeclaratorIdent(begin, name, id);
   }else if (Peek(tok::l_paren)) {
     ConsumeAny();
     auto declarator = ParseDeclarator();
@@ -648,7 +843,7 @@ std::optional<DirectDeclarator> Parser::ParseDirectDeclarator() {
     }
     Expect(tok::r_paren);
   }else {
-    DiagReport(Diag, begin->getSMLoc(), diag::err_parse_expect_n, "identifier or (");
+    DiagReport(Diag, begin, diag::err_parse_expect_n, "identifier or (");
     return std::nullopt;
   }
 
@@ -662,7 +857,7 @@ parameter-type-list:
   parameter-list , ...
  */
 std::optional<ParamTypeList> Parser::ParseParameterTypeList() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   auto parameterList = ParseParameterList();
   bool hasEllipse = false;
   if (Peek(tok::comma)) {
@@ -682,8 +877,8 @@ parameter-list:
     parameter-list , parameter-declaration
  */
 std::optional<ParamList> Parser::ParseParameterList() {
-  std::vector<ParameterDeclaration> paramDecls;
-  auto begin = mTokCursor;
+  ArenaVector<ParameterDeclaration> paramDecls;
+  auto begin = mTokCursor->getSMLoc();
   auto declaration = ParseParameterDeclaration();
   if (declaration) {
     paramDecls.push_back(MV_(*declaration));
@@ -700,41 +895,31 @@ std::optional<ParamList> Parser::ParseParameterList() {
 }
 std::optional<ParameterDeclaration>
 Parser::ParseParameterDeclarationSuffix(DeclSpec &declSpec) {
-  auto begin = mTokCursor;
-  auto peekIsDeclarator = [this]()->bool{
-    /// consume pointer
-    while (Peek(tok::star)) {
-      ParsePointer();
-    }
-    if (!Peek(tok::identifier) && !Peek(tok::l_paren) && !Peek(tok::l_square)) {
-      /// ε  mean abstract declarator
-      return false;
-    }
-    /**
-      first direct dec set
-          tok::identifier, tok::l_paren
-      first direct abstract dec set
-          tok::l_paren, tok::l_square
-     */
-    if (Peek(tok::identifier)) {
-      return true;
-    }else if (Peek(tok::l_square)) {
-      return false;
-    }else {
-      while (Peek(tok::l_paren)) {
-        ConsumeAny();
-        switch (mTokCursor->getTokenKind()) {
-        case tok::identifier:
-          return true;
-        case tok::l_square:
-          return false;
-        default: {
-          break;
-        }
+  auto begin = mTokCursor->getSMLoc();
+  /// Past the pointers and ( ahead, a name makes it a declarator. One
+  /// right behind a ( that names a type starts a parameter list instead.
+  /// Only looks, the declarator is parsed from the start again.
+  auto peekIsDeclarator = [this]() -> bool {
+    int n = 0;
+    bool afterParen = false;
+    while (true) {
+      if (PeekN(n, tok::star)) {
+        ++n;
+        while (PeekN(n, tok::kw_const) || PeekN(n, tok::kw_restrict) ||
+               PeekN(n, tok::kw_volatile)) {
+          ++n;
         }
+        afterParen = false;
+      } else if (PeekN(n, tok::l_paren)) {
+        ++n;
+        afterParen = true;
+      } else {
+        break;
       }
     }
-    return false;
+    return PeekN(n, tok::identifier) &&
+           !(afterParen && mScope.isTypedefInScope(
+                               (mTokCursor + n)->getIdentifierId()));
   };
   if (peekIsDeclarator()) {
     auto dec = ParseDeclarator();
@@ -762,10 +947,10 @@ abstract-declarator:
     pointer{opt} direct-abstract-declarator
 */
 std::optional<ParameterDeclaration> Parser::ParseParameterDeclaration() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   auto specs = ParseDeclarationSpecifiers();
   if (specs.isEmpty()) {
-    DiagReport(Diag, begin->getSMLoc(), diag::err_parse_expect_storage_class_or_type_specifier_or_qualifier);
+    DiagReport(Diag, begin, diag::err_parse_expect_storage_class_or_type_specifier_or_qualifier);
   }
   /// abstract-declarator{opt}
   if (Peek(tok::comma) || Peek(tok::r_paren)) {
@@ -781,22 +966,22 @@ std::optional<ParameterDeclaration> Parser::ParseParameterDeclaration() {
     * type-qualifier-list{opt} pointer
  */
 Pointer Parser::ParsePointer() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::star);
-  std::vector<TypeQualifier> typeQualifier;
+  ArenaVector<TypeQualifier> typeQualifier;
   while (Peek(tok::kw_const) || Peek(tok::kw_restrict) ||
          Peek(tok::kw_volatile)) {
     switch (mTokCursor->getTokenKind()) {
     case tok::kw_const:
-      typeQualifier.push_back(TypeQualifier(mTokCursor, TypeQualifier::Const));
+      typeQualifier.push_back(TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Const));
       break;
     case tok::kw_restrict:
       typeQualifier.push_back(
-          TypeQualifier(mTokCursor, TypeQualifier::Restrict));
+          TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Restrict));
       break;
     case tok::kw_volatile:
       typeQualifier.push_back(
-          TypeQualifier(mTokCursor, TypeQualifier::Volatile));
+          TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Volatile));
       break;
     default:
       break;
@@ -812,8 +997,12 @@ Pointer Parser::ParsePointer() {
    pointer{opt} direct-abstract-declarator
  */
 std::optional<AbstractDeclarator> Parser::ParseAbstractDeclarator() {
-  std::vector<Pointer> pointers;
-  auto begin = mTokCursor;
+  NestingLevel level(*this);
+  if (!level) {
+    return std::nullopt;
+  }
+  ArenaVector<Pointer> pointers;
+  auto begin = mTokCursor->getSMLoc();
   while (Peek(tok::star)) {
     auto result = ParsePointer();
     pointers.push_back(std::move(result));
@@ -836,7 +1025,7 @@ std::optional<AbstractDeclarator> Parser::ParseAbstractDeclarator() {
 std::optional<DirectAbstractDeclarator>
 Parser::ParseDirectAbstractDeclaratorSuffix() {
   std::optional<DirectAbstractDeclarator> directAbstractDec{std::nullopt};
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   while (Peek(tok::l_paren) || Peek(tok::l_square)) {
     switch (mTokCursor->getTokenKind()) {
     case tok::l_paren: {
@@ -879,23 +1068,23 @@ Parser::ParseDirectAbstractDeclaratorSuffix() {
       /// direct-abstract-declarator{opt} [ static type-qualifier-list{opt} assignment-expression ]
       if (Peek(tok::kw_static)) {
         ConsumeAny();
-        std::vector<TypeQualifier> typeQualifiers;
+        ArenaVector<TypeQualifier> typeQualifiers;
         while (Peek(tok::kw_const) || Peek(tok::kw_volatile) ||
                Peek(tok::kw_restrict)) {
           switch (mTokCursor->getTokenKind()) {
           case tok::kw_const: {
             typeQualifiers.push_back(
-                TypeQualifier(mTokCursor, TypeQualifier::Const));
+                TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Const));
             break;
           }
           case tok::kw_volatile: {
             typeQualifiers.push_back(
-                TypeQualifier(mTokCursor, TypeQualifier::Volatile));
+                TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Volatile));
             break;
           }
           case tok::kw_restrict: {
             typeQualifiers.push_back(
-                TypeQualifier(mTokCursor, TypeQualifier::Restrict));
+                TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Restrict));
             break;
           }
           default:
@@ -913,23 +1102,23 @@ Parser::ParseDirectAbstractDeclaratorSuffix() {
         break;
       }
 
-      std::vector<TypeQualifier> typeQualifiers;
+      ArenaVector<TypeQualifier> typeQualifiers;
       while (Peek(tok::kw_const) || Peek(tok::kw_volatile) ||
              Peek(tok::kw_restrict)) {
         switch (mTokCursor->getTokenKind()) {
         case tok::kw_const: {
           typeQualifiers.push_back(
-              TypeQualifier(mTokCursor, TypeQualifier::Const));
+              TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Const));
           break;
         }
         case tok::kw_volatile: {
           typeQualifiers.push_back(
-              TypeQualifier(mTokCursor, TypeQualifier::Volatile));
+              TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Volatile));
           break;
         }
         case tok::kw_restrict: {
           typeQualifiers.push_back(
-              TypeQualifier(mTokCursor, TypeQualifier::Restrict));
+              TypeQualifier(mTokCursor->getSMLoc(), TypeQualifier::Restrict));
           break;
         }
         default:
@@ -1006,9 +1195,9 @@ std::optional<DirectAbstractDeclarator> Parser::ParseDirectAbstractDec() {
  *  identifier
  */
 std::optional<EnumSpecifier> Parser::ParseEnumSpecifier() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_enum);
-  std::vector<EnumSpecifier::Enumerator> enumerators;
+  ArenaVector<EnumSpecifier::Enumerator> enumerators;
   std::string_view tagName;
   if (Peek(tok::identifier)) {
     tagName = mTokCursor->getRepresentation();
@@ -1037,13 +1226,16 @@ std::optional<EnumSpecifier> Parser::ParseEnumSpecifier() {
 }
 
 std::optional<EnumSpecifier::Enumerator> Parser::ParseEnumerator() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   std::string_view enumValueName = mTokCursor->getRepresentation();
-  if (mScope.checkIsTypedefInCurrentScope(enumValueName)) {
-    DiagReport(Diag, mTokCursor->getSMLoc(), diag::err_parse_expect_n,
-               "identifier, but get a typedef type");
+  if (Peek(tok::identifier)) {
+    auto id = mTokCursor->getIdentifierId();
+    if (mScope.checkIsTypedefInCurrentScope(id)) {
+      DiagReport(Diag, mTokCursor->getSMLoc(), diag::err_parse_expect_n,
+                 "identifier, but get a typedef type");
+    }
+    mScope.addToScope(id);
   }
-  mScope.addToScope(enumValueName);
   Expect(tok::identifier);
   if (Peek(tok::equal)) {
     ConsumeAny();
@@ -1055,11 +1247,18 @@ std::optional<EnumSpecifier::Enumerator> Parser::ParseEnumerator() {
 }
 
 std::optional<BlockStmt> Parser::ParseBlockStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
+  ValueReset enclosing(mEnclosingBrace, Peek(tok::l_brace)
+                                            ? mTokCursor.getIndex()
+                                            : TokenStream::NoMatch);
   Expect(tok::l_brace);
-  std::vector<BlockItem> items;
+  ArenaVector<BlockItem> items;
   mScope.pushScope();
   while (IsFirstInBlockItem()) {
+    /// nor across a block item, a function body that is never closed must
+    /// not keep the rest of the file in the window
+    auto index = mTokCursor.getIndex();
+    mTokens.discardBefore(index == 0 ? 0 : index - 1);
     auto result = ParseBlockItem();
     if (result)
       items.push_back(std::move(*result));
@@ -1093,13 +1292,17 @@ std::optional<BlockItem> Parser::ParseBlockItem() {
     { initializer-list , }
  */
 std::optional<Initializer> Parser::ParseInitializer() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   if (!Peek(tok::l_brace)) {
     auto assignment = ParseAssignExpr();
     if (assignment) {
       return Initializer(begin, MV_(*assignment));
     }
   } else {
+    NestingLevel level(*this);
+    if (!level) {
+      return std::nullopt;
+    }
     Expect(tok::l_brace);
     auto initializerList = ParseInitializerList();
     if (Peek(tok::comma)) {
@@ -1128,8 +1331,8 @@ designator:
     . identifier
  */
 std::optional<InitializerList> Parser::ParseInitializerList() {
-  auto begin = mTokCursor;
-  std::vector<InitializerList::InitializerPair> initializerPairs;
+  auto begin = mTokCursor->getSMLoc();
+  ArenaVector<InitializerList::InitializerPair> initializerPairs;
   bool first = true;
   do {
     if (first) {
@@ -1137,6 +1340,23 @@ std::optional<InitializerList> Parser::ParseInitializerList() {
     } else {
       Expect(tok::comma);
     }
+    /// the bytes of an #embed resource, one element per byte
+    if (Peek(tok::embed_data)) {
+      auto loc = mTokCursor->getSMLoc();
+      auto bytes = std::get<llvm::ArrayRef<uint8_t>>(
+          mLiterals.get(mTokCursor->getLiteralIndex()));
+      ConsumeAny();
+      initializerPairs.push_back(
+          {std::nullopt,
+           Initializer(loc, ConstantArray(loc, ConstantArray::Variant(bytes)))});
+      continue;
+    }
+    if (auto constants = ParseConstantRun()) {
+      auto loc = constants->getBeginLoc();
+      initializerPairs.push_back(
+          {std::nullopt, Initializer(loc, MV_(*constants))});
+      continue;
+    }
     InitializerList::Designation designation;
     while (Peek(tok::l_square) || Peek(tok::period)) {
       if (Peek(tok::l_square)) {
@@ -1160,11 +1380,96 @@ std::optional<InitializerList> Parser::ParseInitializerList() {
     auto initializer = ParseInitializer();
     if (initializer)
       initializerPairs.push_back({MV_(designation), MV_(*initializer)});
-  } while (Peek(tok::comma));
+    /// a trailing comma belongs to the enclosing { initializer-list , }
+  } while (Peek(tok::comma) && !PeekN(1, tok::r_brace));
   return InitializerList{begin, MV_(initializerPairs)};
 }
 
+/**
+ A run of initializer-list elements that are plain constants, packed into a
+ ConstantArray. Short runs stay ordinary initializers, so small struct and
+ array initializers keep their usual shape. The cursor is left on the ',' or
+ '}' behind the last element of the run.
+ */
+std::optional<ConstantArray> Parser::ParseConstantRun() {
+  constexpr uint32_t MinConstantRun = 4;
+  /// tokens of the plain constant element at cursor offset n (a constant or
+  /// '-' constant, followed by ',' or '}'), 0 if there is none; its value
+  /// is in mLiterals.get(literal)
+  auto elementAt = [this](uint32_t n, uint32_t &literal) -> uint32_t {
+    uint32_t length = 1;
+    if (PeekN(n, tok::minus)) {
+      ++n;
+      ++length;
+    }
+    if (!PeekN(n, tok::numeric_constant) && !PeekN(n, tok::char_constant)) {
+      return 0;
+    }
+    if (!PeekN(n + 1, tok::comma) && !PeekN(n + 1, tok::r_brace)) {
+      return 0;
+    }
+    literal = (mTokCursor + n)->getLiteralIndex();
+    return length;
+  };
+  /// the run keeps the type of its first element
+  uint32_t literal = 0;
+  if (!elementAt(0, literal)) {
+    return std::nullopt;
+  }
+  size_t type = mLiterals.get(literal).index();
+  auto sameType = [&](uint32_t n) {
+    return elementAt(n, literal) && mLiterals.get(literal).index() == type;
+  };
+  /// bounded look ahead, a streamed token window stays small
+  for (uint32_t i = 1, n = elementAt(0, literal) + 1; i < MinConstantRun;
+       ++i) {
+    if (!PeekN(n - 1, tok::comma) || !sameType(n)) {
+      return std::nullopt;
+    }
+    n += elementAt(n, literal) + 1;
+  }
+
+  auto begin = mTokCursor->getSMLoc();
+  ConstantArray::Variant elements;
+  match(mLiterals.get(literal), [&](const auto &value) {
+    using T = std::decay_t<decltype(value)>;
+    if constexpr (std::is_constructible_v<ConstantArray::Variant,
+                                          ArenaVector<T>>) {
+      elements.emplace<ArenaVector<T>>();
+    } else {
+      LCC_UNREACHABLE;
+    }
+  });
+  while (true) {
+    bool negate = Peek(tok::minus);
+    if (negate) {
+      ConsumeAny();
+    }
+    match(mLiterals.get(mTokCursor->getLiteralIndex()), [&](const auto &value) {
+      using T = std::decay_t<decltype(value)>;
+      if constexpr (std::is_constructible_v<ConstantArray::Variant,
+                                            ArenaVector<T>>) {
+        /// unary minus in the constant's own type, as C evaluates it
+        std::get<ArenaVector<T>>(elements).push_back(
+            negate ? static_cast<T>(-value) : value);
+      } else {
+        LCC_UNREACHABLE;
+      }
+    });
+    ConsumeAny();
+    if (!Peek(tok::comma) || !sameType(1)) {
+      break;
+    }
+    ConsumeAny();
+  }
+  return ConstantArray(begin, MV_(elements));
+}
+
 std::optional<Stmt> Parser::ParseStmt() {
+  NestingLevel level(*this);
+  if (!level) {
+    return std::nullopt;
+  }
   if (Peek(tok::kw_if)) {
     return ParseIfStmt();
   } else if (Peek(tok::kw_do)) {
@@ -1194,49 +1499,71 @@ std::optional<Stmt> Parser::ParseStmt() {
     return ParseGotoStmt();
   } else {
     /// identifier : stmt
-    auto begin = mTokCursor;
-    if (Peek(tok::identifier)) {
+    if (Peek(tok::identifier) && PeekN(1, tok::colon)) {
+      auto begin = mTokCursor->getSMLoc();
+      auto name = mTokCursor->getRepresentation();
       ConsumeAny();
-      if (Peek(tok::colon)) {
-        ConsumeAny();
-        return Stmt(LabelStmt(begin, begin->getRepresentation()));
-      }else {
-        mTokCursor = begin;
-        return ParseExprStmt();
-      }
-    }else {
-      /// expr{opt};
-      return ParseExprStmt();
+      ConsumeAny();
+      return Stmt(LabelStmt(begin, name));
     }
+    /// expr{opt};
+    return ParseExprStmt();
   }
 }
 
 /// if ( expression ) statement
 /// if ( expression ) statement else statement
+///
+/// An else if chain is read in a loop and its IfStmts are built from the
+/// last one back, a chain of any length takes a single nesting level.
 std::optional<Stmt> Parser::ParseIfStmt() {
-  auto begin = mTokCursor;
-  Expect(tok::kw_if);
-  Expect(tok::l_paren);
-  auto expr = ParseExpr();
-  Expect(tok::r_paren);
-  auto thenStmt = ParseStmt();
-  if (Peek(tok::kw_else)) {
-    ConsumeAny();
-    auto elseStmt = ParseStmt();
-    if (expr && thenStmt && elseStmt) {
-      return Stmt{IfStmt(begin, MV_(*expr), MV_(*thenStmt), MV_(*elseStmt))};
+  struct Branch {
+    llvm::SMLoc begin;
+    std::optional<Expr> expr;
+    std::optional<Stmt> thenStmt;
+  };
+  std::vector<Branch> chain;
+  bool hasElse;
+  do {
+    auto begin = mTokCursor->getSMLoc();
+    Expect(tok::kw_if);
+    Expect(tok::l_paren);
+    auto expr = ParseExpr();
+    Expect(tok::r_paren);
+    auto thenStmt = ParseStmt();
+    chain.push_back({begin, MV_(expr), MV_(thenStmt)});
+    hasElse = Peek(tok::kw_else);
+    if (hasElse) {
+      ConsumeAny();
     }
-  } else {
-    if (expr && thenStmt) {
-      return Stmt{IfStmt(begin, MV_(*expr), MV_(*thenStmt))};
+  } while (hasElse && Peek(tok::kw_if));
+
+  std::optional<Stmt> elseStmt;
+  if (hasElse) {
+    elseStmt = ParseStmt();
+  }
+  /// an if with a broken part is dropped along with the ones around it
+  bool failed = hasElse && !elseStmt;
+  for (auto iter = chain.rbegin(); iter != chain.rend() && !failed; ++iter) {
+    if (!iter->expr || !iter->thenStmt) {
+      failed = true;
+    } else if (elseStmt) {
+      elseStmt = Stmt{IfStmt(iter->begin, MV_(*iter->expr),
+                             MV_(*iter->thenStmt), MV_(*elseStmt))};
+    } else {
+      elseStmt = Stmt{IfStmt(iter->begin, MV_(*iter->expr),
+                             MV_(*iter->thenStmt))};
     }
   }
-  return std::nullopt;
+  if (failed) {
+    return std::nullopt;
+  }
+  return elseStmt;
 }
 
 /// while ( expression ) statement
 std::optional<Stmt> Parser::ParseWhileStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_while);
   Expect(tok::l_paren);
   auto expr = ParseExpr();
@@ -1250,7 +1577,7 @@ std::optional<Stmt> Parser::ParseWhileStmt() {
 
 /// do statement while ( expression ) ;
 std::optional<Stmt> Parser::ParseDoWhileStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_do);
   auto stmt = ParseStmt();
   Expect(tok::kw_while);
@@ -1267,7 +1594,7 @@ std::optional<Stmt> Parser::ParseDoWhileStmt() {
 /// for ( expression{opt} ; expression{opt} ; expression{opt} ) statement
 /// for ( declaration expression{opt} ; expression{opt} ) statement
 std::optional<Stmt> Parser::ParseForStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_for);
   Expect(tok::l_paren);
   auto blockItem = ParseBlockItem();
@@ -1315,7 +1642,7 @@ std::optional<Stmt> Parser::ParseForStmt() {
 
 /// break;
 std::optional<Stmt> Parser::ParseBreakStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_break);
   Expect(tok::semi);
   return Stmt{BreakStmt(begin)};
@@ -1323,7 +1650,7 @@ std::optional<Stmt> Parser::ParseBreakStmt() {
 
 /// continue;
 std::optional<Stmt> Parser::ParseContinueStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_continue);
   Expect(tok::semi);
   return Stmt{ContinueStmt(begin)};
@@ -1331,7 +1658,7 @@ std::optional<Stmt> Parser::ParseContinueStmt() {
 
 /// return expr{opt};
 std::optional<Stmt> Parser::ParseReturnStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_return);
   if (Peek(tok::semi)) {
     ConsumeAny();
@@ -1346,7 +1673,7 @@ std::optional<Stmt> Parser::ParseReturnStmt() {
 
 /// expr;
 std::optional<Stmt> Parser::ParseExprStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   if (Peek(tok::semi)) {
     ConsumeAny();
     return Stmt(ExprStmt(begin));
@@ -1361,7 +1688,7 @@ std::optional<Stmt> Parser::ParseExprStmt() {
 
 /// switch ( expression ) statement
 std::optional<Stmt> Parser::ParseSwitchStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_switch);
   Expect(tok::l_paren);
   auto expr = ParseExpr();
@@ -1375,7 +1702,7 @@ std::optional<Stmt> Parser::ParseSwitchStmt() {
 
 /// case constantExpr: stmt
 std::optional<Stmt> Parser::ParseCaseStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_case);
   auto expr = ParseConditionalExpr();
   Expect(tok::colon);
@@ -1388,7 +1715,7 @@ std::optional<Stmt> Parser::ParseCaseStmt() {
 
 /// default: stmt
 std::optional<Stmt> Parser::ParseDefaultStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_default);
   Expect(tok::colon);
   auto stmt = ParseStmt();
@@ -1400,7 +1727,7 @@ std::optional<Stmt> Parser::ParseDefaultStmt() {
 
 /// goto identifier;
 std::optional<Stmt> Parser::ParseGotoStmt() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   Expect(tok::kw_goto);
   auto name = mTokCursor->getRepresentation();
   Expect(tok::identifier);
@@ -1414,8 +1741,8 @@ std::optional<Stmt> Parser::ParseGotoStmt() {
     expression , assignment-expression
  */
 std::optional<Expr> Parser::ParseExpr() {
-  std::vector<AssignExpr> assignExprs;
-  auto begin = mTokCursor;
+  ArenaVector<AssignExpr> assignExprs;
+  auto begin = GetExprBeginLoc();
 
   bool first = true;
   do {
@@ -1424,6 +1751,12 @@ std::optional<Expr> Parser::ParseExpr() {
     } else {
       ConsumeAny();
     }
+    if (Peek(tok::embed_data)) {
+      for (auto &byte : ParseEmbedData()) {
+        assignExprs.push_back(MV_(byte));
+      }
+      continue;
+    }
     auto assignExpr = ParseAssignExpr();
     if (assignExpr) {
       assignExprs.push_back(MV_(*assignExpr));
@@ -1433,6 +1766,28 @@ std::optional<Expr> Parser::ParseExpr() {
   return Expr(begin, MV_(assignExprs));
 }
 
+/**
+ An #embed resource outside an initializer list stands for its bytes as a
+ comma separated list of integer constants of type int, one assignment
+ expression per byte.
+ */
+ArenaVector<AssignExpr> Parser::ParseEmbedData() {
+  auto loc = mTokCursor->getSMLoc();
+  auto bytes = std::get<llvm::ArrayRef<uint8_t>>(
+      mLiterals.get(mTokCursor->getLiteralIndex()));
+  ConsumeAny();
+  ArenaVector<AssignExpr> assignExprs;
+  assignExprs.reserve(bytes.size());
+  for (uint8_t byte : bytes) {
+    PrimaryExprConstant constant(loc, static_cast<int32_t>(byte));
+    CastExpr castExpr(loc, UnaryExpr(PostFixExpr(PrimaryExpr(MV_(constant)))));
+    assignExprs.emplace_back(
+        loc, CondExpr(loc, MV_(castExpr)),
+        ArenaVector<std::pair<AssignExpr::AssignOp, CondExpr>>());
+  }
+  return assignExprs;
+}
+
 /**
  * assignment-expression:
  *      conditional-expression
@@ -1449,17 +1804,17 @@ std::optional<Expr> Parser::ParseExpr() {
  *      conditional-expression assignment-operator assignment-expression
  */
 std::optional<AssignExpr> Parser::ParseAssignExpr() {
-  auto begin = mTokCursor;
+  auto begin = GetExprBeginLoc();
   auto firstCondExpr = ParseConditionalExpr();
   if (!firstCondExpr) {
     return std::nullopt;
   }
-  std::vector<std::pair<AssignExpr::AssignOp, CondExpr>> list;
+  ArenaVector<std::pair<AssignExpr::AssignOp, CondExpr>> list;
   while (IsAssignOp(mTokCursor->getTokenKind())) {
-    auto token = mTokCursor;
+    auto tokenKind = mTokCursor->getTokenKind();
     ConsumeAny();
-    auto assignOp = [token]() -> AssignExpr::AssignOp {
-      switch (token->getTokenKind()){
+    auto assignOp = [tokenKind]() -> AssignExpr::AssignOp {
+      switch (tokenKind){
       case tok::equal:
         return AssignExpr::AssignOp::Assign;
       case tok::plus_equal:
@@ -1499,8 +1854,8 @@ std::optional<AssignExpr> Parser::ParseAssignExpr() {
  *      logical-OR-expression ? expression : conditional-expression
  */
 std::optional<CondExpr> Parser::ParseConditionalExpr() {
-  auto begin = mTokCursor;
-  auto logOrExpr = ParseLogOrExpr();
+  auto begin = GetExprBeginLoc();
+  auto logOrExpr = ParseBinaryExpr();
   if (!logOrExpr)
     return std::nullopt;
 
@@ -1517,303 +1872,83 @@ std::optional<CondExpr> Parser::ParseConditionalExpr() {
   return CondExpr(begin, MV_(*logOrExpr));
 }
 
-/**
- * logical-OR-expression:
- *      logical-AND-expression
- *      logical-OR-expression || logical-AND-expression
- */
-std::optional<LogOrExpr> Parser::ParseLogOrExpr() {
-  std::vector<LogAndExpr> logAndExprArr;
-  auto begin = mTokCursor;
-  bool first = true;
-  do {
-    if (first) {
-      first = false;
-    } else {
-      ConsumeAny();
-    }
-    auto logAndExpr = ParseLogAndExpr();
-    if (logAndExpr)
-      logAndExprArr.push_back(MV_(*logAndExpr));
-  } while (Peek(tok::pipe_pipe));
-
-  if (logAndExprArr.empty()) {
-    return std::nullopt;
-  }
-
-  return LogOrExpr(begin, MV_(logAndExprArr));
-}
-
-/**
- * logical-AND-expression:
- *      inclusive-OR-expression
- *      logical-AND-expression && inclusive-OR-expression
- */
-std::optional<LogAndExpr> Parser::ParseLogAndExpr() {
-  auto begin = mTokCursor;
-  std::vector<BitOrExpr> bitOrExprArr;
-  bool first = true;
-  do {
-    if (first) {
-      first = false;
-    } else {
-      ConsumeAny();
-    }
-    auto bitOrExpr = ParseBitOrExpr();
-    if (bitOrExpr)
-      bitOrExprArr.push_back(MV_(*bitOrExpr));
-  } while (Peek(tok::amp_amp));
-
-  if (bitOrExprArr.empty()) {
-    return std::nullopt;
-  }
-
-  return LogAndExpr(begin, MV_(bitOrExprArr));
-}
-
-/**
- * inclusive-OR-expression:
- *      exclusive-OR-expression
- *      inclusive-OR-expression | exclusive-OR-expression
- */
-std::optional<BitOrExpr> Parser::ParseBitOrExpr() {
-  auto begin = mTokCursor;
-  std::vector<BitXorExpr> bitXorExprArr;
-  bool first = true;
-  do {
-    if (first) {
-      first = false;
-    } else {
-      ConsumeAny();
-    }
-    auto bitXorExpr = ParseBitXorExpr();
-    if (bitXorExpr) {
-      bitXorExprArr.push_back(MV_(*bitXorExpr));
-    }
-  } while (Peek(tok::pipe));
-
-  if (bitXorExprArr.empty())
-    return std::nullopt;
-
-  return BitOrExpr(begin, MV_(bitXorExprArr));
-}
-
-std::optional<BitXorExpr> Parser::ParseBitXorExpr() {
-  auto begin = mTokCursor;
-  std::vector<BitAndExpr> bitAndExprArr;
-  bool first = true;
-  do {
-    if (first) {
-      first = false;
-    } else {
-      ConsumeAny();
-    }
-    auto bitAndExpr = ParseBitAndExpr();
-    if (bitAndExpr) {
-      bitAndExprArr.push_back(MV_(*bitAndExpr));
-    }
-  } while (Peek(tok::caret));
-
-  if (bitAndExprArr.empty())
-    return std::nullopt;
-
-  return BitXorExpr(begin, MV_(bitAndExprArr));
-}
-
-/**
- * AND-expression:
- *      equality-expression
- *      AND-expression & equality-expression
- */
-std::optional<BitAndExpr> Parser::ParseBitAndExpr() {
-  auto begin = mTokCursor;
-  std::vector<EqualExpr> equalExprArr;
-  bool first = true;
-  do {
-    if (first) {
-      first = false;
-    } else {
-      ConsumeAny();
-    }
-    auto equalExpr = ParseEqualExpr();
-    if (equalExpr) {
-      equalExprArr.push_back(MV_(*equalExpr));
-    }
-  } while (Peek(tok::amp));
-
-  if (equalExprArr.empty()) {
-    return std::nullopt;
-  }
-  return BitAndExpr(begin, MV_(equalExprArr));
-}
-
-/**
- * equality-expression:
- *      relational-expression
- *      equality-expression == relational-expression
- *      equality-expression != relational-expression
- */
-std::optional<EqualExpr> Parser::ParseEqualExpr() {
-  auto begin = mTokCursor;
-  auto firstRelationalExpr = ParseRelationalExpr();
-  if (!firstRelationalExpr) {
-    return std::nullopt;
-  }
-  std::vector<std::pair<EqualExpr::Op, RelationalExpr>> relationalExprs;
-  while (Peek(tok::equal_equal) || Peek(tok::exclaim_equal)) {
-    tok::TokenKind tokenType = mTokCursor->getTokenKind();
-    EqualExpr::Op equalOp;
-    if (tokenType == tok::equal_equal) {
-      equalOp = EqualExpr::Op::Equal;
-    }else {
-      equalOp = EqualExpr::Op::NotEqual;
-    }
-    ConsumeAny();
-    auto relationalExpr = ParseRelationalExpr();
-    if (relationalExpr) {
-      relationalExprs.emplace_back(equalOp, MV_(*relationalExpr));
-    }
-  }
-  return EqualExpr(begin, MV_(*firstRelationalExpr), MV_(relationalExprs));
-}
-
-/**
- * relational-expression:
- *      shift-expression
- *      relational-expression < shift-expression
- *      relational-expression > shift-expression
- *      relational-expression <= shift-expression
- *      relational-expression >= shift-expression
- */
-std::optional<RelationalExpr> Parser::ParseRelationalExpr() {
-  auto begin = mTokCursor;
-  auto firstShiftExpr = ParseShiftExpr();
-  if (!firstShiftExpr)
-    return {std::nullopt};
-
-  std::vector<std::pair<RelationalExpr::Op, ShiftExpr>> relationalExprArr;
-  while (Peek(tok::less) || Peek(tok::less_equal) ||
-         Peek(tok::greater) || Peek(tok::greater_equal)) {
-    tok::TokenKind tokenType = mTokCursor->getTokenKind();
-    auto relationalOp = [tokenType]() -> RelationalExpr::Op {
-      switch (tokenType) {
-      case tok::less:
-        return RelationalExpr::Op::LessThan;
-      case tok::less_equal:
-        return RelationalExpr::Op::LessThanOrEqual;
-      case tok::greater:
-        return RelationalExpr::Op::GreaterThan;
-      case tok::greater_equal:
-        return RelationalExpr::Op::GreaterThanOrEqual;
-      default:
-        LCC_UNREACHABLE;
-      }
-    }();
-    ConsumeAny();
-    auto shiftExpr = ParseShiftExpr();
-    if (shiftExpr) {
-      relationalExprArr.emplace_back(relationalOp, MV_(*shiftExpr));
-    }
-  }
-
-  return RelationalExpr(begin, MV_(*firstShiftExpr), MV_(relationalExprArr));
-}
-
-/**
- * shift-expression:
- *      additive-expression
- *      shift-expression << additive-expression
- *      shift-expression >> additive-expression
- */
-std::optional<ShiftExpr> Parser::ParseShiftExpr() {
-  auto begin = mTokCursor;
-  auto firstAdditiveExpr = ParseAdditiveExpr();
-  if (!firstAdditiveExpr)
-    return {std::nullopt};
-
-  std::vector<std::pair<ShiftExpr::Op, AdditiveExpr>> additiveExprArr;
-  while (Peek(tok::less_less) || Peek(tok::greater_greater)) {
-    tok::TokenKind tokenType = mTokCursor->getTokenKind();
-    ShiftExpr::Op op;
-    if (tokenType == tok::less_less) {
-      op = ShiftExpr::Op::Left;
-    }else {
-      op = ShiftExpr::Op::Right;
-    }
-    ConsumeAny();
-    auto additiveExpr = ParseAdditiveExpr();
-    if (additiveExpr) {
-      additiveExprArr.emplace_back(op, MV_(*additiveExpr));
-    }
-  }
-  return ShiftExpr(begin, MV_(*firstAdditiveExpr), MV_(additiveExprArr));
-}
-
-/**
- * additive-expression:
- * multiplicative-expression
- * additive-expression + multiplicative-expression
- * additive-expression - multiplicative-expression
- */
-std::optional<AdditiveExpr> Parser::ParseAdditiveExpr() {
-  auto begin = mTokCursor;
-  auto firstMultiExpr = ParseMultiExpr();
-  if (!firstMultiExpr)
+/// the binary operator token \p kind spells, if it is one
+static std::optional<BinaryExpr::Op> getBinaryOp(tok::TokenKind kind) {
+  switch (kind) {
+  case tok::star:
+    return BinaryExpr::Multiply;
+  case tok::slash:
+    return BinaryExpr::Divide;
+  case tok::percent:
+    return BinaryExpr::Modulo;
+  case tok::plus:
+    return BinaryExpr::Plus;
+  case tok::minus:
+    return BinaryExpr::Minus;
+  case tok::less_less:
+    return BinaryExpr::LeftShift;
+  case tok::greater_greater:
+    return BinaryExpr::RightShift;
+  case tok::less:
+    return BinaryExpr::LessThan;
+  case tok::less_equal:
+    return BinaryExpr::LessThanOrEqual;
+  case tok::greater:
+    return BinaryExpr::GreaterThan;
+  case tok::greater_equal:
+    return BinaryExpr::GreaterThanOrEqual;
+  case tok::equal_equal:
+    return BinaryExpr::Equal;
+  case tok::exclaim_equal:
+    return BinaryExpr::NotEqual;
+  case tok::amp:
+    return BinaryExpr::BitAnd;
+  case tok::caret:
+    return BinaryExpr::BitXor;
+  case tok::pipe:
+    return BinaryExpr::BitOr;
+  case tok::amp_amp:
+    return BinaryExpr::LogicalAnd;
+  case tok::pipe_pipe:
+    return BinaryExpr::LogicalOr;
+  default:
     return std::nullopt;
-
-  std::vector<std::pair<AdditiveExpr::Op, MultiExpr>> multiExprArr;
-  while (Peek(tok::plus) || Peek(tok::minus)) {
-    tok::TokenKind tokenType = mTokCursor->getTokenKind();
-    AdditiveExpr::Op op;
-    if (tokenType == tok::plus) {
-      op = AdditiveExpr::Op::Plus;
-    }else {
-      op = AdditiveExpr::Op::Minus;
-    }
-    ConsumeAny();
-    auto multiExpr = ParseMultiExpr();
-    if (multiExpr) {
-      multiExprArr.emplace_back(op, MV_(*multiExpr));
-    }
   }
-  return AdditiveExpr(begin, MV_(*firstMultiExpr), MV_(multiExprArr));
 }
 
 /**
+ * logical-OR-expression:
+ *      logical-AND-expression
+ *      logical-OR-expression || logical-AND-expression
+ * ...
  * multiplicative-expression:
- *  cast-expression
- *  multiplicative-expression * cast-expression
- *  multiplicative-expression / cast-expression
- *  multiplicative-expression % cast-expression
+ *      cast-expression
+ *      multiplicative-expression * cast-expression
+ *
+ * All ten levels by precedence climbing: operators of \p minPrecedence or
+ * tighter are folded into the left operand as they come, the right operand
+ * of each takes only tighter ones. An operand is a single cast-expression
+ * call, however many levels lie between it and the caller.
  */
-std::optional<MultiExpr> Parser::ParseMultiExpr() {
-  auto begin = mTokCursor;
-  auto firstCastExpr = ParseCastExpr();
-  if (!firstCastExpr) {
+std::optional<BinaryOperand> Parser::ParseBinaryExpr(unsigned minPrecedence) {
+  auto begin = GetExprBeginLoc();
+  auto castExpr = ParseCastExpr();
+  if (!castExpr) {
     return std::nullopt;
   }
-  std::vector<std::pair<MultiExpr::Op, CastExpr>> castExprArr;
-  while (Peek(tok::star) || Peek(tok::slash) || Peek(tok::percent)) {
-    tok::TokenKind tokenType = mTokCursor->getTokenKind();
-    auto op = [tokenType]() -> MultiExpr::Op {
-      switch (tokenType) {
-      case tok::star:
-        return MultiExpr::Op::Multiply;
-      case tok::slash:
-        return MultiExpr::Op::Divide;
-      case tok::percent:
-        return MultiExpr::Op::Modulo;
-      default:
-        LCC_UNREACHABLE;
-      }
-    }();
+  BinaryOperand lhs(MV_(*castExpr));
+  while (auto op = getBinaryOp(mTokCursor->getTokenKind())) {
+    unsigned precedence = BinaryExpr::getPrecedence(*op);
+    if (precedence < minPrecedence) {
+      break;
+    }
     ConsumeAny();
-    auto castExpr = ParseCastExpr();
-    if (castExpr) {
-      castExprArr.emplace_back(op, MV_(*castExpr));
+    auto rhs = ParseBinaryExpr(precedence + 1);
+    if (rhs) {
+      lhs = BinaryExpr(begin, *op, MV_(lhs), MV_(*rhs));
     }
   }
-  return MultiExpr(begin, MV_(*firstCastExpr), MV_(castExprArr));
+  return lhs;
 }
 
 /**
@@ -1821,14 +1956,14 @@ std::optional<MultiExpr> Parser::ParseMultiExpr() {
  *  specifier-qualifier-list abstract-declarator{opt}
  */
 std::optional<TypeName> Parser::ParseTypeName() {
-  auto begin = mTokCursor;
+  auto begin = mTokCursor->getSMLoc();
   auto specs = ParseDeclarationSpecifiers();
   if (specs.getStorageClassSpecifiers().size() > 0) {
-    DiagReport(Diag, begin->getSMLoc(), diag::err_parse_type_name_appear_storage_class);
+    DiagReport(Diag, begin, diag::err_parse_type_name_appear_storage_class);
   }
   if (specs.getTypeSpecs().size() == 0 &&
       specs.getTypeQualifiers().size() == 0) {
-    DiagReport(Diag, begin->getSMLoc(), diag::err_parse_expect_type_specifier_or_qualifier);
+    DiagReport(Diag, begin, diag::err_parse_expect_type_specifier_or_qualifier);
   }
 
   if (IsFirstInAbstractDeclarator()) {
@@ -1849,9 +1984,10 @@ std::optional<TypeName> Parser::ParseTypeName() {
  * (unsigned char)(h ? h->height + 1 : 0);
  */
 std::optional<CastExpr> Parser::ParseCastExpr() {
-  auto begin = mTokCursor;
+  auto beginCursor = mTokCursor;
+  auto begin = GetExprBeginLoc();
   // cast-expression: unary-expression
-  if (!Peek(tok::l_paren)) {
+  if (mLeadingOperand || !Peek(tok::l_paren)) {
     auto unary = ParseUnaryExpr();
     if (!unary) {
       return std::nullopt;
@@ -1863,7 +1999,7 @@ std::optional<CastExpr> Parser::ParseCastExpr() {
 
   if (!IsFirstInTypeName()) {
     // cast-expression: unary-expression
-    mTokCursor = begin;
+    mTokCursor = beginCursor;
     auto unary = ParseUnaryExpr();
     if (!unary) {
       return std::nullopt;
@@ -1871,12 +2007,16 @@ std::optional<CastExpr> Parser::ParseCastExpr() {
     return CastExpr(begin, MV_(*unary));
   }else {
     // cast-expression: ( type-name ) cast-expression
+    NestingLevel level(*this);
+    if (!level) {
+      return std::nullopt;
+    }
     auto typeName = ParseTypeName();
     Expect(tok::r_paren);
     auto cast = ParseCastExpr();
     if (typeName && cast) {
-      return CastExpr(begin,
-                      CastExpr::TypeNameCast{MV_(*typeName), MV_(*cast)});
+      return CastExpr(begin, box<CastExpr::TypeNameCast>(CastExpr::TypeNameCast{
+                                 MV_(*typeName), MV_(*cast)}));
     }
     return std::nullopt;
   }
@@ -1895,17 +2035,31 @@ std::optional<CastExpr> Parser::ParseCastExpr() {
  *      & * + - ~ !
  */
 std::optional<UnaryExpr> Parser::ParseUnaryExpr() {
-  TokIter begin = mTokCursor;
-  if (Peek(tok::kw_sizeof)) {
+  NestingLevel level(*this);
+  if (!level) {
+    return std::nullopt;
+  }
+  auto begin = GetExprBeginLoc();
+  if (mLeadingOperand) {
+    auto postFix = ParsePostFixExpr();
+    if (postFix) {
+      return UnaryExpr(MV_(*postFix));
+    }
+  } else if (Peek(tok::kw_sizeof)) {
     ConsumeAny();
+    auto open = mTokCursor;
     if (Peek(tok::l_paren)) {
       ConsumeAny();
+    }
+    if (open->getTokenKind() == tok::l_paren && IsFirstInTypeName()) {
       auto type = ParseTypeName();
       Expect(tok::r_paren);
       if (type) {
         return UnaryExpr(UnaryExprSizeOf(begin, MV_(*type)));
       }
     } else {
+      /// sizeof (x) is of a parenthesized expression
+      mTokCursor = open;
       auto unary = ParseUnaryExpr();
       if (unary) {
         return UnaryExpr(UnaryExprSizeOf(begin, MV_(*unary)));
@@ -1937,7 +2091,7 @@ std::optional<UnaryExpr> Parser::ParseUnaryExpr() {
     }();
     ConsumeAny();
     auto castExpr = ParseCastExpr();
-    if (!castExpr) {
+    if (castExpr) {
       return UnaryExpr(UnaryExprUnaryOperator(begin, unaryOp, MV_(*castExpr)));
     }
   } else {
@@ -1962,25 +2116,36 @@ std::optional<UnaryExpr> Parser::ParseUnaryExpr() {
  *    ( type-name ) { initializer-list , }
  */
 
-void Parser::ParsePostFixExprSuffix(TokIter beginTokLoc,
+void Parser::ParsePostFixExprSuffix(llvm::SMLoc beginTokLoc,
                                     PostFixExpr &postFixExpr) {
   while (IsPostFixExpr(mTokCursor->getTokenKind())) {
     auto tokType = mTokCursor->getTokenKind();
     if (tokType == tok::l_paren) {
       ConsumeAny();
-      std::vector<box<AssignExpr>> params;
+      ArenaVector<box<AssignExpr>> params;
       bool first = true;
       do {
+        auto argBegin = mTokCursor.getIndex();
         if (first) {
           first = false;
         } else {
           Expect(tok::comma);
         }
+        if (Peek(tok::embed_data)) {
+          for (auto &byte : ParseEmbedData()) {
+            params.push_back(MV_(byte));
+          }
+          continue;
+        }
         auto assignExpr = ParseAssignExpr();
         if (assignExpr) {
           params.push_back(MV_(*assignExpr));
         }
-      } while (!Peek(tok::r_paren));
+        /// an argument that consumed nothing would be tried again forever
+        if (mTokCursor.getIndex() == argBegin) {
+          break;
+        }
+      } while (!Peek(tok::r_paren) && !Peek(tok::eof));
 
       Expect(tok::r_paren);
       postFixExpr =
@@ -2029,17 +2194,24 @@ std::optional<PostFixExpr> Parser::ParsePostFixExpr() {
   std::optional<PostFixExpr> postFixExpr{std::nullopt};
   std::optional<PrimaryExpr> primaryExpr{std::nullopt};
 
-  TokIter beginTokLoc = mTokCursor;
-  if (Peek(tok::identifier)) {
+  auto beginTokLoc = GetExprBeginLoc();
+  if (mLeadingOperand) {
+    primaryExpr = MV_(*mLeadingOperand);
+    mLeadingOperand.reset();
+  } else if (Peek(tok::identifier)) {
     auto name = mTokCursor->getRepresentation();
     primaryExpr = PrimaryExprIdent(beginTokLoc, name);
     ConsumeAny();
   }else if (Peek(tok::char_constant) || Peek(tok::numeric_constant) || Peek(tok::string_literal)) {
     using PrimExprConstantValueType = PrimaryExprConstant::Variant;
     auto value = match(
-        mTokCursor->getValue(), [](auto &&value) -> PrimExprConstantValueType {
+        mLiterals.get(mTokCursor->getLiteralIndex()),
+        [](auto &&value) -> PrimExprConstantValueType {
           using T = std::decay_t<decltype(value)>;
-          if constexpr (std::is_constructible_v<PrimExprConstantValueType, T>) {
+          if constexpr (std::is_same_v<T, std::string>) {
+            return ASTContext::current().copyString(value);
+          } else if constexpr (std::is_constructible_v<
+                                   PrimExprConstantValueType, T>) {
             return std::forward<decltype(value)>(value);
           } else {
             LCC_UNREACHABLE;
@@ -2050,10 +2222,30 @@ std::optional<PostFixExpr> Parser::ParsePostFixExpr() {
   }else if (Peek(tok::l_paren)) {
     ConsumeAny();
     if (!IsFirstInTypeName()) {
-      auto expr = ParseExpr();
-      Expect(tok::r_paren);
-      if (expr) {
-        primaryExpr = PrimaryExprParentheses(beginTokLoc, MV_(*expr));
+      /// a run of ( ( ( opening parenthesized expressions is kept on a
+      /// stack instead of taking a call per level: the innermost
+      /// expression is parsed first, then each enclosing one from the
+      /// parentheses just closed on
+      llvm::SmallVector<llvm::SMLoc, 4> opens{beginTokLoc};
+      while (Peek(tok::l_paren)) {
+        auto open = mTokCursor;
+        ConsumeAny();
+        if (IsFirstInTypeName()) {
+          mTokCursor = open;
+          break;
+        }
+        opens.push_back(open->getSMLoc());
+      }
+      while (true) {
+        auto expr = ParseExpr();
+        mLeadingOperand.reset();
+        Expect(tok::r_paren);
+        PrimaryExprParentheses parentheses(opens.pop_back_val(), MV_(*expr));
+        if (opens.empty()) {
+          primaryExpr = MV_(parentheses);
+          break;
+        }
+        mLeadingOperand = MV_(parentheses);
       }
     } else {
       auto type = ParseTypeName();
@@ -2069,6 +2261,9 @@ std::optional<PostFixExpr> Parser::ParsePostFixExpr() {
                                                  MV_(*initializer));
       }
     }
+  }else if (Peek(tok::embed_data)) {
+    DiagReport(Diag, beginTokLoc, diag::err_parse_embed_outside_initializer_list);
+    ConsumeAny();
   }else {
     DiagReport(Diag, mTokCursor->getSMLoc(), diag::err_parse_expect_n, "primary expr or ( type-name )");
   }
@@ -2086,6 +2281,35 @@ std::optional<PostFixExpr> Parser::ParsePostFixExpr() {
   return postFixExpr;
 }
 
+bool Parser::EnterNesting() {
+  if (++mNestingDepth <= mMaxNestingDepth) {
+    return true;
+  }
+  /// the first level too many reports, the ones after it meet the eof
+  if (!Peek(tok::eof)) {
+    DiagReport(Diag, mTokCursor->getSMLoc(), diag::err_parse_nesting_too_deep,
+               mMaxNestingDepth);
+    CutOffParsing();
+  }
+  return false;
+}
+
+/// Moves to the end of the input, every parse function on the stack then
+/// returns at the eof. What they would report about it is noise.
+void Parser::CutOffParsing() {
+  Diag.suppressAllDiagnostics();
+  while (!Peek(tok::eof)) {
+    ConsumeAny();
+  }
+}
+
+llvm::SMLoc Parser::GetExprBeginLoc() {
+  if (mLeadingOperand) {
+    return mLeadingOperand->getBeginLoc();
+  }
+  return mTokCursor->getSMLoc();
+}
+
 bool Parser::IsAssignOp(tok::TokenKind type) {
   return type == tok::equal || type == tok::plus_equal ||
          type == tok::minus_equal || type == tok::star_equal ||
@@ -2100,7 +2324,8 @@ bool Parser::Expect(tok::TokenKind tokenType) {
     ConsumeAny();
     return true;
   }
-  DiagReport(Diag, (mTokCursor-1)->getSMLoc(), diag::err_parse_expect_n_after, tok::getTokenName(tokenType));
+  auto prev = mTokCursor.getIndex() == 0 ? mTokCursor : mTokCursor - 1;
+  DiagReport(Diag, prev->getSMLoc(), diag::err_parse_expect_n_after, tok::getTokenName(tokenType));
   return false;
 }
 
@@ -2109,20 +2334,11 @@ bool Parser::ConsumeAny() {
   return true;
 }
 bool Parser::Peek(tok::TokenKind tokenType) {
-  if (mTokCursor >= mTokEnd) {
-    return false;
-  }
   return mTokCursor->getTokenKind() == tokenType;
 }
 
 bool Parser::PeekN(int n, tok::TokenKind tokenType) {
-  if (n == 0) {
-    return Peek(tokenType);
-  }
-  if (mTokCursor + n >= mTokEnd) {
-    return false;
-  }
-  return (mTokCursor+n)->getTokenKind() == tokenType;
+  return (mTokCursor + n)->getTokenKind() == tokenType;
 }
 
 bool Parser::IsUnaryOp(tok::TokenKind tokenType) {
@@ -2135,92 +2351,112 @@ bool Parser::IsUnaryOp(tok::TokenKind tokenType) {
   return false;
 }
 
+/// the tokens a postfix-expression suffix starts with; an operand right
+/// behind another is an error left to the caller
 bool Parser::IsPostFixExpr(tok::TokenKind tokenType) {
   return (tokenType == tok::l_paren || tokenType == tok::l_square ||
           tokenType == tok::period || tokenType == tok::arrow ||
-          tokenType == tok::plus_plus || tokenType == tok::minus_minus ||
-          tokenType == tok::identifier || tokenType == tok::char_constant ||
-          tokenType == tok::numeric_constant);
+          tokenType == tok::plus_plus || tokenType == tok::minus_minus);
 }
 
 bool Parser::IsCurrentIn(TokenBitSet tokenSet) {
   return tokenSet[mTokCursor->getTokenKind()];
 }
 
-void Parser::Scope::addTypedef(std::string_view name) {
-  mCurrentScope.back().emplace(name, Symbol{name, true});
-}
-
-bool Parser::Scope::isTypedefInScope(std::string_view name) const {
-  for (auto iter = mCurrentScope.rbegin(); iter != mCurrentScope.rend();
-       iter++) {
-    if (auto result = iter->find(name); result != iter->end()) {
-      return result->second.isTypedef;
-    }
+void Parser::Scope::declare(uint32_t id, bool isTypedef) {
+  uint32_t level = mScopeBegins.size();
+  const Symbol *visible = lookup(id);
+  /// a name declared again in the same scope keeps what it was first
+  if (visible && visible->level == level) {
+    return;
   }
-  return false;
-}
-
-bool Parser::Scope::checkIsTypedefInCurrentScope(std::string_view name) const {
-  auto iter = mCurrentScope.rbegin();
-  if (auto result = iter->find(name); result != iter->end())
-    return result->second.isTypedef;
-  return false;
+  if (id >= mVisible.size()) {
+    mVisible.resize(id + 1, NoSymbol);
+  }
+  mSymbols.push_back({id, mVisible[id], level, isTypedef});
+  mVisible[id] = mSymbols.size() - 1;
 }
 
-void Parser::Scope::addToScope(std::string_view name) {
-  mCurrentScope.back().emplace(name, Symbol{name, false});
+void Parser::Scope::popScope() {
+  uint32_t begin = mScopeBegins.back();
+  mScopeBegins.pop_back();
+  while (mSymbols.size() > begin) {
+    mVisible[mSymbols.back().id] = mSymbols.back().shadowed;
+    mSymbols.pop_back();
+  }
 }
 
-void Parser::Scope::pushScope() {
-  mCurrentScope.emplace_back();
+void Parser::Scope::truncateFileScope(uint32_t size) {
+  LCC_ASSERT(mScopeBegins.empty() && "a scope is still open");
+  while (mSymbols.size() > size) {
+    mVisible[mSymbols.back().id] = mSymbols.back().shadowed;
+    mSymbols.pop_back();
+  }
 }
 
-void Parser::Scope::popScope() {
-  mCurrentScope.pop_back();
+std::vector<uint32_t> Parser::Scope::getGlobalTypedefs() const {
+  std::vector<uint32_t> ids;
+  uint32_t end = getFileScopeSize();
+  for (uint32_t i = 0; i < end; ++i) {
+    if (mSymbols[i].isTypedef) {
+      ids.push_back(mSymbols[i].id);
+    }
+  }
+  return ids;
 }
 
+/// A bracketed group is jumped over as a whole, what is inside it does not
+/// end the recovery. Neither does it go past the } of the enclosing block.
 void Parser::SkipTo(TokenBitSet recoveryToken, unsigned DiagID) {
-  if (mTokCursor == mTokEnd || recoveryToken[mTokCursor->getTokenKind()]) {
+  if (Peek(tok::eof) || recoveryToken[mTokCursor->getTokenKind()]) {
     return;
   }
-  TokIter tok = mTokCursor;
-  mTokCursor = std::find_if(mTokCursor, mTokEnd, [&recoveryToken](const Token& tok){
-    return recoveryToken[tok.getTokenKind()];
-  });
-  DiagReport(Diag, tok->getSMLoc(), DiagID);
+  auto loc = mTokCursor->getSMLoc();
+  while (!Peek(tok::eof) && !recoveryToken[mTokCursor->getTokenKind()]) {
+    uint32_t index = mTokCursor.getIndex();
+    uint32_t match = mTokens.getMatch(index);
+    if (match == TokenStream::NoMatch) {
+      ConsumeAny();
+    } else if (match > index) {
+      mTokCursor = TokenCursor(mTokens, match + 1);
+    } else if (match == mEnclosingBrace) {
+      break;
+    } else {
+      ConsumeAny();
+    }
+  }
+  DiagReport(Diag, loc, DiagID);
 }
 
-std::string_view
-Parser::GetDeclaratorName(const Syntax::Declarator &declarator) {
+uint32_t Parser::GetDeclaratorId(const Syntax::Declarator &declarator) {
   return match_with_self(
       declarator.getDirectDeclarator(),
-      [](auto &&, const box<DirectDeclaratorIdent> &name) -> std::string_view {
-        return name->getIdent();
+      [](auto &&, const box<DirectDeclaratorIdent> &name) -> uint32_t {
+        return name->getIdentifierId();
       },
       [](auto &&self, const box<DirectDeclaratorParentheses> &declarator)
-          -> std::string_view {
+          -> uint32_t {
         return match(
             declarator->getDeclarator().getDirectDeclarator(),
-            [&self](auto &&value) -> std::string_view { return self(value); });
+            [&self](auto &&value) -> uint32_t { return self(value); });
       },
       [](auto &&self, const box<DirectDeclaratorParamTypeList> &paramTypeList)
-          -> std::string_view {
+          -> uint32_t {
         return match(
             paramTypeList->getDirectDeclarator(),
-            [&self](auto &&value) -> std::string_view { return self(value); });
+            [&self](auto &&value) -> uint32_t { return self(value); });
       },
       [](auto &&self, const box<DirectDeclaratorAssignExpr> &assignExpr)
-          -> std::string_view {
+          -> uint32_t {
         return match(
             assignExpr->getDirectDeclarator(),
-            [&self](auto &&value) -> std::string_view { return self(value); });
+            [&self](auto &&value) -> uint32_t { return self(value); });
       },
       [](auto &&self,
-         const box<DirectDeclaratorAsterisk> &asterisk) -> std::string_view {
+         const box<DirectDeclaratorAsterisk> &asterisk) -> uint32_t {
         return match(
             asterisk->getDirectDeclarator(),
-            [&self](auto &&value) -> std::string_view { return self(value); });
+            [&self](auto &&value) -> uint32_t { return self(value); });
       });
 }
 
@@ -2296,7 +2532,7 @@ bool Parser::IsFirstInDeclarationSpecifier() const {
   case tok::kw_volatile:
   case tok::kw_inline: return true;
   case tok::identifier:
-    return mScope.isTypedefInScope(mTokCursor->getRepresentation());
+    return mScope.isTypedefInScope(mTokCursor->getIdentifierId());
   default:
     return false;
   }
@@ -2321,7 +2557,7 @@ bool Parser::IsFirstInSpecifierQualifier() const {
   case tok::kw_volatile:
   case tok::kw_inline: return true;
   case tok::identifier:
-    return mScope.isTypedefInScope(mTokCursor->getRepresentation());
+    return mScope.isTypedefInScope(mTokCursor->getIdentifierId());
   default:
     return false;
   }
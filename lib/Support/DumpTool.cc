@@ -17,6 +17,7 @@
 namespace lcc::dump {
 
 static uint64_t LeftAlign = 1;
+static bool DumpBodies = true;
 
 //void IncAlign() {
 //  LeftAlign++;
@@ -49,15 +50,96 @@ void Println(std::string_view content, bool color=true) {
   }
 }
 
-void dumpTokens(const std::vector<lcc::Token> &tokens) {
+void dumpTokens(const std::vector<lcc::Token> &tokens,
+                const SourceManager &mgr) {
   for (auto &tok : tokens) {
-//    llvm::outs() << tok.getLine() << ", " << tok.getColumn() << ", " << tok.getRepresentation() << "\n";
-    auto pair = tok.getLineAndColumn();
+    auto pair = tok.getLineAndColumn(mgr);
     llvm::outs() << pair.first << ", " << pair.second << ", " << tok.getRepresentation() << "\n";
   }
 }
 
-void dumpAst(const lcc::Syntax::TranslationUnit &unit) { visit(unit); }
+void dumpPreprocessed(const std::vector<lcc::Token> &tokens,
+                      const std::vector<const char *> &positions,
+                      const LiteralPool &literals, const SourceManager &mgr,
+                      llvm::raw_ostream &os) {
+  FileID lineFile;
+  unsigned line = 0;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    SourceLocation loc = mgr.getLocation(positions[i]);
+    FileID fileID = mgr.getFileID(loc);
+    unsigned tokLine = mgr.getLineAndColumn(loc).first;
+    const Token &tok = tokens[i];
+    if (!i) {
+      lineFile = fileID;
+      line = tokLine;
+    } else if (fileID != lineFile || tokLine > line) {
+      os << "\n";
+      lineFile = fileID;
+      line = tokLine;
+    } else if (tokens[i - 1].getOffset() + tokens[i - 1].getLength() !=
+               tok.getOffset()) {
+      os << " ";
+    }
+    /// the spelling of embed_data is the whole directive, prefix and
+    /// suffix included, which are tokens of their own
+    if (tok.getTokenKind() == tok::embed_data) {
+      auto bytes =
+          std::get<llvm::ArrayRef<uint8_t>>(literals.get(tok.getLiteralIndex()));
+      for (size_t j = 0; j < bytes.size(); ++j) {
+        os << (j ? ", " : "") << unsigned(bytes[j]);
+      }
+      continue;
+    }
+    os << tok.getRepresentation();
+  }
+  if (!tokens.empty()) {
+    os << "\n";
+  }
+}
+
+namespace {
+/// a path as make reads it back
+std::string escapeForMake(llvm::StringRef path) {
+  std::string result;
+  for (char ch : path) {
+    if (ch == ' ' || ch == '#') {
+      result += '\\';
+    } else if (ch == '$') {
+      result += '$';
+    }
+    result += ch;
+  }
+  return result;
+}
+} // namespace
+
+void dumpDependencies(llvm::StringRef target,
+                      const std::vector<std::string> &files, bool phony,
+                      llvm::raw_ostream &os) {
+  constexpr size_t MaxColumns = 75;
+  std::string line = escapeForMake(target) + ":";
+  for (const auto &file : files) {
+    std::string name = escapeForMake(file);
+    if (line.size() + name.size() + 1 > MaxColumns && line.size() > 1) {
+      os << line << " \\\n";
+      line = " ";
+    } else {
+      line += " ";
+    }
+    line += name;
+  }
+  os << line << "\n";
+  if (phony) {
+    for (size_t i = 1; i < files.size(); ++i) {
+      os << "\n" << escapeForMake(files[i]) << ":\n";
+    }
+  }
+}
+
+void dumpAst(const lcc::Syntax::TranslationUnit &unit, bool bodies) {
+  ValueReset v(DumpBodies, bodies);
+  visit(unit);
+}
 
 void visit(const Syntax::TranslationUnit &unit) {
   Print("TranslationUnit");
@@ -94,7 +176,9 @@ void visit(const Syntax::FunctionDefinition &functionDefinition) {
   ValueReset v(LeftAlign, LeftAlign+1);
   visit(functionDefinition.getDeclarationSpecifiers());
   visit(functionDefinition.getDeclarator());
-  visit(functionDefinition.getCompoundStatement());
+  if (DumpBodies) {
+    visit(functionDefinition.getCompoundStatement());
+  }
 }
 void visit(const Syntax::DeclSpec &declarationSpecifiers) {
   Print("DeclSpec");
@@ -139,11 +223,31 @@ void visit(const Syntax::Initializer &initializer) {
   match(
       initializer.getVariant(),
       [](const Syntax::AssignExpr &assignExpr) { visit(assignExpr); },
-      [](const box<Syntax::InitializerList> &initializerList) {
+      [](const Syntax::box<Syntax::InitializerList> &initializerList) {
         visit(*initializerList);
+      },
+      [](const Syntax::ConstantArray &constantArray) {
+        visit(constantArray);
       });
 }
 
+void visit(const Syntax::ConstantArray &constantArray) {
+  Print("ConstantArray");
+  llvm::outs() << &constantArray << " " << constantArray.size() << "\n";
+  ValueReset v(LeftAlign, LeftAlign + 1);
+  /// one line for the whole run, tables can have millions of elements
+  std::string line;
+  match(constantArray.getElements(), [&line](const auto &values) {
+    for (const auto &value : values) {
+      if (!line.empty()) {
+        line += ", ";
+      }
+      line += std::to_string(value);
+    }
+  });
+  Println(line);
+}
+
 void visit(const Syntax::InitializerList &initializerList) {
   Print("InitializerList");
   llvm::outs() << &initializerList << "\n";
@@ -257,7 +361,7 @@ void visit(const Syntax::TypeSpec &typeSpecifier) {
         }
         }
       },
-      [](const box<Syntax::StructOrUnionSpec> &structOrUnionSpecifier) {
+      [](const Syntax::box<Syntax::StructOrUnionSpec> &structOrUnionSpecifier) {
         Print("StructOrUnionSpec");
         llvm::outs() << &structOrUnionSpecifier << " "
                      << structOrUnionSpecifier->isUnion() << ", "
@@ -279,7 +383,7 @@ void visit(const Syntax::TypeSpec &typeSpecifier) {
           }
         }
       },
-      [](const box<Syntax::EnumSpecifier> &enumSpecifier) {
+      [](const Syntax::box<Syntax::EnumSpecifier> &enumSpecifier) {
         Print("EnumSpecifier");
         llvm::outs() << &enumSpecifier << " " << enumSpecifier->getName()
                      << "\n";
@@ -319,20 +423,20 @@ void visit(const Syntax::DirectDeclarator &directDeclarator) {
   //  ValueReset v(LeftAlign, LeftAlign+1);
   match(
       directDeclarator,
-      [](const box<Syntax::DirectDeclaratorIdent> &ident) {
+      [](const Syntax::box<Syntax::DirectDeclaratorIdent> &ident) {
         Print("DirectDeclaratorIdent");
         llvm::outs() << &ident << "\n";
         ValueReset v(LeftAlign, LeftAlign + 1);
         Println(ident->getIdent());
       },
-      [](const box<Syntax::DirectDeclaratorParentheses>
+      [](const Syntax::box<Syntax::DirectDeclaratorParentheses>
              &directDeclaratorParent) {
         Print("DirectDeclaratorParentheses");
         llvm::outs() << &directDeclaratorParent << "\n";
         ValueReset v(LeftAlign, LeftAlign + 1);
         visit(directDeclaratorParent->getDeclarator());
       },
-      [](const box<Syntax::DirectDeclaratorAssignExpr>
+      [](const Syntax::box<Syntax::DirectDeclaratorAssignExpr>
              &directDeclaratorAssignExpr) {
         Print("DirectDeclaratorAssignExpr");
         llvm::outs() << &directDeclaratorAssignExpr << "\n";
@@ -349,7 +453,7 @@ void visit(const Syntax::DirectDeclarator &directDeclarator) {
           visit(*directDeclaratorAssignExpr->getAssignmentExpression());
         }
       },
-      [](const box<Syntax::DirectDeclaratorParamTypeList>
+      [](const Syntax::box<Syntax::DirectDeclaratorParamTypeList>
              &directDeclaratorParentParamTypeList) {
         Print("DirectDeclaratorParamTypeList");
         llvm::outs() << &directDeclaratorParentParamTypeList << "\n";
@@ -357,7 +461,7 @@ void visit(const Syntax::DirectDeclarator &directDeclarator) {
         visit(directDeclaratorParentParamTypeList->getDirectDeclarator());
         visit(directDeclaratorParentParamTypeList->getParamTypeList());
       },
-      [](const box<Syntax::DirectDeclaratorAsterisk>
+      [](const Syntax::box<Syntax::DirectDeclaratorAsterisk>
              &directDeclaratorAsterisk) {
         Print("DirectDeclaratorAsterisk");
         llvm::outs() << &directDeclaratorAsterisk << "\n";
@@ -376,14 +480,14 @@ void visit(const Syntax::DirectAbstractDeclarator &directAbstractDeclarator) {
   ValueReset v(LeftAlign, LeftAlign+1);
   match(
       directAbstractDeclarator,
-      [](const box<Syntax::DirectAbstractDeclaratorParentheses>
+      [](const Syntax::box<Syntax::DirectAbstractDeclaratorParentheses>
              &directAbstractDeclaratorParent) {
         Print("DirectAbstractDeclaratorParentheses");
         llvm::outs() << &directAbstractDeclaratorParent << "\n";
         ValueReset v(LeftAlign, LeftAlign + 1);
         visit(directAbstractDeclaratorParent->getAbstractDeclarator());
       },
-      [](const box<Syntax::DirectAbstractDeclaratorAssignExpr>
+      [](const Syntax::box<Syntax::DirectAbstractDeclaratorAssignExpr>
              &directAbstractDeclaratorAssignExpr) {
         Print("DirectAbstractDeclaratorAssignExpr");
         llvm::outs() << &directAbstractDeclaratorAssignExpr << "\n";
@@ -403,7 +507,7 @@ void visit(const Syntax::DirectAbstractDeclarator &directAbstractDeclarator) {
           visit(*directAbstractDeclaratorAssignExpr->getAssignmentExpression());
         }
       },
-      [](const box<Syntax::DirectAbstractDeclaratorParamTypeList>
+      [](const Syntax::box<Syntax::DirectAbstractDeclaratorParamTypeList>
              &directAbstractDeclaratorParamTypeList) {
         Print("DirectAbstractDeclaratorParamTypeList");
         llvm::outs() << &directAbstractDeclaratorParamTypeList << "\n";
@@ -416,7 +520,7 @@ void visit(const Syntax::DirectAbstractDeclarator &directAbstractDeclarator) {
         if (directAbstractDeclaratorParamTypeList->getParameterTypeList())
           visit(*directAbstractDeclaratorParamTypeList->getParameterTypeList());
       },
-      [](const box<Syntax::DirectAbstractDeclaratorAsterisk>
+      [](const Syntax::box<Syntax::DirectAbstractDeclaratorAsterisk>
              &directAbstractDeclaratorAsterisk) {
         Print("DirectAbstractDeclaratorAsterisk");
         llvm::outs() << &directAbstractDeclaratorAsterisk << "\n";
@@ -474,22 +578,22 @@ void visit(const Syntax::BlockItem &blockItem) {
 
 void visit(const Syntax::Stmt &stmt) {
   match(
-      stmt, [](const box<Syntax::IfStmt> &ifStmt) { visit(*ifStmt); },
-      [](const box<Syntax::ForStmt> &forStmt) { visit(*forStmt); },
-      [](const box<Syntax::WhileStmt> &whileStmt) { visit(*whileStmt); },
-      [](const box<Syntax::DoWhileStmt> &doWhileStmt) { visit(*doWhileStmt); },
-      [](const box<Syntax::BreakStmt> &breakStmt) { visit(*breakStmt); },
-      [](const box<Syntax::ContinueStmt> &continueStmt) {
+      stmt, [](const Syntax::box<Syntax::IfStmt> &ifStmt) { visit(*ifStmt); },
+      [](const Syntax::box<Syntax::ForStmt> &forStmt) { visit(*forStmt); },
+      [](const Syntax::box<Syntax::WhileStmt> &whileStmt) { visit(*whileStmt); },
+      [](const Syntax::box<Syntax::DoWhileStmt> &doWhileStmt) { visit(*doWhileStmt); },
+      [](const Syntax::box<Syntax::BreakStmt> &breakStmt) { visit(*breakStmt); },
+      [](const Syntax::box<Syntax::ContinueStmt> &continueStmt) {
         visit(*continueStmt);
       },
-      [](const box<Syntax::SwitchStmt> &switchStmt) { visit(*switchStmt); },
-      [](const box<Syntax::CaseStmt> &caseStmt) { visit(*caseStmt); },
-      [](const box<Syntax::DefaultStmt> &defaultStmt) { visit(*defaultStmt); },
-      [](const box<Syntax::ReturnStmt> &returnStmt) { visit(*returnStmt); },
-      [](const box<Syntax::ExprStmt> &exprStmt) { visit(*exprStmt); },
-      [](const box<Syntax::GotoStmt> &gotoStmt) { visit(*gotoStmt); },
-      [](const box<Syntax::LabelStmt> &labelStmt) { visit(*labelStmt); },
-      [](const box<Syntax::BlockStmt> &blockStmt) { visit(*blockStmt); });
+      [](const Syntax::box<Syntax::SwitchStmt> &switchStmt) { visit(*switchStmt); },
+      [](const Syntax::box<Syntax::CaseStmt> &caseStmt) { visit(*caseStmt); },
+      [](const Syntax::box<Syntax::DefaultStmt> &defaultStmt) { visit(*defaultStmt); },
+      [](const Syntax::box<Syntax::ReturnStmt> &returnStmt) { visit(*returnStmt); },
+      [](const Syntax::box<Syntax::ExprStmt> &exprStmt) { visit(*exprStmt); },
+      [](const Syntax::box<Syntax::GotoStmt> &gotoStmt) { visit(*gotoStmt); },
+      [](const Syntax::box<Syntax::LabelStmt> &labelStmt) { visit(*labelStmt); },
+      [](const Syntax::box<Syntax::BlockStmt> &blockStmt) { visit(*blockStmt); });
 }
 
 void visit(const Syntax::IfStmt &ifStmt) {
@@ -508,7 +612,7 @@ void visit(const Syntax::ForStmt &forStmt) {
   ValueReset v(LeftAlign, LeftAlign+1);
   match(
       forStmt.getInitial(),
-      [](const box<Syntax::Declaration> &declaration) { visit(*declaration); },
+      [](const Syntax::box<Syntax::Declaration> &declaration) { visit(*declaration); },
       [](const std::optional<Syntax::Expr> &expr) {
         if (expr)
           visit(*expr);
@@ -667,152 +771,19 @@ void visit(const Syntax::ConstantExpr &constantExpr) {
     visit(*constantExpr.getOptionalConditionalExpression());
   }
 }
-void visit(const Syntax::LogOrExpr &logOrExpr) {
-  Print("LogOrExpr");
-  llvm::outs() << &logOrExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  for (const auto &logAndExpr : logOrExpr.getLogAndExprs()) {
-    visit(logAndExpr);
-  }
-}
-void visit(const Syntax::LogAndExpr &logAndExpr) {
-  Print("LogAndExpr");
-  llvm::outs() << &logAndExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  for (const auto &bitOrExpr : logAndExpr.getBitOrExprs()) {
-    visit(bitOrExpr);
-  }
-}
-void visit(const Syntax::BitOrExpr &bitOrExpr) {
-  Print("BitOrExpr");
-  llvm::outs() << &bitOrExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  for (const auto &bitXorExpr : bitOrExpr.getBitXorExprs()) {
-    visit(bitXorExpr);
-  }
-}
-void visit(const Syntax::BitXorExpr &bitXorExpr) {
-  Print("BitXorExpr");
-  llvm::outs() << &bitXorExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  for (const auto &bitAndExpr : bitXorExpr.getBitAndExprs()) {
-    visit(bitAndExpr);
-  }
-}
-void visit(const Syntax::BitAndExpr &bitAndExpr) {
-  Print("BitAndExpr");
-  llvm::outs() << &bitAndExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  for (const auto &equalExpr : bitAndExpr.getEqualExpr()) {
-    visit(equalExpr);
-  }
-}
-void visit(const Syntax::EqualExpr &equalExpr) {
-  Print("EqualExpr");
-  llvm::outs() << &equalExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  visit(equalExpr.getRelationalExpr());
-  for (const auto &relationExpr: equalExpr.getOptionalRelationalExpr()) {
-    switch (relationExpr.first) {
-    case Syntax::EqualExpr::Equal: {
-      Println("==");
-      break;
-    }
-    case Syntax::EqualExpr::NotEqual: {
-      Println("!=");
-      break;
-    }
-    }
-    visit(relationExpr.second);
-  }
-}
-void visit(const Syntax::RelationalExpr &relationalExpr) {
-  Print("RelationalExpr");
-  llvm::outs() << &relationalExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  visit(relationalExpr.getShiftExpr());
-  for (const auto &shiftExpr: relationalExpr.getOptionalShiftExpressions()) {
-    switch (shiftExpr.first) {
-    case Syntax::RelationalExpr::LessThan: {
-      Println("<");
-      break;
-    }
-    case Syntax::RelationalExpr::LessThanOrEqual: {
-      Println("<=");
-      break;
-    }
-    case Syntax::RelationalExpr::GreaterThan: {
-      Println(">");
-      break;
-    }
-    case Syntax::RelationalExpr::GreaterThanOrEqual: {
-      Println(">=");
-      break;
-    }
-    }
-    visit(shiftExpr.second);
-  }
-}
-void visit(const Syntax::ShiftExpr &shiftExpr) {
-  Print("ShiftExpr");
-  llvm::outs() << &shiftExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  visit(shiftExpr.getAdditiveExpr());
-  for (const auto &additiveExpr: shiftExpr.getOptAdditiveExps()) {
-    switch (additiveExpr.first) {
-    case Syntax::ShiftExpr::Left: {
-      Println("<<");
-      break;
-    }
-    case Syntax::ShiftExpr::Right: {
-      Println(">>");
-      break;
-    }
-    }
-    visit(additiveExpr.second);
-  }
-}
-void visit(const Syntax::AdditiveExpr &additiveExpr) {
-  Print("AdditiveExpr");
-  llvm::outs() << &additiveExpr << "\n";
-  ValueReset v(LeftAlign, LeftAlign+1);
-  visit(additiveExpr.getMultiExpr());
-  for (const auto &multiExpr: additiveExpr.getOptionalMultiExps()) {
-    switch (multiExpr.first) {
-    case Syntax::AdditiveExpr::Minus: {
-      Println("-");
-      break;
-    }
-    case Syntax::AdditiveExpr::Plus: {
-      Println("+");
-      break;
-    }
-    }
-    visit(multiExpr.second);
-  }
+void visit(const Syntax::BinaryOperand &binaryOperand) {
+  match(
+      binaryOperand,
+      [](const Syntax::CastExpr &castExpr) { visit(castExpr); },
+      [](const Syntax::box<Syntax::BinaryExpr> &binaryExpr) { visit(*binaryExpr); });
 }
-void visit(const Syntax::MultiExpr &multiExpr) {
-  Print("MultiExpr");
-  llvm::outs() << &multiExpr << "\n";
+void visit(const Syntax::BinaryExpr &binaryExpr) {
+  Print("BinaryExpr");
+  llvm::outs() << &binaryExpr << "\n";
   ValueReset v(LeftAlign, LeftAlign+1);
-  visit(multiExpr.getCastExpr());
-  for (const auto &castExpr: multiExpr.getOptionalCastExps()) {
-    switch (castExpr.first) {
-    case Syntax::MultiExpr::Multiply: {
-      Println("*");
-      break;
-    }
-    case Syntax::MultiExpr::Divide: {
-      Println("/");
-      break;
-    }
-    case Syntax::MultiExpr::Modulo: {
-      Println("%");
-      break;
-    }
-    }
-    visit(castExpr.second);
-  }
+  visit(binaryExpr.getLhs());
+  Println(Syntax::BinaryExpr::getSpelling(binaryExpr.getOperator()));
+  visit(binaryExpr.getRhs());
 }
 void visit(const Syntax::CastExpr &castExpr) {
   Print("CastExpr");
@@ -821,9 +792,9 @@ void visit(const Syntax::CastExpr &castExpr) {
   match(
       castExpr.getVariant(),
       [](const Syntax::UnaryExpr &unaryExpr) { visit(unaryExpr); },
-      [](const Syntax::CastExpr::TypeNameCast &pair) {
-        visit(pair.first);
-        visit(*pair.second);
+      [](const Syntax::box<Syntax::CastExpr::TypeNameCast> &pair) {
+        visit(pair->first);
+        visit(*pair->second);
       });
 }
 void visit(const Syntax::UnaryExpr &unaryExpr) {
@@ -834,7 +805,7 @@ void visit(const Syntax::UnaryExpr &unaryExpr) {
         llvm::outs() << &postFixExpr << "\n";
         visit(postFixExpr);
       },
-      [](const box<Syntax::UnaryExprUnaryOperator> &unaryExprUnaryOperator) {
+      [](const Syntax::box<Syntax::UnaryExprUnaryOperator> &unaryExprUnaryOperator) {
         Print("UnaryExprUnaryOperator");
         llvm::outs() << &unaryExprUnaryOperator << "\n";
         ValueReset v(LeftAlign, LeftAlign + 1);
@@ -874,7 +845,7 @@ void visit(const Syntax::UnaryExpr &unaryExpr) {
         }
         visit(*unaryExprUnaryOperator->getCastExpr());
       },
-      [](const box<Syntax::UnaryExprSizeOf> &unaryExprSizeOf) {
+      [](const Syntax::box<Syntax::UnaryExprSizeOf> &unaryExprSizeOf) {
         Print("UnaryExprSizeOf");
         llvm::outs() << &unaryExprSizeOf << "\n";
         ValueReset v(LeftAlign, LeftAlign + 1);
@@ -902,14 +873,14 @@ void visit(const Syntax::PostFixExpr &postFixExpr) {
         llvm::outs() << &primaryExpr << "\n";
         visit(primaryExpr);
       },
-      [](const box<Syntax::PostFixExprSubscript> &subscript) {
+      [](const Syntax::box<Syntax::PostFixExprSubscript> &subscript) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprSubscript");
         llvm::outs() << &subscript << "\n";
         visit(subscript->getPostFixExpr());
         visit(subscript->getExpr());
       },
-      [](const box<Syntax::PostFixExprFuncCall> &funcCall) {
+      [](const Syntax::box<Syntax::PostFixExprFuncCall> &funcCall) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprFuncCall");
         llvm::outs() << &funcCall << "\n";
@@ -919,33 +890,33 @@ void visit(const Syntax::PostFixExpr &postFixExpr) {
           visit(*assignExpr);
         }
       },
-      [](const box<Syntax::PostFixExprDot> &dot) {
+      [](const Syntax::box<Syntax::PostFixExprDot> &dot) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprDot");
         llvm::outs() << &dot << "\n";
         visit(dot->getPostFixExpr());
         Println(dot->getIdentifier());
       },
-      [](const box<Syntax::PostFixExprArrow> &arrow) {
+      [](const Syntax::box<Syntax::PostFixExprArrow> &arrow) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprArrow");
         llvm::outs() << &arrow << "\n";
         visit(arrow->getPostFixExpr());
         Println(arrow->getIdentifier());
       },
-      [](const box<Syntax::PostFixExprIncrement> &increment) {
+      [](const Syntax::box<Syntax::PostFixExprIncrement> &increment) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprIncrement");
         llvm::outs() << &increment << "\n";
         visit(increment->getPostFixExpr());
       },
-      [](const box<Syntax::PostFixExprDecrement> &decrement) {
+      [](const Syntax::box<Syntax::PostFixExprDecrement> &decrement) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprDecrement");
         llvm::outs() << &decrement << "\n";
         visit(decrement->getPostFixExpr());
       },
-      [](const box<Syntax::PostFixExprTypeInitializer> &typeInitializer) {
+      [](const Syntax::box<Syntax::PostFixExprTypeInitializer> &typeInitializer) {
         ValueReset v(LeftAlign, LeftAlign + 1);
         Print("PostFixExprTypeInitializer");
         llvm::outs() << &typeInitializer << "\n";
@@ -972,7 +943,7 @@ void visit(const Syntax::PrimaryExpr &primaryExpr) {
         match(constant.getValue(), [](auto &&value) {
           ValueReset v(LeftAlign, LeftAlign + 1);
           using T = std::decay_t<decltype(value)>;
-          if constexpr (std::is_same_v<T, std::string>) {
+          if constexpr (std::is_same_v<T, std::string_view>) {
             Println(value);
           } else {
             Println(std::to_string(value));
@@ -0,0 +1,16 @@
+/// embed_01.bin holds the bytes 1 to 8
+unsigned char data[] = {
+#embed "embed_01.bin"
+};
+
+/// limit, prefix and suffix
+unsigned char head[] = {
+#embed "embed_01.bin" limit(4) prefix(0, ) suffix(, 0)
+};
+
+/// if_empty takes the place of an empty resource
+int empty[] = {
+#embed "embed_01.bin" limit(0) if_empty(-1)
+};
+
+int size = sizeof(data) + sizeof(head) + sizeof(empty);
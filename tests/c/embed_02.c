@@ -0,0 +1,15 @@
+/// outside an initializer list the bytes are a comma separated list of int
+/// constants, embed_01.bin holds the bytes 1 to 8
+int sum(int a, int b, int c, int d, int e, int f, int g, int h);
+
+int last(void) {
+  return (
+#embed "embed_01.bin"
+  );
+}
+
+int total(void) {
+  return sum(
+#embed "embed_01.bin"
+  );
+}
@@ -0,0 +1,9 @@
+/// a backslash at the end of a line comment continues it on the next line
+int a; // this comment goes on \
+int not_declared = ;
+int b;
+
+/// also with \r\n line ends
+int c; // \
+int not_declared_either = ;
+int d;
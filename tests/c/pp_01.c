@@ -0,0 +1,57 @@
+#include "pp_01_guard.h"
+#include "pp_01_guard.h"
+#include "pp_01_once.h"
+#include "pp_01_once.h"
+
+/// object-like and function-like macros
+#define N 10
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a, b) a ## b
+#define CALL(f, ...) f(__VA_ARGS__)
+
+int g1 = N;
+int g2 = MAX(N, 20);
+char *g3 = STR(N);
+char *g4 = XSTR(N);
+int CAT(g, 5) = CAT(1, 2);
+int g6 = CALL(MAX, 1, 2);
+/// a macro does not expand again inside its own expansion
+int self = 1;
+#define self (self + 1)
+int g12 = self;
+
+#undef N
+#define N 20
+int g7 = N;
+
+/// inactive groups are skipped without being lexed as C
+#if 0
+this is not C '
+#error not reached
+#elif N > 10 && defined(MAX) && defined(self)
+int g8 = 1;
+#else
+#error not reached
+#endif
+
+#ifdef N
+#ifndef MAX
+#error not reached
+#endif
+int g9 = __LINE__;
+#endif
+
+#if N == 20
+#elifdef MAX
+#error not reached
+#endif
+
+#line 100 "pp_01_line.c"
+int g10 = __LINE__;
+char *g11 = __FILE__;
+
+int main() {
+  return guarded(g1) + once(g2);
+}
@@ -0,0 +1,8 @@
+/// include guard: the second #include of this file is skipped without
+/// reading it again
+#ifndef PP_01_GUARD_H
+#define PP_01_GUARD_H
+
+int guarded(int a);
+
+#endif
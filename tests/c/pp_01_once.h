@@ -0,0 +1,4 @@
+/// #pragma once: included only the first time
+#pragma once
+
+int once(int a);
@@ -0,0 +1,49 @@
+# Helpers of the checked test scripts, see CMakeLists.txt for the variables
+# they get.
+
+# Replaces %s, %S and %t in the |-separated ARGS and stores the list in <var>.
+function(lcc_check_args var)
+    string(REPLACE "|" ";" args "${ARGS}")
+    get_filename_component(input_dir "${INPUT}" DIRECTORY)
+    string(REPLACE "%s" "${INPUT}" args "${args}")
+    string(REPLACE "%S" "${input_dir}" args "${args}")
+    string(REPLACE "%t" "${WORK_DIR}" args "${args}")
+    set(${var} "${args}" PARENT_SCOPE)
+endfunction()
+
+# Runs a command, stores what it prints on stdout and stderr in <output> and
+# its exit status in <result>.
+function(lcc_check_run output result)
+    execute_process(COMMAND ${ARGN}
+            WORKING_DIRECTORY ${WORK_DIR}
+            OUTPUT_VARIABLE out
+            ERROR_VARIABLE out
+            RESULT_VARIABLE status)
+    set(${output} "${out}" PARENT_SCOPE)
+    set(${result} "${status}" PARENT_SCOPE)
+endfunction()
+
+# Fails unless <output> matches the <prefix> lines of <check-file>.
+function(lcc_check_match output check_file prefix)
+    string(MAKE_C_IDENTIFIER "${prefix}" name)
+    set(file ${WORK_DIR}/${name}.out)
+    file(WRITE ${file} "${output}")
+    execute_process(COMMAND ${FILECHECK} ${check_file}
+            --check-prefix=${prefix} --input-file=${file}
+            RESULT_VARIABLE status)
+    if (NOT status EQUAL 0)
+        message(FATAL_ERROR "output does not match ${check_file}:\n${output}")
+    endif ()
+endfunction()
+
+# Fails unless a nonzero <result> is expected.
+function(lcc_check_result result output)
+    if (WILL_FAIL AND result EQUAL 0)
+        message(FATAL_ERROR "expected to fail:\n${output}")
+    elseif (NOT WILL_FAIL AND NOT result EQUAL 0)
+        message(FATAL_ERROR "failed with ${result}:\n${output}")
+    endif ()
+endfunction()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
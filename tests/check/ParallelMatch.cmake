@@ -0,0 +1,41 @@
+# Runs TOOL once serially and once on threads and fails unless both print the
+# same, apart from the addresses in an AST dump. ARGS holds the number of
+# blocks of 100 copies of INPUT to write to %t/input.c, then the option that
+# turns the threads on, then the arguments of both runs.
+include(${CMAKE_CURRENT_LIST_DIR}/LccCheck.cmake)
+
+lcc_check_args(args)
+list(POP_FRONT args blocks threads)
+
+# copy i of block j names its symbols <name>i_j, appending block by block
+# keeps the strings short
+file(READ ${INPUT} body)
+set(block "")
+foreach (i RANGE 1 100)
+    string(REPLACE "@" "${i}_@" copy "${body}")
+    string(APPEND block "${copy}")
+endforeach ()
+file(WRITE ${WORK_DIR}/input.c "")
+foreach (j RANGE 1 ${blocks})
+    string(REPLACE "@" "${j}" copy "${block}")
+    file(APPEND ${WORK_DIR}/input.c "${copy}")
+endforeach ()
+
+foreach (run serial threads)
+    if (run STREQUAL "threads")
+        set(run_args ${threads} ${args})
+    else ()
+        set(run_args ${args})
+    endif ()
+    lcc_check_run(output result ${TOOL} ${run_args})
+    lcc_check_result("${result}" "${output}")
+    string(REGEX REPLACE "0x[0-9a-f]+" "" output "${output}")
+    file(WRITE ${WORK_DIR}/${run}.out "${output}")
+endforeach ()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files
+        ${WORK_DIR}/serial.out ${WORK_DIR}/threads.out
+        RESULT_VARIABLE status)
+if (NOT status EQUAL 0)
+    message(FATAL_ERROR "${threads} changes the output, see ${WORK_DIR}")
+endif ()
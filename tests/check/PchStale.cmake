@@ -0,0 +1,26 @@
+# Builds a precompiled header from a copy of the .h next to INPUT, compiles
+# INPUT with it, touches the header and compiles again, then changes the
+# header. The last compile has to fail with the STALE lines of INPUT.
+include(${CMAKE_CURRENT_LIST_DIR}/LccCheck.cmake)
+
+string(REGEX REPLACE "\\.c$" ".h" header ${INPUT})
+get_filename_component(name ${header} NAME)
+set(copy ${WORK_DIR}/${name})
+configure_file(${header} ${copy} COPYONLY)
+
+lcc_check_run(output result ${LCC} -x c-header ${copy})
+lcc_check_result("${result}" "${output}")
+
+set(compile ${LCC} -include-pch=${copy}.pch ${INPUT} -o ${WORK_DIR}/out.o)
+lcc_check_run(output result ${compile})
+lcc_check_result("${result}" "${output}")
+
+file(TOUCH ${copy})
+lcc_check_run(output result ${compile})
+lcc_check_result("${result}" "${output}")
+
+file(APPEND ${copy} "int changed;\n")
+lcc_check_run(output result ${compile})
+set(WILL_FAIL TRUE)
+lcc_check_result("${result}" "${output}")
+lcc_check_match("${output}" ${INPUT} ${PREFIX})
@@ -0,0 +1,7 @@
+# Runs TOOL with ARGS and checks its output against the PREFIX lines of INPUT.
+include(${CMAKE_CURRENT_LIST_DIR}/LccCheck.cmake)
+
+lcc_check_args(args)
+lcc_check_run(output result ${TOOL} ${args})
+lcc_check_result("${result}" "${output}")
+lcc_check_match("${output}" ${INPUT} ${PREFIX})
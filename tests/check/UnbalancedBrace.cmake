@@ -0,0 +1,13 @@
+# A { that is never closed, in front of far more tokens than
+# TokenStream::MatchWindow. Looking for its match must not pull them all into
+# the token window of the streaming parser.
+include(${CMAKE_CURRENT_LIST_DIR}/LccCheck.cmake)
+
+file(READ ${INPUT} head)
+string(REPEAT "int f(int a) { return a + 1; }\n" 50000 body)
+file(WRITE ${WORK_DIR}/input.c "${head}${body}")
+
+lcc_check_args(args)
+lcc_check_run(output result ${TOOL} ${args})
+lcc_check_result("${result}" "${output}")
+lcc_check_match("${output}" ${INPUT} ${PREFIX})
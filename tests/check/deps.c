@@ -0,0 +1,28 @@
+/// -M lists every header the file reaches, -MM leaves out the ones reached
+/// through #include <...>, -MP adds a phony target per header. A header in
+/// an inactive #if group is not a dependency.
+#include "deps_user.h"
+#include <deps_angled.h>
+#include "deps_user.h"
+#if 0
+#include "deps_missing.h"
+#endif
+
+int main(void) { return deps_user + deps_nested + deps_angled; }
+
+// M: deps.o: {{.*}}deps.c {{.*}}deps_user.h \
+// M-NEXT: {{.*}}deps_nested.h {{.*}}deps_angled.h{{$}}
+// M-NOT: deps_missing.h
+
+// MM: deps.o: {{.*}}deps.c {{.*}}deps_user.h \
+// MM-NEXT: {{.*}}deps_nested.h{{$}}
+// MM-NOT: deps_angled.h
+
+// MP: deps.o: {{.*}}deps.c {{.*}}deps_user.h \
+// MP-NEXT: {{.*}}deps_nested.h{{$}}
+// MP-EMPTY:
+// MP-NEXT: {{.*}}deps_user.h:{{$}}
+// MP-EMPTY:
+// MP-NEXT: {{.*}}deps_nested.h:{{$}}
+
+// MT: obj: {{.*}}deps.c
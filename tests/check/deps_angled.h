@@ -0,0 +1 @@
+int deps_angled;
@@ -0,0 +1,2 @@
+#include "deps_nested.h"
+int deps_user;
@@ -0,0 +1,20 @@
+/// ../c/embed_01.bin holds the bytes 1 to 8
+unsigned char data[] = {
+#embed "../c/embed_01.bin"
+};
+unsigned char head[] = {
+#embed "../c/embed_01.bin" limit(4) prefix(0, ) suffix(, 0)
+};
+int empty[] = {
+#embed "../c/embed_01.bin" limit(0) if_empty(-1)
+};
+
+// CHECK: unsigned char data[] = {
+// CHECK-NEXT: 1, 2, 3, 4, 5, 6, 7, 8
+// CHECK-NEXT: };
+// CHECK-NEXT: unsigned char head[] = {
+// CHECK-NEXT: 0, 1, 2, 3, 4 , 0
+// CHECK-NEXT: };
+// CHECK-NEXT: int empty[] = {
+// CHECK-NEXT: -1
+// CHECK-NEXT: };
@@ -0,0 +1,27 @@
+/// outside an initializer list #embed is a comma separated list of int
+/// constants, which fits an argument list and a comma expression only
+int sum(int a, int b, int c, int d, int e, int f, int g, int h);
+
+int total(void) {
+  return sum(
+#embed "../c/embed_01.bin"
+  );
+}
+
+int last(void) {
+  return (
+#embed "../c/embed_01.bin"
+  );
+}
+
+int assign(void) {
+  int x;
+  x =
+#embed "../c/embed_01.bin"
+  ;
+  return x;
+}
+
+// CHECK-NOT: error
+// CHECK: embed_expr.c:20:1: error: #embed is only supported as an element of an initializer list, an argument list or a comma expression
+// CHECK-NOT: error
@@ -0,0 +1,24 @@
+/// A header whose only top level content is one #ifndef X or #if !defined(X)
+/// group, or that has #pragma once, is not read again by a later #include,
+/// also when the #include spells its path differently. A guard group with an
+/// #else is not such a header.
+#include "include_guard_ifndef.h"
+#include "include_guard_ifndef.h"
+#include "./include_guard_ifndef.h"
+#include "include_guard_defined.h"
+#include "include_guard_defined.h"
+#include "include_guard_once.h"
+#include "include_guard_once.h"
+#include "include_guard_else.h"
+#include "include_guard_else.h"
+
+int main(void) { return ifndef_guarded + defined_guarded + once + twice; }
+
+// CHECK: skipped 4 includes of guarded or #pragma once headers
+
+// PP: int ifndef_guarded;
+// PP-NEXT: int defined_guarded;
+// PP-NEXT: int once;
+// PP-NEXT: int twice;
+// PP-NEXT: extern int twice;
+// PP-NEXT: int main(void)
@@ -0,0 +1,4 @@
+#if !defined(INCLUDE_GUARD_DEFINED_H)
+#define INCLUDE_GUARD_DEFINED_H
+int defined_guarded;
+#endif
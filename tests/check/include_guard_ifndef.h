@@ -0,0 +1,4 @@
+#ifndef INCLUDE_GUARD_IFNDEF_H
+#define INCLUDE_GUARD_IFNDEF_H
+int ifndef_guarded;
+#endif
@@ -0,0 +1,9 @@
+/// #line sets the presumed line of the next source line, and the presumed
+/// file name when it names one
+#line 40 "foo.c"
+int line = __LINE__; const char *file = __FILE__;
+#line 7
+int next = __LINE__; const char *same = __FILE__;
+
+// CHECK: int line = 40 ; const char *file = "foo.c" ;
+// CHECK-NEXT: int next = 7 ; const char *same = "foo.c" ;
@@ -0,0 +1,12 @@
+/// diagnostics point at the presumed file and line
+#line 100 "foo.c"
+int a = ;
+#line 7
+int b = ;
+#line 0
+#line x
+
+// CHECK: foo.c:100:9: error: expect primary expr
+// CHECK: foo.c:7:9: error: expect primary expr
+// CHECK: foo.c:8:7: error: #line directive requires a positive integer argument
+// CHECK: foo.c:9:7: error: #line directive requires a positive integer argument
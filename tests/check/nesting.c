@@ -0,0 +1,25 @@
+/// checked with -max-nesting-depth=8. Else-if chains and runs of
+/// parentheses are parsed without nesting, so they may be longer.
+int chain(int a) {
+  if (a == 1) return 1;
+  else if (a == 2) return 2;
+  else if (a == 3) return 3;
+  else if (a == 4) return 4;
+  else if (a == 5) return 5;
+  else if (a == 6) return 6;
+  else if (a == 7) return 7;
+  else if (a == 8) return 8;
+  else if (a == 9) return 9;
+  else if (a == 10) return 10;
+  return ((((((((((((a))))))))))));
+}
+
+int deep(int a) {
+  { { { { { { { { { { a = 1; } } } } } } } } } }
+  return a;
+}
+
+int after(int a) { return a +; }
+
+// CHECK: nesting.c:18:{{[0-9]+}}: error: nesting level exceeded maximum of 8, the rest of the file is not parsed
+// CHECK-NOT: error
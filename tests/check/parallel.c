@@ -0,0 +1,26 @@
+/// Copied many times with @ replaced by the number of the copy, until the
+/// file splits into several lexer chunks or function bodies. Block comments,
+/// strings and spliced line comments cross the lines a chunk may start at.
+struct point@ { int x; int y; };
+
+/* a block comment
+   over several lines // with a line comment inside
+   and a "string" */
+static const char *text@ = "a string with // and /* inside";
+static char quote@ = '"';
+
+int area@(struct point@ p) {
+  // a line comment continued \
+  on the next line
+  int sum = 0;
+  for (int i = 0; i < p.x; ++i) {
+    if (i % 2 == 0) {
+      sum += p.y * i;
+    } else if (i % 3 == 0) {
+      sum -= i;
+    } else {
+      sum += (i << 1) | 1;
+    }
+  }
+  return sum + sizeof(struct point@) + quote@;
+}
@@ -0,0 +1,5 @@
+/// built with -include-pch of pch.h. Touching the header keeps the
+/// precompiled header usable, changing it does not.
+pch_int answer(void) { return PCH_ANSWER; }
+
+// STALE: error: '{{.*}}pch.h' has changed since the precompiled header '{{.*}}pch.h.pch' was built
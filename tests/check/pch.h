@@ -0,0 +1,5 @@
+#ifndef PCH_H
+#define PCH_H
+#define PCH_ANSWER 42
+typedef int pch_int;
+#endif
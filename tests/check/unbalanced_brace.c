@@ -0,0 +1,7 @@
+/// The head of a file the test grows to 650,000 tokens. The streaming
+/// parser recovers from the error by jumping over bracket groups, and the
+/// { here is never closed.
+int x = 1 2 { 3;
+
+// CHECK: <corpus>{{ +}}stream
+// CHECK-NEXT: token window: {{[0-9]?[0-9]?[0-9]?[0-9]?[0-9]?[0-9]}} tokens
@@ -0,0 +1,760 @@
+#include "lcc/Basic/Diagnostic.h"
+#include "lcc/Lexer/Lexer.h"
+#include "lcc/Lexer/Preprocessor.h"
+#include "lcc/Lexer/TokenStream.h"
+#include "lcc/Parser/Parser.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+
+#include <malloc.h>
+
+/// Every heap allocation of the process goes through here so that the
+/// benchmarks can report allocation counts and peak heap next to timings.
+static std::atomic<size_t> AllocCount{0};
+static std::atomic<size_t> AllocBytes{0};
+static std::atomic<size_t> LiveBytes{0};
+static std::atomic<size_t> PeakBytes{0};
+
+void *operator new(size_t size) {
+  void *p = std::malloc(size ? size : 1);
+  if (!p) {
+    llvm::report_bad_alloc_error("lcc-bench: out of memory");
+  }
+  AllocCount.fetch_add(1, std::memory_order_relaxed);
+  AllocBytes.fetch_add(size, std::memory_order_relaxed);
+  size_t live = LiveBytes.fetch_add(malloc_usable_size(p)) +
+                malloc_usable_size(p);
+  size_t peak = PeakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !PeakBytes.compare_exchange_weak(peak, live)) {
+  }
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept {
+  if (p) {
+    LiveBytes.fetch_sub(malloc_usable_size(p));
+    std::free(p);
+  }
+}
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+static const char *Head = "lcc-bench - frontend throughput benchmarks";
+
+enum class BenchKind { Lex, LexThreads, Parse, ParseThreads, Preprocess };
+
+static llvm::cl::opt<BenchKind> Bench(
+    "bench", llvm::cl::desc("Benchmark to run"),
+    llvm::cl::values(clEnumValN(BenchKind::Lex, "lex", "lexer throughput"),
+                     clEnumValN(BenchKind::LexThreads, "lex-threads",
+                                "parallel lexer scaling over 1-16 threads"),
+                     clEnumValN(BenchKind::Parse, "parse",
+                                "lexer and parser throughput"),
+                     clEnumValN(BenchKind::ParseThreads, "parse-threads",
+                                "parallel function body parsing scaling "
+                                "over 1-16 threads"),
+                     clEnumValN(BenchKind::Preprocess, "preprocess",
+                                "preprocessor throughput against gcc -E")),
+    llvm::cl::init(BenchKind::Lex));
+
+static llvm::cl::list<std::string> InputFiles(llvm::cl::Positional,
+                                              llvm::cl::desc("<input-files>"),
+                                              llvm::cl::ZeroOrMore);
+
+static llvm::cl::opt<unsigned> SyntheticMB(
+    "synthetic-mb",
+    llvm::cl::desc("Also run on a generated C file of <n> megabytes"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> LiteralMB(
+    "literal-mb",
+    llvm::cl::desc("Also run on a generated constant table of <n> megabytes"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> EmbedMB(
+    "embed-mb",
+    llvm::cl::desc("Also run on a <n> megabyte binary blob, once through "
+                   "#embed and once spelled out as an xxd -i style list"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> MacroMB(
+    "macro-mb",
+    llvm::cl::desc("Also run on a generated macro heavy file of <n> megabytes"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> TypedefMB(
+    "typedef-mb",
+    llvm::cl::desc("Also run on a generated typedef heavy file of <n> "
+                   "megabytes"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> CorruptMB(
+    "corrupt-mb",
+    llvm::cl::desc("Also run on a generated typedef heavy file of <n> "
+                   "megabytes with brackets and text dropped at random"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> Headers(
+    "headers",
+    llvm::cl::desc("Also run on a file including <n> generated headers that "
+                   "include each other through different paths"),
+    llvm::cl::value_desc("n"), llvm::cl::init(0));
+
+static llvm::cl::opt<bool>
+    CRLF("crlf", llvm::cl::desc("Convert the inputs to \\r\\n line endings "
+                                "behind a UTF-8 BOM"));
+
+static llvm::cl::opt<unsigned>
+    Iterations("iterations", llvm::cl::desc("Repeat every measurement <n> times"),
+               llvm::cl::value_desc("n"), llvm::cl::init(5));
+
+namespace {
+struct Input {
+  std::string name;
+  std::string content;
+  /// for the preprocessor benchmark
+  std::vector<std::string> includeDirs;
+};
+
+/// Machine generated C in the shape our code generators emit: long runs of
+/// similar functions, block and line comments, tables and string literals.
+std::string generateSource(size_t bytes) {
+  std::string result;
+  result.reserve(bytes + 1024);
+  for (size_t i = 0; result.size() < bytes; ++i) {
+    auto n = std::to_string(i);
+    result += "/* generated block " + n +
+              "\n * produced by the table generator, do not edit */\n";
+    result += "static int table_" + n + "[] = {1, 2, 3, 0x1f, 077, " + n +
+              ", 42u, 1000000000ll};\n";
+    result += "// helper number " + n + " follows\n";
+    result += "int function_" + n + "(int alpha_" + n + ", int beta_" + n +
+              ") {\n";
+    result += "  const char *message = \"generated string literal number " +
+              n + "\\n\";\n";
+    result += "  int result = alpha_" + n + " * 31 + beta_" + n + " / 7;\n";
+    result += "  if (result > 1000) {\n    result -= 1000;\n  }\n";
+    result += "  return result + 'a';\n}\n\n";
+  }
+  return result;
+}
+
+/// Initializer lists of generated data tables, nearly every token a numeric
+/// literal: decimal, octal and hex integers with and without suffixes, and
+/// decimal and hex floats with exponents.
+std::string generateLiteralTables(size_t bytes) {
+  static const char *const Rows[] = {
+      "  0, 1, 42, 255, 65535, 2147483647, 4294967295u, 0x7fffffffL,\n",
+      "  0x1f, 0XFFFFu, 0x123456789abcdefULL, 0777, 0123lu, 18446744073709551615ull,\n",
+      "  3.14159, .5f, 1e10, 2.5e-3L, 6.02214076e+23, 0x1.8p3, 0x.ffp-3f,\n",
+      "  100000ll, 7LLU, 9uLL, 123456789, 0.0, 1.0F, 1e-300, 12345.6789e2,\n"};
+  std::string result;
+  result.reserve(bytes + 1024);
+  for (size_t i = 0; result.size() < bytes; ++i) {
+    result += "static const double table_" + std::to_string(i) + "[] = {\n";
+    for (size_t row = 0; row < 64; ++row) {
+      result += Rows[row % std::size(Rows)];
+    }
+    result += "};\n";
+  }
+  return result;
+}
+
+/// Code written against a layer of macros: nested function-like macros,
+/// token pasting, stringification, variadic logging and #if blocks.
+std::string generateMacroSource(size_t bytes) {
+  std::string result =
+      "#define ADD(a, b) ((a) + (b))\n"
+      "#define MUL(a, b) ((a) * (b))\n"
+      "#define SQUARE(x) MUL(x, x)\n"
+      "#define POLY(x) ADD(SQUARE(x), ADD(MUL(3, x), 7))\n"
+      "#define NAME(prefix, n) prefix##_##n\n"
+      "#define STR(x) #x\n"
+      "#define XSTR(x) STR(x)\n"
+      "#define LOG(fmt, ...) log_message(__FILE__, __LINE__, fmt, "
+      "##__VA_ARGS__)\n"
+      "#define CHECK(c) do { if (!(c)) LOG(\"check failed: \" #c); } "
+      "while (0)\n"
+      "#define FEATURE_LEVEL 3\n\n";
+  result.reserve(bytes + 1024);
+  for (size_t i = 0; result.size() < bytes; ++i) {
+    auto n = std::to_string(i);
+    result += "int NAME(value, " + n + ")(int x) {\n";
+    result += "#if FEATURE_LEVEL > 2 && defined(LOG)\n";
+    result += "  CHECK(x > " + n + ");\n";
+    result += "  LOG(\"value %d\", POLY(x));\n";
+    result += "#else\n  never_used();\n#endif\n";
+    result += "  return POLY(x) + SQUARE(" + n + ");\n}\n";
+    result += "static const char *NAME(label, " + n + ") = XSTR(POLY(" + n +
+              "));\n\n";
+  }
+  return result;
+}
+
+/// What a file sees after its library headers: thousands of typedefs,
+/// declarations spelled through them, and functions whose locals and casts
+/// use the names, with inner blocks shadowing some by variables. Nearly
+/// every identifier starting a statement is a typedef lookup.
+std::string generateTypedefSource(size_t bytes) {
+  std::string result;
+  result.reserve(bytes + 1024);
+  for (size_t i = 0; result.size() < bytes; ++i) {
+    auto n = std::to_string(i);
+    auto m = std::to_string(i / 2);
+    result += "typedef unsigned long size_" + n + "_t;\n";
+    result += "typedef struct record_" + n + " {\n  size_" + n +
+              "_t length;\n  struct record_" + n + " *next;\n} record_" + n +
+              "_t;\n";
+    result += "typedef record_" + n + "_t *record_" + n + "_ptr;\n";
+    result += "typedef int (*visit_" + n + "_fn)(record_" + n +
+              "_ptr record, void *data);\n";
+    result += "extern record_" + n + "_ptr find_" + n + "(record_" + m +
+              "_ptr list, size_" + m + "_t key, visit_" + m +
+              "_fn visit);\n";
+    result += "size_" + n + "_t count_" + n + "(record_" + n +
+              "_ptr head) {\n";
+    result += "  size_" + n + "_t total = 0;\n";
+    result += "  record_" + n + "_ptr p = head;\n";
+    result += "  while (p) {\n";
+    result += "    record_" + m + "_t *alias = (record_" + m + "_t *)p;\n";
+    result += "    {\n      int size_" + n + "_t = sizeof(record_" + n +
+              "_t);\n      total += size_" + n + "_t;\n    }\n";
+    result += "    total += alias->length;\n    p = p->next;\n  }\n";
+    result += "  return total;\n}\n\n";
+  }
+  return result;
+}
+
+/// The typedef heavy source damaged as by a garbled or truncated generator
+/// run: now and then a bracket or ; is dropped or doubled, or the text
+/// breaks off for a stretch in the middle of a line.
+std::string generateCorruptSource(size_t bytes) {
+  std::string clean = generateTypedefSource(bytes);
+  std::string result;
+  result.reserve(clean.size());
+  std::mt19937 random(42);
+  for (size_t i = 0; i < clean.size(); ++i) {
+    char c = clean[i];
+    if (std::strchr("{}()[];", c) && random() % 64 == 0) {
+      if (random() % 2) {
+        continue;
+      }
+      result += c;
+    } else if (c == '\n' && random() % 256 == 0) {
+      i += random() % 200;
+      continue;
+    }
+    result += c;
+  }
+  return result;
+}
+
+/// Writes \p count headers to \p dir, each including three earlier ones by
+/// varying spellings of their path, and returns a file including all of
+/// them. \p detectable selects guards of the #ifndef X form; the others are
+/// spelled `#if !defined(X) && 1`, which has the same meaning but is not
+/// recognized as an include guard, so those headers are lexed on every
+/// include.
+std::string generateHeaders(unsigned count, llvm::StringRef dir,
+                            bool detectable) {
+  llvm::StringRef dirName = llvm::sys::path::filename(dir);
+  auto include = [&](unsigned k, unsigned spelling) {
+    auto name = "h" + std::to_string(k) + ".h";
+    switch (spelling % 3) {
+    case 0:
+      return "#include \"" + name + "\"\n";
+    case 1:
+      return "#include \"../" + dirName.str() + "/" + name + "\"\n";
+    default:
+      return "#include <" + name + ">\n";
+    }
+  };
+  for (unsigned k = 0; k < count; ++k) {
+    auto n = std::to_string(k);
+    std::string header;
+    header += detectable ? "#ifndef H" + n + "_H\n"
+                         : "#if !defined(H" + n + "_H) && 1\n";
+    header += "#define H" + n + "_H\n";
+    /// k / 2, k / 3 and k / 4 keep the nesting logarithmic
+    for (unsigned j = 2; j <= 4 && k; ++j) {
+      header += include(k / j, k + j);
+    }
+    header += "typedef struct node_" + n + " {\n  int key;\n  struct node_" +
+              n + " *next;\n} node_" + n + "_t;\n";
+    header += "#define NODE_KEY_" + n + "(p) ((p)->key + " + n + ")\n";
+    for (unsigned j = 0; j < 24; ++j) {
+      auto m = std::to_string(j);
+      header += "extern int api_" + n + "_" + m + "(node_" + n +
+                "_t *node, const char *name, unsigned long flags);\n";
+    }
+    header += "#endif\n";
+    llvm::SmallString<128> path(dir);
+    llvm::sys::path::append(path, "h" + n + ".h");
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec);
+    if (ec) {
+      llvm::report_fatal_error("cannot write " + path + ": " + ec.message());
+    }
+    os << header;
+  }
+  std::string main;
+  for (unsigned k = 0; k < count; ++k) {
+    main += include(k, k);
+    main += include(count - 1 - k, k + 1);
+  }
+  main += "int main(void) { return 0; }\n";
+  return main;
+}
+
+/// Pseudo random bytes of a firmware image. Returns the #embed source
+/// including the blob written to \p path and the same bytes as the
+/// initializer list a hex dump tool would generate.
+std::pair<std::string, std::string> generateEmbed(size_t bytes,
+                                                  llvm::StringRef path) {
+  std::string blob(bytes, '\0');
+  uint32_t seed = 0x12345678;
+  for (auto &byte : blob) {
+    seed = seed * 1664525 + 1013904223;
+    byte = static_cast<char>(seed >> 24);
+  }
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec) {
+    llvm::report_fatal_error("cannot write " + path + ": " + ec.message());
+  }
+  os << blob;
+
+  std::string embed = "const unsigned char firmware[] = {\n#embed \"" +
+                      path.str() + "\"\n};\n";
+  std::string list = "const unsigned char firmware[] = {\n";
+  list.reserve(bytes * 6 + 64);
+  for (size_t i = 0; i < bytes; ++i) {
+    list += std::to_string(static_cast<uint8_t>(blob[i]));
+    list += (i + 1) % 16 ? ", " : ",\n";
+  }
+  list += "};\n";
+  return {MV_(embed), MV_(list)};
+}
+
+/// Windows flavour of \p source, as saved by editors that add a BOM.
+std::string toCRLF(const std::string &source) {
+  std::string result = "\xef\xbb\xbf";
+  result.reserve(source.size() + source.size() / 16);
+  for (char ch : source) {
+    if (ch == '\n') {
+      result += '\r';
+    }
+    result += ch;
+  }
+  return result;
+}
+
+/// The lexer works in place on a MemoryBuffer, wrap the input without a copy.
+std::unique_ptr<llvm::MemoryBuffer> inputBuffer(const Input &input) {
+  return llvm::MemoryBuffer::getMemBuffer(input.content, input.name);
+}
+
+struct Measurement {
+  double seconds{1e30};
+  size_t allocations{0};
+  size_t allocatedBytes{0};
+  /// heap high-water mark above the level at the start of the run
+  size_t peakBytes{0};
+};
+
+/// Best time of Iterations runs of \p run; the allocation figures are the
+/// same for every run.
+template <typename Run> Measurement measure(Run &&run) {
+  Measurement best;
+  for (unsigned i = 0; i < Iterations; ++i) {
+    size_t allocCount = AllocCount, allocBytes = AllocBytes;
+    size_t base = LiveBytes;
+    PeakBytes = base;
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    best.seconds = std::min(
+        best.seconds, std::chrono::duration<double>(end - start).count());
+    best.allocations = AllocCount - allocCount;
+    best.allocatedBytes = AllocBytes - allocBytes;
+    best.peakBytes = PeakBytes - base;
+  }
+  return best;
+}
+
+void printHeader() {
+  llvm::outs() << llvm::format(
+      "%-26s %-12s %10s %10s %10s %12s %10s\n", (const char *)"input",
+      (const char *)"variant", (const char *)"tokens", (const char *)"best ms",
+      (const char *)"MB/s", (const char *)"allocations",
+      (const char *)"peak MB");
+}
+
+void printRow(const Input &input, const char *variant, size_t count,
+              const Measurement &m) {
+  constexpr double MB = 1024.0 * 1024.0;
+  llvm::outs() << llvm::format(
+      "%-26s %-12s %10zu %10.2f %10.1f %12zu %10.1f\n", input.name.c_str(),
+      variant, count, m.seconds * 1000, input.content.size() / MB / m.seconds,
+      m.allocations, m.peakBytes / MB);
+}
+
+void benchLex(const std::vector<Input> &inputs) {
+  printHeader();
+  for (const auto &input : inputs) {
+    size_t count = 0;
+    auto tokenize = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      count = lexer.tokenize().size();
+    });
+    printRow(input, "tokenize", count, tokenize);
+    auto twoPass = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      count = lexer.toCTokens(lexer.tokenize()).size();
+    });
+    printRow(input, "two-pass", count, twoPass);
+    auto fused = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      count = lexer.lexCTokens().size();
+    });
+    printRow(input, "fused", count, fused);
+  }
+  llvm::outs() << "sizeof(Token) = " << sizeof(lcc::Token) << "\n";
+}
+
+bool sameTokens(const std::vector<lcc::Token> &a,
+                const std::vector<lcc::Token> &b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [](const lcc::Token &x, const lcc::Token &y) {
+                      return x.getTokenKind() == y.getTokenKind() &&
+                             x.getOffset() == y.getOffset() &&
+                             x.getLength() == y.getLength() &&
+                             x.getIdentifierId() == y.getIdentifierId();
+                    });
+}
+
+/// lexCTokens(threads) for 1 to 16 threads, every result checked against
+/// the serial lexer.
+void benchLexThreads(const std::vector<Input> &inputs) {
+  printHeader();
+  for (const auto &input : inputs) {
+    lcc::SourceManager serialMgr;
+    lcc::DiagnosticEngine serialDiag(serialMgr, llvm::nulls());
+    lcc::IdentifierTable serialIdents;
+    lcc::Lexer serialLexer(serialMgr, serialDiag, serialIdents,
+                           inputBuffer(input));
+    auto serial = serialLexer.lexCTokens();
+    double base = 0;
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u}) {
+      bool same = true;
+      auto m = measure([&] {
+        lcc::SourceManager mgr;
+        lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+        lcc::IdentifierTable idents;
+        lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+        same = sameTokens(lexer.lexCTokens(threads), serial) &&
+               diag.numErrors() == serialDiag.numErrors();
+      });
+      std::string variant = std::to_string(threads) + " threads";
+      printRow(input, variant.c_str(), serial.size(), m);
+      if (threads == 1) {
+        base = m.seconds;
+      }
+      llvm::outs() << llvm::format("  speedup %.2fx", base / m.seconds)
+                   << (same ? "" : "  MISMATCH with the serial lexer") << "\n";
+    }
+  }
+}
+
+/// Lex and parse, with the whole file lexed up front ("batch") or pulled by
+/// the parser through the token ring ("stream"), and the declarations only
+/// with the function bodies left lazy ("lazy"). The tree is torn down in
+/// the measured time.
+void benchParse(const std::vector<Input> &inputs) {
+  printHeader();
+  for (const auto &input : inputs) {
+    size_t count = 0;
+    auto batch = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      auto tokens = lexer.lexCTokens();
+      count = tokens.size();
+      lcc::TokenStream stream(tokens);
+      lcc::Parser parser(stream, lexer.getLiteralPool(), idents, diag);
+      parser.ParseTranslationUnit();
+    });
+    printRow(input, "batch", count, batch);
+    auto lazy = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      auto tokens = lexer.lexCTokens();
+      lcc::TokenStream stream(tokens);
+      lcc::Parser parser(stream, lexer.getLiteralPool(), idents, diag);
+      parser.setLazyBodies(true);
+      parser.ParseTranslationUnit();
+    });
+    printRow(input, "lazy", count, lazy);
+    size_t window = 0;
+    size_t allocations = 0;
+    size_t arenaBytes = 0;
+    auto stream = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      lcc::TokenStream stream(lexer);
+      lcc::Parser parser(stream, lexer.getLiteralPool(), idents, diag);
+      auto unit = parser.ParseTranslationUnit();
+      window = stream.getWindowCapacity();
+      allocations = unit.getContext().getNumAllocations();
+      arenaBytes = unit.getContext().getBytesAllocated();
+    });
+    printRow(input, "stream", count, stream);
+    llvm::outs() << "token window: " << window << " tokens\n";
+    llvm::outs() << llvm::format("syntax tree: %zu allocations, %.1f MB\n",
+                                 allocations,
+                                 arenaBytes / (1024.0 * 1024.0));
+  }
+}
+/// The parser alone with its function bodies on 1 to 16 threads, every
+/// result checked against the serial parse by its diagnostics and number
+/// of external declarations.
+void benchParseThreads(const std::vector<Input> &inputs) {
+  printHeader();
+  for (const auto &input : inputs) {
+    lcc::SourceManager mgr;
+    lcc::DiagnosticEngine lexDiag(mgr, llvm::nulls());
+    lcc::IdentifierTable idents;
+    lcc::Lexer lexer(mgr, lexDiag, idents, inputBuffer(input));
+    auto tokens = lexer.lexCTokens();
+    auto parse = [&](unsigned threads, std::string &diagText,
+                     size_t &globals) {
+      diagText.clear();
+      llvm::raw_string_ostream diagStream(diagText);
+      lcc::DiagnosticEngine diag(mgr, diagStream);
+      lcc::TokenStream stream(tokens);
+      lcc::Parser parser(stream, lexer.getLiteralPool(), idents, diag);
+      parser.setParseThreads(threads);
+      globals = parser.ParseTranslationUnit().getGlobals().size();
+    };
+    std::string serialText;
+    size_t serialGlobals = 0;
+    parse(1, serialText, serialGlobals);
+    double base = 0;
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u}) {
+      std::string text;
+      size_t globals = 0;
+      auto m = measure([&] { parse(threads, text, globals); });
+      std::string variant = std::to_string(threads) + " threads";
+      printRow(input, variant.c_str(), tokens.size(), m);
+      if (threads == 1) {
+        base = m.seconds;
+      }
+      bool same = text == serialText && globals == serialGlobals;
+      llvm::outs() << llvm::format("  speedup %.2fx", base / m.seconds)
+                   << (same ? "" : "  MISMATCH with the serial parser")
+                   << "\n";
+    }
+  }
+}
+
+/// Preprocessor::preprocess() on each input next to `gcc -E -P` on the same
+/// bytes written to a temporary file. The gcc figure includes starting the
+/// process and writing the output to /dev/null.
+void benchPreprocess(const std::vector<Input> &inputs) {
+  auto gcc = llvm::sys::findProgramByName("gcc");
+  printHeader();
+  for (const auto &input : inputs) {
+    size_t count = 0;
+    unsigned skipped = 0;
+    auto lcc = measure([&] {
+      lcc::SourceManager mgr;
+      lcc::DiagnosticEngine diag(mgr, llvm::nulls());
+      lcc::IdentifierTable idents;
+      lcc::Lexer lexer(mgr, diag, idents, inputBuffer(input));
+      lcc::Preprocessor pp(lexer, diag, idents);
+      for (const auto &dir : input.includeDirs) {
+        pp.addIncludeDir(dir);
+      }
+      count = pp.preprocess().size();
+      skipped = pp.numSkippedIncludes();
+    });
+    printRow(input, "lcc", count, lcc);
+    if (skipped) {
+      llvm::outs() << "  includes skipped by the guard check: " << skipped
+                   << "\n";
+    }
+    if (!gcc) {
+      llvm::outs() << "gcc not found, no comparison\n";
+      continue;
+    }
+    llvm::SmallString<128> path;
+    if (llvm::sys::fs::createTemporaryFile("lcc-bench", "c", path)) {
+      llvm::outs() << "cannot create a temporary file, no comparison\n";
+      continue;
+    }
+    llvm::FileRemover remover(path);
+    {
+      std::error_code ec;
+      llvm::raw_fd_ostream os(path, ec);
+      os << input.content;
+    }
+    std::vector<std::string> includeArgs;
+    for (const auto &dir : input.includeDirs) {
+      includeArgs.push_back("-I" + dir);
+    }
+    std::vector<llvm::StringRef> args = {*gcc, "-E", "-P", "-o", "/dev/null"};
+    args.insert(args.end(), includeArgs.begin(), includeArgs.end());
+    args.push_back(path);
+    int status = 0;
+    auto m = measure(
+        [&] { status = llvm::sys::ExecuteAndWait(*gcc, args); });
+    printRow(input, "gcc -E", count, m);
+    if (status) {
+      llvm::outs() << "  gcc exited with " << status << "\n";
+    }
+    llvm::outs() << llvm::format("  lcc speedup %.2fx", m.seconds / lcc.seconds)
+                 << "\n";
+  }
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  llvm::InitLLVM X(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, Head);
+
+  std::vector<Input> inputs;
+  Input corpus{"<corpus>", ""};
+  for (const auto &file : InputFiles) {
+    auto bufferOrErr = llvm::MemoryBuffer::getFile(file);
+    if (!bufferOrErr) {
+      llvm::WithColor::error(llvm::errs(), "lcc-bench")
+          << "Error reading " << file << ": "
+          << bufferOrErr.getError().message() << "\n";
+      return -1;
+    }
+    corpus.content += (*bufferOrErr)->getBuffer();
+    corpus.content += "\n";
+  }
+  if (!corpus.content.empty()) {
+    inputs.push_back(std::move(corpus));
+  }
+  if (SyntheticMB) {
+    inputs.push_back({"<synthetic " + std::to_string(SyntheticMB) + " MB>",
+                      generateSource(size_t(SyntheticMB) << 20)});
+  }
+  if (LiteralMB) {
+    inputs.push_back({"<literals " + std::to_string(LiteralMB) + " MB>",
+                      generateLiteralTables(size_t(LiteralMB) << 20)});
+  }
+  if (MacroMB) {
+    inputs.push_back({"<macros " + std::to_string(MacroMB) + " MB>",
+                      generateMacroSource(size_t(MacroMB) << 20)});
+  }
+  if (TypedefMB) {
+    inputs.push_back({"<typedefs " + std::to_string(TypedefMB) + " MB>",
+                      generateTypedefSource(size_t(TypedefMB) << 20)});
+  }
+  if (CorruptMB) {
+    inputs.push_back({"<corrupt " + std::to_string(CorruptMB) + " MB>",
+                      generateCorruptSource(size_t(CorruptMB) << 20)});
+  }
+  llvm::SmallString<128> headerDir;
+  if (Headers) {
+    if (auto ec = llvm::sys::fs::createUniqueDirectory("lcc-bench", headerDir)) {
+      llvm::WithColor::error(llvm::errs(), "lcc-bench")
+          << "cannot create a temporary directory: " << ec.message() << "\n";
+      return -1;
+    }
+    for (bool detectable : {true, false}) {
+      llvm::SmallString<128> dir(headerDir);
+      llvm::sys::path::append(dir, detectable ? "guarded" : "undetected");
+      llvm::sys::fs::create_directory(dir);
+      auto name = "<" + std::to_string(Headers) + " headers " +
+                  (detectable ? "guarded>" : "undetected>");
+      inputs.push_back({name, generateHeaders(Headers, dir, detectable),
+                        {std::string(dir)}});
+    }
+  }
+  llvm::SmallString<128> embedPath;
+  std::optional<llvm::FileRemover> embedRemover;
+  if (EmbedMB) {
+    if (auto ec = llvm::sys::fs::createTemporaryFile("lcc-bench", "bin",
+                                                     embedPath)) {
+      llvm::WithColor::error(llvm::errs(), "lcc-bench")
+          << "cannot create a temporary file: " << ec.message() << "\n";
+      return -1;
+    }
+    embedRemover.emplace(embedPath);
+    auto [embed, list] = generateEmbed(size_t(EmbedMB) << 20, embedPath);
+    auto name = "<embed " + std::to_string(EmbedMB) + " MB";
+    inputs.push_back({name + ">", MV_(embed)});
+    inputs.push_back({name + " as list>", MV_(list)});
+  }
+  if (CRLF) {
+    for (auto &input : inputs) {
+      input.name += " crlf";
+      input.content = toCRLF(input.content);
+    }
+  }
+  if (inputs.empty()) {
+    llvm::errs() << "no inputs, pass files, -synthetic-mb, -literal-mb, "
+                    "-macro-mb, -typedef-mb, -corrupt-mb, -headers or "
+                    "-embed-mb\n";
+    return -1;
+  }
+
+  switch (Bench) {
+  case BenchKind::Lex:
+    benchLex(inputs);
+    break;
+  case BenchKind::LexThreads:
+    benchLexThreads(inputs);
+    break;
+  case BenchKind::Parse:
+    benchParse(inputs);
+    break;
+  case BenchKind::ParseThreads:
+    benchParseThreads(inputs);
+    break;
+  case BenchKind::Preprocess:
+    benchPreprocess(inputs);
+    break;
+  }
+  if (!headerDir.empty()) {
+    llvm::sys::fs::remove_directories(headerDir);
+  }
+  return 0;
+}
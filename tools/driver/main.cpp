@@ -1,7 +1,12 @@
 #include "lcc/Basic/Diagnostic.h"
+#include "lcc/Basic/FileManager.h"
+#include "lcc/Basic/SourceManager.h"
 #include "lcc/Basic/Version.h"
 #include "lcc/CodeGen/CodeGen.h"
 #include "lcc/Lexer/Lexer.h"
+#include "lcc/Lexer/PrecompiledHeader.h"
+#include "lcc/Lexer/Preprocessor.h"
+#include "lcc/Lexer/TokenStream.h"
 #include "lcc/Parser/Parser.h"
 #include "lcc/Sema/Sema.h"
 #include "lcc/Support/DumpTool.h"
@@ -11,16 +16,18 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/SMLoc.h"
-#include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/WithColor.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include <atomic>
 #include <filesystem>
 #include <llvm/Support/FileSystem.h>
 #include <optional>
+#include <thread>
 
 static const char *Head = "lcc - based llvm c compiler";
 
@@ -42,6 +49,54 @@ static llvm::cl::opt<bool>
 static llvm::cl::opt<bool>
     PreprocessOnly("E", llvm::cl::desc("Only run the preprocessor"));
 
+static llvm::cl::list<std::string>
+    IncludeDirs("I", llvm::cl::Prefix,
+                llvm::cl::desc("Add <dir> to the include search path"),
+                llvm::cl::value_desc("dir"));
+
+static llvm::cl::opt<bool> DepsOnly(
+    "M", llvm::cl::desc("Only write a Makefile rule of the files each input "
+                        "depends on, nothing is compiled"));
+
+static llvm::cl::opt<bool> UserDepsOnly(
+    "MM",
+    llvm::cl::desc("Like -M, leaving out headers reached through #include <>"));
+
+static llvm::cl::opt<bool> WriteDeps(
+    "MD", llvm::cl::desc("Write the dependency rule to a .d file while "
+                         "compiling"));
+
+static llvm::cl::opt<bool> WriteUserDeps(
+    "MMD",
+    llvm::cl::desc("Like -MD, leaving out headers reached through #include <>"));
+
+static llvm::cl::opt<std::string>
+    DepFile("MF", llvm::cl::desc("Write the dependency rule to <file>"),
+            llvm::cl::value_desc("file"));
+
+static llvm::cl::opt<std::string>
+    DepTarget("MT", llvm::cl::desc("Name <target> in the dependency rule"),
+              llvm::cl::value_desc("target"));
+
+static llvm::cl::opt<bool>
+    DepPhony("MP", llvm::cl::desc("Add an empty rule for every header"));
+
+static llvm::cl::opt<unsigned> ScanThreads(
+    "scan-threads",
+    llvm::cl::desc("Scan the inputs of -M and -MM on <n> threads"),
+    llvm::cl::value_desc("n"), llvm::cl::init(1));
+
+static llvm::cl::opt<std::string> Language(
+    "x",
+    llvm::cl::desc("Treat the inputs as <language>: c, or c-header to build a "
+                   "precompiled header"),
+    llvm::cl::value_desc("language"));
+
+static llvm::cl::opt<std::string>
+    IncludePCH("include-pch",
+               llvm::cl::desc("Start from the precompiled header <file>"),
+               llvm::cl::value_desc("file"));
+
 static llvm::cl::opt<bool>
     EmitLLVM("emit-llvm",
              llvm::cl::desc(
@@ -52,6 +107,27 @@ static llvm::cl::opt<bool>
                llvm::cl::desc("Emit Tokens files for source inputs"));
 static llvm::cl::opt<bool>
     EmitAst("emit-ast", llvm::cl::desc("Emit AST files for source inputs"));
+static llvm::cl::opt<bool> EmitAstGlobals(
+    "emit-ast-globals",
+    llvm::cl::desc("Emit the AST of the file scope declarations only and "
+                   "stop, the function bodies are not parsed"));
+
+static llvm::cl::opt<unsigned> LexThreads(
+    "lex-threads",
+    llvm::cl::desc("Lex each input on <n> threads, in chunks cut at newlines"),
+    llvm::cl::value_desc("n"), llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> ParseThreads(
+    "parse-threads",
+    llvm::cl::desc("Parse the function bodies of each input on <n> threads"),
+    llvm::cl::value_desc("n"), llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> MaxNestingDepth(
+    "max-nesting-depth",
+    llvm::cl::desc("Stop with an error at statements or expressions nested "
+                   "deeper than <n>"),
+    llvm::cl::value_desc("n"),
+    llvm::cl::init(lcc::Parser::DefaultMaxNestingDepth));
 
 static llvm::cl::opt<bool> TimeOpt("time",
                                    llvm::cl::desc("Time individual commands"));
@@ -64,16 +140,165 @@ void printVersion(llvm::raw_ostream &OS) {
 
 enum class Action { Preprocess, Compile, AssemblyOutput, Link };
 
-bool compileCFile(Action action, std::filesystem::path sourceFile) {
+/// what a preprocessor run read: the input, the included files and the
+/// #embed resources. \p userOnly leaves out what came in through
+/// #include <...>.
+std::vector<std::string> collectDependencies(const std::string &sourceFile,
+                                             lcc::Preprocessor &pp,
+                                             lcc::SourceManager &mgr,
+                                             bool userOnly) {
+  std::vector<std::string> files{sourceFile};
+  if (!IncludePCH.empty()) {
+    files.push_back(IncludePCH);
+  }
+  for (const auto &file : pp.getIncludedFiles()) {
+    if (!userOnly || !file.isSystem) {
+      files.push_back(file.path);
+    }
+  }
+  for (auto &path : mgr.getBinaryFilePaths()) {
+    files.push_back(std::move(path));
+  }
+  return files;
+}
+
+std::string getOutputFile(Action action, std::filesystem::path sourceFile) {
+  if (!OutputFileName.empty()) {
+    return OutputFileName;
+  }
+  if (action == Action::AssemblyOutput) {
+    sourceFile.replace_extension(EmitLLVM ? "ll" : "s");
+  } else {
+    sourceFile.replace_extension(EmitLLVM ? "bc" : "o");
+  }
+  return sourceFile.string();
+}
+
+/// -MD and -MMD: the rule goes to -MF, else next to the output with a .d
+/// extension, the object file being the target
+bool writeDependencyFile(Action action, const std::filesystem::path &sourceFile,
+                         lcc::Preprocessor &pp, lcc::SourceManager &mgr) {
+  std::filesystem::path objectFile =
+      action == Action::Preprocess
+          ? std::filesystem::path(sourceFile.filename()).replace_extension("o")
+          : std::filesystem::path(getOutputFile(action, sourceFile));
+  std::string depFile = DepFile;
+  if (depFile.empty()) {
+    auto path = OutputFileName.empty() ? sourceFile.filename()
+                                       : std::filesystem::path(objectFile);
+    depFile = path.replace_extension("d").string();
+  }
+  std::error_code ec;
+  llvm::raw_fd_ostream os(depFile, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "failed to open output file";
+    return false;
+  }
+  lcc::dump::dumpDependencies(
+      DepTarget.empty() ? objectFile.string() : std::string(DepTarget),
+      collectDependencies(sourceFile.string(), pp, mgr, WriteUserDeps),
+      DepPhony, os);
+  return true;
+}
+
+/// -M and -MM for one input: only the directives are run, nothing is
+/// parsed. Diagnostics are collected in \p errors, inputs are scanned
+/// concurrently.
+bool scanFile(const std::string &sourceFile, lcc::FileManager &files,
+              std::string &rule, std::string &errors) {
+  llvm::raw_string_ostream errorStream(errors);
+  auto buffer = files.getBuffer(sourceFile);
+  if (std::error_code BufferError = buffer.getError()) {
+    llvm::WithColor::error(errorStream, "lcc")
+        << "Error reading " << sourceFile << ": " << BufferError.message()
+        << "\n";
+    return false;
+  }
+  lcc::SourceManager mgr;
+  lcc::DiagnosticEngine diag(mgr, errorStream);
+  lcc::IdentifierTable idents;
+  lcc::Lexer lexer(mgr, diag, idents, std::move(*buffer));
+  lcc::Preprocessor pp(lexer, diag, idents);
+  for (const auto &dir : IncludeDirs) {
+    pp.addIncludeDir(dir);
+  }
+  pp.setFileManager(files);
+  pp.scanDirectives();
+  if (diag.numErrors())
+    return false;
+  std::string target =
+      DepTarget.empty()
+          ? std::filesystem::path(sourceFile).filename().replace_extension("o")
+                .string()
+          : std::string(DepTarget);
+  llvm::raw_string_ostream os(rule);
+  lcc::dump::dumpDependencies(
+      target, collectDependencies(sourceFile, pp, mgr, UserDepsOnly),
+      DepPhony, os);
+  return true;
+}
+
+/// Scans every input on ScanThreads threads sharing \p files, so a header
+/// included by many inputs is looked up and read once. The rules are
+/// written in the order of the inputs.
+int scanAllFiles(lcc::FileManager &files) {
+  std::vector<std::string> rules(InputFiles.size());
+  std::vector<std::string> errors(InputFiles.size());
+  std::vector<char> scanned(InputFiles.size());
+  std::atomic<size_t> next{0};
+  auto scanInputs = [&] {
+    for (size_t i = next++; i < InputFiles.size(); i = next++) {
+      scanned[i] = scanFile(InputFiles[i], files, rules[i], errors[i]);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < std::min<size_t>(ScanThreads, InputFiles.size());
+       ++i) {
+    workers.emplace_back(scanInputs);
+  }
+  scanInputs();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  std::string outputFile = DepFile.empty() ? std::string(OutputFileName)
+                                           : std::string(DepFile);
+  std::optional<llvm::raw_fd_ostream> file;
+  if (!outputFile.empty()) {
+    std::error_code ec;
+    file.emplace(outputFile, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+      llvm::errs() << "failed to open output file";
+      return -1;
+    }
+  }
+  llvm::raw_ostream &os = file ? *file : llvm::outs();
+  int result = 0;
+  for (size_t i = 0; i < InputFiles.size(); ++i) {
+    llvm::errs() << errors[i];
+    if (scanned[i]) {
+      os << rules[i];
+    } else {
+      result = -1;
+    }
+  }
+  if (TimeOpt) {
+    files.printStatistics(llvm::errs());
+  }
+  return result;
+}
+
+bool compileCFile(Action action, std::filesystem::path sourceFile,
+                  lcc::FileManager &files) {
   std::optional<llvm::TimerGroup> timer;
   if (TimeOpt) {
     timer.emplace("Compilation", "Time it took for the whole compilation of " +
                                      sourceFile.string());
   }
 
-  /// file read to memory
+  /// file mapped to memory, the lexer works on it without a copy
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr =
-      llvm::MemoryBuffer::getFile(sourceFile.string());
+      files.getBuffer(sourceFile.string());
   if (std::error_code BufferError = FileOrErr.getError()) {
     llvm::WithColor::error(llvm::errs(), "lcc")
         << "Error reading " << sourceFile.string() << ": "
@@ -89,20 +314,78 @@ bool compileCFile(Action action, std::filesystem::path sourceFile) {
                        *timer);
     lexerTimeRegion.emplace(*lexerTimer);
   }
-  llvm::SourceMgr mgr;
+  lcc::SourceManager mgr;
   lcc::DiagnosticEngine diag(mgr, llvm::errs());
-  std::string sourceCode((*FileOrErr)->getBuffer());
-  lcc::Lexer lexer(mgr, diag, std::move(sourceCode), (*FileOrErr)->getBufferIdentifier());
-  auto ppTokens = lexer.tokenize();
-  if (diag.numErrors())
-    return false;
-  auto tokens = lexer.toCTokens(std::move(ppTokens));
-  if (diag.numErrors())
-    return false;
-  if (EmitTokens) {
-    lcc::dump::dumpTokens(tokens);
+  lcc::IdentifierTable idents;
+  /// mapped and checked only, macro bodies are read as they get expanded
+  std::unique_ptr<lcc::PrecompiledHeader> pch;
+  if (!IncludePCH.empty()) {
+    pch = lcc::PrecompiledHeader::load(IncludePCH, mgr, idents, diag);
+    if (!pch)
+      return false;
+  }
+  lcc::Lexer lexer(mgr, diag, idents, std::move(*FileOrErr));
+  lcc::Preprocessor pp(lexer, diag, idents, LexThreads);
+  pp.setFileManager(files);
+  if (pch) {
+    pp.includePCH(*pch);
+  }
+  for (const auto &dir : IncludeDirs) {
+    pp.addIncludeDir(dir);
+  }
+  if (action == Action::Preprocess) {
+    std::vector<const char *> positions;
+    auto ppTokens = pp.preprocess(&positions);
+    if (diag.numErrors())
+      return false;
+    if ((WriteDeps || WriteUserDeps) &&
+        !writeDependencyFile(action, sourceFile, pp, mgr))
+      return false;
+    if (OutputFileName.empty()) {
+      lcc::dump::dumpPreprocessed(ppTokens, positions,
+                                  lexer.getLiteralPool(), mgr, llvm::outs());
+      return true;
+    }
+    std::error_code ec;
+    llvm::raw_fd_ostream os(OutputFileName, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+      llvm::errs() << "failed to open output file";
+      return false;
+    }
+    lcc::dump::dumpPreprocessed(ppTokens, positions, lexer.getLiteralPool(),
+                                mgr, os);
+    return true;
+  }
+  /// The parser pulls tokens from the preprocessor as it goes. Only
+  /// -emit-tokens, -time for a separate lexer figure, a parallel lex, a
+  /// parallel parse and lazy function bodies take the whole file up front.
+  std::vector<lcc::Token> tokens;
+  std::optional<lcc::TokenStream> tokenStream;
+  if (EmitTokens || timer || LexThreads > 1 || ParseThreads > 1 ||
+      EmitAstGlobals) {
+    tokens = pp.lexCTokens();
+    if (diag.numErrors())
+      return false;
+    if (EmitTokens) {
+      lcc::dump::dumpTokens(tokens, mgr);
+    }
+    tokenStream.emplace(tokens);
+  } else {
+    tokenStream.emplace(pp);
   }
   lexerTimeRegion.reset();
+  if (timer && pp.getSkippedBytes()) {
+    /// the raw scan over inactive #if groups is part of the lexer time
+    double seconds = std::max(pp.getSkipSeconds(), 1e-9);
+    llvm::errs() << llvm::format(
+        "skipped %zu bytes of inactive #if groups in %.3f ms (%.1f MB/s)\n",
+        pp.getSkippedBytes(), seconds * 1000,
+        pp.getSkippedBytes() / seconds / (1024.0 * 1024.0));
+  }
+  if (timer && pp.numSkippedIncludes()) {
+    llvm::errs() << "skipped " << pp.numSkippedIncludes()
+                 << " includes of guarded or #pragma once headers\n";
+  }
   /// lexer end
 
   /// parser begin
@@ -113,12 +396,37 @@ bool compileCFile(Action action, std::filesystem::path sourceFile) {
                         "Time it took to parse " + sourceFile.string(), *timer);
     parserTimeRegion.emplace(*parserTimer);
   }
-  lcc::Parser parser(tokens, diag);
+  lcc::Parser parser(*tokenStream, lexer.getLiteralPool(), idents, diag);
+  parser.setMaxNestingDepth(MaxNestingDepth);
+  parser.setParseThreads(ParseThreads);
+  parser.setLazyBodies(EmitAstGlobals);
+  if (pch) {
+    parser.addFileScopeTypedefs(pch->getTypedefs());
+  }
   auto translationUnit = parser.ParseTranslationUnit();
-  if (EmitAst) {
-    lcc::dump::dumpAst(translationUnit);
+  /// lexer and preprocessor errors of a streamed file only surface here
+  if (pp.numErrors())
+    return false;
+  if ((WriteDeps || WriteUserDeps) &&
+      !writeDependencyFile(action, sourceFile, pp, mgr))
+    return false;
+  if (EmitAst || EmitAstGlobals) {
+    lcc::dump::dumpAst(translationUnit, !EmitAstGlobals);
   }
   parserTimeRegion.reset();
+  if (timer) {
+    const lcc::ASTContext &context = translationUnit.getContext();
+    llvm::errs() << llvm::format(
+        "syntax tree: %zu allocations, %.1f MB in the arena\n",
+        context.getNumAllocations(),
+        context.getBytesAllocated() / (1024.0 * 1024.0));
+  }
+  /// only dumps, the function bodies were never parsed and the errors in
+  /// them never reported, so nothing may be compiled from this tree. Nor
+  /// from a tree the parser reported errors in.
+  if (EmitAstGlobals || diag.numErrors()) {
+    return diag.numErrors() == 0;
+  }
   /// parser end
 
   /// semantics begin
@@ -156,27 +464,7 @@ bool compileCFile(Action action, std::filesystem::path sourceFile) {
   /// codegen end
 
   /// compile to native object code begin
-  std::string outputFile;
-  if (!OutputFileName.empty()) {
-    outputFile = OutputFileName;
-  } else {
-    auto path = sourceFile;
-    if (action == Action::AssemblyOutput) {
-      if (EmitLLVM) {
-        path.replace_extension("ll");
-      } else {
-        path.replace_extension("s");
-      }
-    } else {
-      if (EmitLLVM) {
-        path.replace_extension("bc");
-      } else {
-        path.replace_extension("o");
-      }
-    }
-    outputFile = path.string();
-  }
-
+  std::string outputFile = getOutputFile(action, sourceFile);
   std::error_code ec;
   llvm::raw_fd_ostream os(outputFile, ec, llvm::sys::fs::OpenFlags::OF_None);
   if (ec) {
@@ -220,16 +508,62 @@ bool compileCFile(Action action, std::filesystem::path sourceFile) {
   return true;
 }
 
-int doActionOnAllFiles(Action action) {
+/// preprocesses and parses a header, then saves the state it leaves behind
+/// for -include-pch
+bool compileHeaderFile(std::filesystem::path headerFile,
+                       lcc::FileManager &files) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr =
+      files.getBuffer(headerFile.string());
+  if (std::error_code BufferError = FileOrErr.getError()) {
+    llvm::WithColor::error(llvm::errs(), "lcc")
+        << "Error reading " << headerFile.string() << ": "
+        << BufferError.message() << "\n";
+    return false;
+  }
+  lcc::SourceManager mgr;
+  lcc::DiagnosticEngine diag(mgr, llvm::errs());
+  lcc::IdentifierTable idents;
+  lcc::Lexer lexer(mgr, diag, idents, std::move(*FileOrErr));
+  lcc::Preprocessor pp(lexer, diag, idents);
+  pp.setFileManager(files);
+  for (const auto &dir : IncludeDirs) {
+    pp.addIncludeDir(dir);
+  }
+  /// a file built with the header usually #includes it again
+  pp.markMainFileAsHeader();
+  lcc::TokenStream tokenStream(pp);
+  lcc::Parser parser(tokenStream, lexer.getLiteralPool(), idents, diag);
+  parser.setMaxNestingDepth(MaxNestingDepth);
+  parser.ParseTranslationUnit();
+  if (diag.numErrors())
+    return false;
+  std::string outputFile = OutputFileName.empty()
+                               ? headerFile.string() + ".pch"
+                               : std::string(OutputFileName);
+  return lcc::PrecompiledHeader::write(outputFile, pp,
+                                       parser.getFileScopeTypedefs(), diag);
+}
+
+/// the inputs share \p files, a header is looked up and read once however
+/// many of them include it
+int doActionOnAllFiles(Action action, lcc::FileManager &files) {
   for (const auto &F : InputFiles) {
     auto path = std::filesystem::path(F);
     auto extension = path.extension();
-    if (extension == ".c") {
-      bool res = compileCFile(action, path);
+    bool isHeader = Language == "c-header" ||
+                    (Language.empty() && extension == ".h");
+    if (isHeader && action != Action::Preprocess) {
+      if (!compileHeaderFile(path, files))
+        return -1;
+    } else if (extension == ".c" || isHeader || Language == "c") {
+      bool res = compileCFile(action, path, files);
       if (!res)
         return -1;
     }
   }
+  if (TimeOpt) {
+    files.printStatistics(llvm::errs());
+  }
   return 0;
 }
 
@@ -237,6 +571,13 @@ int main(int argc, char *argv[]) {
   llvm::InitLLVM X(argc, argv);
   llvm::cl::SetVersionPrinter(&printVersion);
   llvm::cl::ParseCommandLineOptions(argc, argv, Head);
+  /// what every input of the process looks up and reads
+  lcc::FileManager files;
+
+  /// a dependency scan needs neither the parser nor any LLVM target
+  if (DepsOnly || UserDepsOnly) {
+    return InputFiles.empty() ? -1 : scanAllFiles(files);
+  }
 
   llvm::InitializeAllTargetInfos();
   llvm::InitializeAllTargets();
@@ -260,7 +601,7 @@ int main(int argc, char *argv[]) {
           << "cannot compile to object file add preprocess at the same time";
       return -1;
     }
-    return doActionOnAllFiles(Action::Compile);
+    return doActionOnAllFiles(Action::Compile, files);
   }
 
   if (AssemblyOnly) {
@@ -269,12 +610,12 @@ int main(int argc, char *argv[]) {
           << "cannot compile to assembly file add preprocess at the same time";
       return -1;
     }
-    return doActionOnAllFiles(Action::AssemblyOutput);
+    return doActionOnAllFiles(Action::AssemblyOutput, files);
   }
 
   if (PreprocessOnly) {
-    return doActionOnAllFiles(Action::Preprocess);
+    return doActionOnAllFiles(Action::Preprocess, files);
   }
 
-  return doActionOnAllFiles(Action::Compile);
+  return doActionOnAllFiles(Action::Compile, files);
 }